@@ -1 +1,67 @@
+// camera.c
+#include "camera.h"
+#include <math.h>
 
+void matrixMultiply(const float a[16], const float b[16], float out[16]) {
+    for (int column = 0; column < 4; column++) {
+        for (int row = 0; row < 4; row++) {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; k++) {
+                sum += a[k * 4 + row] * b[column * 4 + k];
+            }
+            out[column * 4 + row] = sum;
+        }
+    }
+}
+
+void matrixPerspective(float fovY, float aspect, float zNear, float zFar, float out[16]) {
+    float f = 1.0f / tanf(fovY * (float)M_PI / 360.0f);
+    for (int i = 0; i < 16; i++) out[i] = 0.0f;
+    out[0] = f / aspect;
+    out[5] = f;
+    out[10] = (zFar + zNear) / (zNear - zFar);
+    out[11] = -1.0f;
+    out[14] = 2.0f * zFar * zNear / (zNear - zFar);
+}
+
+static void normalize3(float v[3]) {
+    float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    if (length > 0.0f) {
+        v[0] /= length;
+        v[1] /= length;
+        v[2] /= length;
+    }
+}
+
+void matrixLookAt(const float eye[3], const float center[3], const float up[3], float out[16]) {
+    float f[3] = { center[0] - eye[0], center[1] - eye[1], center[2] - eye[2] };
+    normalize3(f);
+    float s[3] = { f[1] * up[2] - f[2] * up[1], f[2] * up[0] - f[0] * up[2], f[0] * up[1] - f[1] * up[0] };
+    normalize3(s);
+    float u[3] = { s[1] * f[2] - s[2] * f[1], s[2] * f[0] - s[0] * f[2], s[0] * f[1] - s[1] * f[0] };
+
+    // Rows are the camera axes; the last column moves the eye to the origin
+    out[0] = s[0];  out[4] = s[1];  out[8] = s[2];   out[12] = -(s[0] * eye[0] + s[1] * eye[1] + s[2] * eye[2]);
+    out[1] = u[0];  out[5] = u[1];  out[9] = u[2];   out[13] = -(u[0] * eye[0] + u[1] * eye[1] + u[2] * eye[2]);
+    out[2] = -f[0]; out[6] = -f[1]; out[10] = -f[2]; out[14] = f[0] * eye[0] + f[1] * eye[1] + f[2] * eye[2];
+    out[3] = 0.0f;  out[7] = 0.0f;  out[11] = 0.0f;  out[15] = 1.0f;
+}
+
+void extractFrustumPlanes(const float m[16], float planes[6][4]) {
+    // Each plane is the last row of the matrix plus or minus one of the others
+    for (int i = 0; i < 3; i++) {
+        for (int k = 0; k < 4; k++) {
+            float last = m[k * 4 + 3];
+            float row = m[k * 4 + i];
+            planes[i * 2][k] = last + row;
+            planes[i * 2 + 1][k] = last - row;
+        }
+    }
+
+    for (int p = 0; p < 6; p++) {
+        float length = sqrtf(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+        if (length > 0.0f) {
+            for (int k = 0; k < 4; k++) planes[p][k] /= length;
+        }
+    }
+}
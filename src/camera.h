@@ -1 +1,21 @@
+// camera.h
+#ifndef CAMERA_H
+#define CAMERA_H
 
+// 4x4 matrices are column-major float[16], as OpenGL stores them
+
+// out = a * b; out may alias neither input
+void matrixMultiply(const float a[16], const float b[16], float out[16]);
+
+// Perspective projection with a vertical field of view in degrees, as gluPerspective
+void matrixPerspective(float fovY, float aspect, float zNear, float zFar, float out[16]);
+
+// View matrix looking from 'eye' towards 'center', as gluLookAt
+void matrixLookAt(const float eye[3], const float center[3], const float up[3], float out[16]);
+
+// Frustum planes (a, b, c, d) with inward-facing normals, normalized so that
+// a*x + b*y + c*z + d is the signed distance of a point, extracted from a
+// projection * view matrix. Order: left, right, bottom, top, near, far.
+void extractFrustumPlanes(const float viewProjection[16], float planes[6][4]);
+
+#endif // CAMERA_H
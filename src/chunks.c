@@ -0,0 +1,136 @@
+// chunks.c
+#include "chunks.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+ChunkGrid* createChunkGrid(int width, int depth, int chunkSize) {
+    if (width <= 0 || depth <= 0 || chunkSize <= 0) return NULL;
+
+    ChunkGrid* grid = (ChunkGrid*)calloc(1, sizeof(ChunkGrid));
+    if (!grid) return NULL;
+
+    grid->chunkSize = chunkSize;
+    grid->chunksX = (width + chunkSize - 1) / chunkSize;
+    grid->chunksZ = (depth + chunkSize - 1) / chunkSize;
+    grid->count = grid->chunksX * grid->chunksZ;
+
+    size_t floats = (size_t)grid->count * sizeof(float);
+    grid->centerX = (float*)calloc(1, floats);
+    grid->centerY = (float*)calloc(1, floats);
+    grid->centerZ = (float*)calloc(1, floats);
+    grid->extentX = (float*)malloc(floats);
+    grid->extentY = (float*)malloc(floats);
+    grid->extentZ = (float*)malloc(floats);
+    grid->occluderTop = (float*)malloc(floats);
+    grid->sorted = (ChunkDistance*)malloc((size_t)grid->count * sizeof(ChunkDistance));
+    grid->visible = (unsigned char*)calloc((size_t)grid->count, 1);
+    grid->order = (int*)malloc((size_t)grid->count * sizeof(int));
+
+    if (!grid->centerX || !grid->centerY || !grid->centerZ || !grid->extentX || !grid->extentY ||
+        !grid->extentZ || !grid->occluderTop || !grid->sorted || !grid->visible || !grid->order) {
+        fprintf(stderr, "Failed to allocate chunk grid.\n");
+        destroyChunkGrid(grid);
+        return NULL;
+    }
+
+    // Every chunk starts empty until its geometry is built
+    for (int i = 0; i < grid->count; i++) {
+        grid->extentX[i] = grid->extentY[i] = grid->extentZ[i] = -1.0f;
+        grid->occluderTop[i] = -1.0f;
+    }
+    return grid;
+}
+
+void destroyChunkGrid(ChunkGrid* grid) {
+    if (!grid) return;
+    free(grid->centerX);
+    free(grid->centerY);
+    free(grid->centerZ);
+    free(grid->extentX);
+    free(grid->extentY);
+    free(grid->extentZ);
+    free(grid->occluderTop);
+    free(grid->sorted);
+    free(grid->visible);
+    free(grid->order);
+    free(grid);
+}
+
+void chunkSetBounds(ChunkGrid* grid, int chunk, const float min[3], const float max[3]) {
+    if (!grid || chunk < 0 || chunk >= grid->count) return;
+    grid->centerX[chunk] = 0.5f * (min[0] + max[0]);
+    grid->centerY[chunk] = 0.5f * (min[1] + max[1]);
+    grid->centerZ[chunk] = 0.5f * (min[2] + max[2]);
+    grid->extentX[chunk] = 0.5f * (max[0] - min[0]);
+    grid->extentY[chunk] = 0.5f * (max[1] - min[1]);
+    grid->extentZ[chunk] = 0.5f * (max[2] - min[2]);
+}
+
+void chunkSetOccluder(ChunkGrid* grid, int chunk, float top) {
+    if (!grid || chunk < 0 || chunk >= grid->count) return;
+    grid->occluderTop[chunk] = top;
+}
+
+// Nearest first
+static int compareDistance(const void* a, const void* b) {
+    float da = ((const ChunkDistance*)a)->distance;
+    float db = ((const ChunkDistance*)b)->distance;
+    return (da > db) - (da < db);
+}
+
+int chunkCullAndSort(ChunkGrid* grid, float planes[6][4], const float eye[3], CullStats* stats) {
+    if (!grid) return 0;
+
+    const int count = grid->count;
+    const float* cx = grid->centerX;
+    const float* cy = grid->centerY;
+    const float* cz = grid->centerZ;
+    const float* ex = grid->extentX;
+    const float* ey = grid->extentY;
+    const float* ez = grid->extentZ;
+    unsigned char* visible = grid->visible;
+
+    // Empty chunks never pass
+    for (int i = 0; i < count; i++) {
+        visible[i] = ey[i] >= 0.0f;
+    }
+
+    // One branch-free pass per plane so the compiler vectorizes across chunks: a box
+    // is outside when its corner furthest along the plane normal is still behind it
+    for (int p = 0; p < 6; p++) {
+        const float a = planes[p][0], b = planes[p][1], c = planes[p][2], d = planes[p][3];
+        const float absA = fabsf(a), absB = fabsf(b), absC = fabsf(c);
+        for (int i = 0; i < count; i++) {
+            float distance = a * cx[i] + b * cy[i] + c * cz[i] + d;
+            float radius = absA * ex[i] + absB * ey[i] + absC * ez[i];
+            visible[i] &= (unsigned char)(distance + radius >= 0.0f);
+        }
+    }
+
+    // Compact the survivors and order them front to back for early depth rejection
+    ChunkDistance* sorted = grid->sorted;
+    int visibleCount = 0, empty = 0;
+    for (int i = 0; i < count; i++) {
+        empty += ey[i] < 0.0f;
+        if (!visible[i]) continue;
+        float dx = cx[i] - eye[0], dy = cy[i] - eye[1], dz = cz[i] - eye[2];
+        sorted[visibleCount].distance = dx * dx + dy * dy + dz * dz;
+        sorted[visibleCount].chunk = i;
+        visibleCount++;
+    }
+    qsort(sorted, (size_t)visibleCount, sizeof(ChunkDistance), compareDistance);
+    for (int i = 0; i < visibleCount; i++) {
+        grid->order[i] = sorted[i].chunk;
+    }
+
+    grid->visibleCount = visibleCount;
+    if (stats) {
+        stats->total = count;
+        stats->visible = visibleCount;
+        stats->empty = empty;
+        stats->culled = count - visibleCount - empty;
+        stats->occluded = 0;
+    }
+    return visibleCount;
+}
@@ -0,0 +1,56 @@
+// chunks.h
+#ifndef CHUNKS_H
+#define CHUNKS_H
+
+// Sort key for front-to-back ordering
+typedef struct {
+    float distance;
+    int chunk;
+} ChunkDistance;
+
+// Square chunks of terrain columns with world-space bounding boxes, culled
+// against the view frustum each frame. Boxes are stored as separate arrays of
+// centres and half extents so the plane tests run over all chunks at once.
+typedef struct {
+    int chunkSize;      // Columns per chunk side
+    int chunksX;
+    int chunksZ;
+    int count;
+
+    float* centerX;
+    float* centerY;
+    float* centerZ;
+    float* extentX;     // Half sizes; a chunk with no geometry has negative extents
+    float* extentY;
+    float* extentZ;
+    float* occluderTop;         // World height below which the whole chunk is solid, or negative
+
+    unsigned char* visible;     // Result of the last cull, per chunk
+    int* order;                 // Visible chunks, nearest first
+    int visibleCount;
+    ChunkDistance* sorted;      // Scratch for sorting
+} ChunkGrid;
+
+typedef struct {
+    int total;
+    int visible;
+    int culled;
+    int empty;          // Chunks without geometry, skipped before the frustum test
+    int occluded;       // Inside the frustum but hidden by nearer terrain
+} CullStats;
+
+ChunkGrid* createChunkGrid(int width, int depth, int chunkSize);
+void destroyChunkGrid(ChunkGrid* grid);
+
+// Set a chunk's box from its minimum and maximum corners; pass min > max to mark it empty
+void chunkSetBounds(ChunkGrid* grid, int chunk, const float min[3], const float max[3]);
+
+// Set the height of the solid box under a chunk, used as an occluder; negative for none
+void chunkSetOccluder(ChunkGrid* grid, int chunk, float top);
+
+// Test every box against the frustum planes (see extractFrustumPlanes), then sort
+// the visible chunks front to back by distance from 'eye' into grid->order.
+// Returns the number of visible chunks.
+int chunkCullAndSort(ChunkGrid* grid, float planes[6][4], const float eye[3], CullStats* stats);
+
+#endif // CHUNKS_H
@@ -0,0 +1,293 @@
+// edit.c
+#include "edit.h"
+#include "normals.h"
+#include "materials.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+TerrainEditor* createTerrainEditor(Terrain* terrain, HeightPyramid* pyramid, WaterSim* water, TerrainStore* store) {
+    if (!terrain || !terrain->heights) return NULL;
+
+    TerrainEditor* editor = (TerrainEditor*)calloc(1, sizeof(TerrainEditor));
+    if (!editor) return NULL;
+
+    editor->terrain = terrain;
+    editor->pyramid = pyramid;
+    editor->water = water;
+    if (store) {
+        editor->reader = storeRegisterReader(store);
+        if (editor->reader < 0) {
+            free(editor);
+            return NULL;
+        }
+        editor->store = store;
+    }
+    return editor;
+}
+
+void destroyTerrainEditor(TerrainEditor* editor) {
+    if (editor) {
+        free(editor->scratch);
+        free(editor);
+    }
+}
+
+static long rectArea(const DirtyRect* r) {
+    return (long)(r->x1 - r->x0) * (r->z1 - r->z0);
+}
+
+static DirtyRect rectUnion(const DirtyRect* a, const DirtyRect* b) {
+    DirtyRect u;
+    u.x0 = a->x0 < b->x0 ? a->x0 : b->x0;
+    u.z0 = a->z0 < b->z0 ? a->z0 : b->z0;
+    u.x1 = a->x1 > b->x1 ? a->x1 : b->x1;
+    u.z1 = a->z1 > b->z1 ? a->z1 : b->z1;
+    return u;
+}
+
+// Two rectangles are worth merging when they touch or overlap; the union then
+// costs little more to rebuild than the two rectangles on their own
+static int rectsTouch(const DirtyRect* a, const DirtyRect* b) {
+    return a->x0 <= b->x1 && b->x0 <= a->x1 && a->z0 <= b->z1 && b->z0 <= a->z1;
+}
+
+// Repeatedly merge touching pairs until none are left
+static int coalesceRects(DirtyRect* rects, int count) {
+    int merged = 1;
+    while (merged) {
+        merged = 0;
+        for (int i = 0; i < count && !merged; i++) {
+            for (int j = i + 1; j < count; j++) {
+                if (!rectsTouch(&rects[i], &rects[j])) continue;
+                rects[i] = rectUnion(&rects[i], &rects[j]);
+                rects[j] = rects[--count];
+                merged = 1;
+                break;
+            }
+        }
+    }
+    return count;
+}
+
+void editorMarkDirty(TerrainEditor* editor, int x0, int z0, int x1, int z1) {
+    if (!editor) return;
+    Terrain* terrain = editor->terrain;
+
+    DirtyRect rect = {
+        x0 > 0 ? x0 : 0,
+        z0 > 0 ? z0 : 0,
+        x1 < terrain->width ? x1 : terrain->width,
+        z1 < terrain->depth ? z1 : terrain->depth
+    };
+    if (rect.x0 >= rect.x1 || rect.z0 >= rect.z1) return;
+
+    // Fold into a touching rectangle, which is the common case while dragging a brush
+    for (int i = 0; i < editor->pendingCount; i++) {
+        if (rectsTouch(&editor->pending[i], &rect)) {
+            editor->pending[i] = rectUnion(&editor->pending[i], &rect);
+            editor->pendingCount = coalesceRects(editor->pending, editor->pendingCount);
+            return;
+        }
+    }
+
+    if (editor->pendingCount < EDIT_MAX_DIRTY_RECTS) {
+        editor->pending[editor->pendingCount++] = rect;
+        return;
+    }
+
+    // Full: merge into the rectangle whose area grows the least
+    int best = 0;
+    long bestGrowth = -1;
+    for (int i = 0; i < editor->pendingCount; i++) {
+        DirtyRect u = rectUnion(&editor->pending[i], &rect);
+        long growth = rectArea(&u) - rectArea(&editor->pending[i]);
+        if (bestGrowth < 0 || growth < bestGrowth) {
+            bestGrowth = growth;
+            best = i;
+        }
+    }
+    editor->pending[best] = rectUnion(&editor->pending[best], &rect);
+    editor->pendingCount = coalesceRects(editor->pending, editor->pendingCount);
+}
+
+static float clampHeight(float value) {
+    return value < 0.0f ? 0.0f : (value > 1.0f ? 1.0f : value);
+}
+
+// Brushes read and write the transaction's draft when there is one, else the terrain
+static float brushHeight(const Terrain* terrain, const TerrainTransaction* transaction, int x, int z) {
+    return transaction ? snapshotHeight(transaction->draft, x, z) : TERRAIN_HEIGHT(terrain, x, z);
+}
+
+static void setBrushHeight(Terrain* terrain, TerrainTransaction* transaction, int x, int z, float value) {
+    if (transaction) transactionSetHeight(transaction, x, z, value);
+    else TERRAIN_HEIGHT(terrain, x, z) = value;
+}
+
+void editorApplyBrush(TerrainEditor* editor, const Brush* brush, float worldX, float worldZ) {
+    if (!editor || !brush || brush->radius <= 0.0f) return;
+    Terrain* terrain = editor->terrain;
+
+    // Brush centre in cell coordinates, measured from cell centres
+    float centerX = (worldX - TERRAIN_ORIGIN_X(terrain)) / VOXEL_SIZE - 0.5f;
+    float centerZ = (worldZ - TERRAIN_ORIGIN_Z(terrain)) / VOXEL_SIZE - 0.5f;
+    float radius = brush->radius / VOXEL_SIZE;
+
+    int x0 = (int)floorf(centerX - radius);
+    int z0 = (int)floorf(centerZ - radius);
+    int x1 = (int)ceilf(centerX + radius) + 1;
+    int z1 = (int)ceilf(centerZ + radius) + 1;
+    if (x0 < 0) x0 = 0;
+    if (z0 < 0) z0 = 0;
+    if (x1 > terrain->width) x1 = terrain->width;
+    if (z1 > terrain->depth) z1 = terrain->depth;
+    if (x0 >= x1 || z0 >= z1) return;
+
+    int spanX = x1 - x0;
+    int spanZ = z1 - z0;
+
+    TerrainTransaction* transaction = NULL;
+    if (editor->store) {
+        transaction = storeBeginEdit(editor->store);
+        if (!transaction) return;
+    }
+
+    // Smoothing reads the untouched footprint plus a one-cell ring
+    if (brush->mode == BRUSH_SMOOTH) {
+        size_t needed = (size_t)(spanX + 2) * (spanZ + 2);
+        if (needed > editor->scratchFloats) {
+            float* grown = (float*)realloc(editor->scratch, needed * sizeof(float));
+            if (!grown) {
+                fprintf(stderr, "Failed to allocate brush scratch buffer.\n");
+                storeAbort(editor->store, transaction);
+                return;
+            }
+            editor->scratch = grown;
+            editor->scratchFloats = needed;
+        }
+        for (int z = -1; z <= spanZ; z++) {
+            for (int x = -1; x <= spanX; x++) {
+                int cx = x0 + x < 0 ? 0 : (x0 + x >= terrain->width ? terrain->width - 1 : x0 + x);
+                int cz = z0 + z < 0 ? 0 : (z0 + z >= terrain->depth ? terrain->depth - 1 : z0 + z);
+                editor->scratch[(z + 1) * (spanX + 2) + (x + 1)] = brushHeight(terrain, transaction, cx, cz);
+            }
+        }
+    }
+
+    float invRadiusSq = 1.0f / (radius * radius);
+    for (int z = z0; z < z1; z++) {
+        for (int x = x0; x < x1; x++) {
+            float dx = x - centerX;
+            float dz = z - centerZ;
+            float t = 1.0f - (dx * dx + dz * dz) * invRadiusSq;
+            if (t <= 0.0f) continue;
+            float falloff = t * t;  // Smooth bump, 1 at the centre and flat at the rim
+
+            float height = brushHeight(terrain, transaction, x, z);
+            switch (brush->mode) {
+                case BRUSH_RAISE:
+                    height = clampHeight(height + brush->strength * falloff);
+                    break;
+                case BRUSH_LOWER:
+                    height = clampHeight(height - brush->strength * falloff);
+                    break;
+                case BRUSH_FLATTEN:
+                    height = clampHeight(height + (brush->target - height) * brush->strength * falloff);
+                    break;
+                case BRUSH_SMOOTH: {
+                    const float* s = editor->scratch + (size_t)(z - z0 + 1) * (spanX + 2) + (x - x0 + 1);
+                    int w = spanX + 2;
+                    float average = (s[-w - 1] + s[-w] + s[-w + 1] + s[-1] + s[0] + s[1] +
+                                     s[w - 1] + s[w] + s[w + 1]) * (1.0f / 9.0f);
+                    height = clampHeight(height + (average - height) * brush->strength * falloff);
+                    break;
+                }
+            }
+            setBrushHeight(terrain, transaction, x, z, height);
+        }
+    }
+
+    if (transaction) {
+        transaction->mergeUndo = editor->strokeOpen;
+        storeCommit(editor->store, transaction);
+        editor->strokeOpen = 1;
+    }
+    editorMarkDirty(editor, x0, z0, x1, z1);
+}
+
+void editorEndStroke(TerrainEditor* editor) {
+    if (editor) editor->strokeOpen = 0;
+}
+
+static int markStoreStep(TerrainEditor* editor, int done, const int bounds[4]) {
+    if (done) editorMarkDirty(editor, bounds[0], bounds[1], bounds[2], bounds[3]);
+    return done;
+}
+
+int editorUndo(TerrainEditor* editor) {
+    if (!editor || !editor->store) return 0;
+    int bounds[4];
+    editor->strokeOpen = 0;
+    return markStoreStep(editor, storeUndo(editor->store, bounds), bounds);
+}
+
+int editorRedo(TerrainEditor* editor) {
+    if (!editor || !editor->store) return 0;
+    int bounds[4];
+    editor->strokeOpen = 0;
+    return markStoreStep(editor, storeRedo(editor->store, bounds), bounds);
+}
+
+int editorFlush(TerrainEditor* editor) {
+    if (!editor) return 0;
+
+    editor->flushedCount = 0;
+    if (editor->pendingCount == 0) return 0;
+
+    Terrain* terrain = editor->terrain;
+    int count = coalesceRects(editor->pending, editor->pendingCount);
+
+    // Bring the terrain up to the newest snapshot inside the edited rectangles
+    if (editor->store) {
+        const TerrainSnapshot* snapshot = storePin(editor->store, editor->reader);
+        for (int i = 0; i < count; i++) {
+            DirtyRect r = editor->pending[i];
+            snapshotCopyToTerrain(snapshot, terrain, r.x0, r.z0, r.x1, r.z1);
+        }
+        storeUnpin(editor->store, editor->reader);
+    }
+
+    // Edge normals read the apron, so refresh it first when an edit reaches the border
+    for (int i = 0; i < count; i++) {
+        DirtyRect r = editor->pending[i];
+        if (r.x0 == 0 || r.z0 == 0 || r.x1 == terrain->width || r.z1 == terrain->depth) {
+            terrainFillApron(terrain);
+            break;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        DirtyRect r = editor->pending[i];
+
+        // Normals, slopes and materials depend on the neighbours of an edited cell,
+        // so they are rebuilt over the rectangle grown by one cell
+        if (terrain->normals) terrainUpdateNormals(terrain, r.x0, r.z0, r.x1, r.z1);
+        if (terrain->materials) terrainUpdateMaterials(terrain, editor->water, r.x0 - 1, r.z0 - 1, r.x1 + 1, r.z1 + 1);
+        if (editor->pyramid) pyramidUpdateRect(editor->pyramid, terrain, r.x0, r.z0, r.x1, r.z1);
+        if (editor->water) waterSyncTerrainRect(editor->water, terrain, r.x0, r.z0, r.x1, r.z1);
+
+        // Render geometry around the rectangle changes too (side faces of neighbours)
+        DirtyRect grown = {
+            r.x0 > 0 ? r.x0 - 1 : 0,
+            r.z0 > 0 ? r.z0 - 1 : 0,
+            r.x1 < terrain->width ? r.x1 + 1 : terrain->width,
+            r.z1 < terrain->depth ? r.z1 + 1 : terrain->depth
+        };
+        editor->flushed[editor->flushedCount++] = grown;
+    }
+
+    editor->pendingCount = 0;
+    editor->revision++;
+    return editor->flushedCount;
+}
@@ -0,0 +1,81 @@
+// edit.h
+#ifndef EDIT_H
+#define EDIT_H
+
+#include "terrain.h"
+#include "pyramid.h"
+#include "water.h"
+#include "snapshot.h"
+#include <stddef.h>
+
+#define EDIT_MAX_DIRTY_RECTS 16   // Pending rectangles before they are merged into their neighbours
+
+// Half-open cell rectangle [x0, x1) x [z0, z1)
+typedef struct {
+    int x0, z0, x1, z1;
+} DirtyRect;
+
+typedef enum {
+    BRUSH_RAISE,
+    BRUSH_LOWER,
+    BRUSH_FLATTEN,  // Pull heights towards 'target'
+    BRUSH_SMOOTH    // Blend heights towards their 3x3 average
+} BrushMode;
+
+typedef struct {
+    BrushMode mode;
+    float radius;       // World units
+    float strength;     // Raise/lower: normalized height at the centre per stroke; flatten/smooth: blend 0-1
+    float target;       // Normalized target height for BRUSH_FLATTEN
+} Brush;
+
+// Applies brushes to a terrain and keeps everything derived from the heights in
+// step, touching only the rectangles that changed. The pyramid, water simulation
+// and store are optional.
+//
+// With a store, brushes never write Terrain.heights: each stroke commits to the
+// store (one undo step per stroke), and editorFlush copies the dirty rectangles of
+// a pinned snapshot into the terrain on the thread that owns it, so readers of the
+// terrain never see a half-applied edit.
+typedef struct {
+    Terrain* terrain;
+    HeightPyramid* pyramid;
+    WaterSim* water;
+    TerrainStore* store;
+    int reader;             // Store reader slot used by editorFlush
+    int strokeOpen;         // Commits fold into the current stroke's undo step
+
+    DirtyRect pending[EDIT_MAX_DIRTY_RECTS];    // Edited since the last flush
+    int pendingCount;
+    DirtyRect flushed[EDIT_MAX_DIRTY_RECTS];    // Rebuilt by the last flush, for render geometry
+    int flushedCount;
+    unsigned int revision;                      // Incremented by every flush that changed something
+
+    float* scratch;         // Copy of the brush footprint for smoothing
+    size_t scratchFloats;
+} TerrainEditor;
+
+TerrainEditor* createTerrainEditor(Terrain* terrain, HeightPyramid* pyramid, WaterSim* water, TerrainStore* store);
+void destroyTerrainEditor(TerrainEditor* editor);
+
+// Apply one brush stroke centred on a world-space position and record the dirty rectangle
+void editorApplyBrush(TerrainEditor* editor, const Brush* brush, float worldX, float worldZ);
+
+// Close the current stroke, so the next brush starts a new undo step
+void editorEndStroke(TerrainEditor* editor);
+
+// Step the store back or forward and mark the tiles that changed. Return 0 when
+// there is no store or nothing to undo/redo.
+int editorUndo(TerrainEditor* editor);
+int editorRedo(TerrainEditor* editor);
+
+// Mark a rectangle as edited by code that writes Terrain.heights directly (without
+// a store) or commits to the store itself
+void editorMarkDirty(TerrainEditor* editor, int x0, int z0, int x1, int z1);
+
+// Merge the pending rectangles and recompute normals, slopes, materials, pyramid
+// levels and water ground heights inside them. Call once per frame.
+// Returns the number of rectangles rebuilt (also left in editor->flushed).
+int editorFlush(TerrainEditor* editor);
+
+#endif // EDIT_H
@@ -0,0 +1,435 @@
+// erosion.c
+#include "erosion.h"
+#include "jobs.h"
+#include "utils.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EROSION_ROUNDS 8         // Droplets are spread over several rounds of all four phases
+#define EROSION_MAX_BRUSH 1024   // Upper bound on cells in an erosion brush
+
+#define THERMAL_TILE 128         // Output cells per tile edge
+#define THERMAL_MAX_HALO 8       // Steps relaxed in cache per tile load
+
+// Precomputed erosion brush: cell offsets and normalized weights within the radius
+typedef struct {
+    int count;
+    int offsetX[EROSION_MAX_BRUSH];
+    int offsetZ[EROSION_MAX_BRUSH];
+    float weight[EROSION_MAX_BRUSH];
+} ErosionBrush;
+
+typedef struct {
+    Terrain* terrain;
+    const HydraulicErosionParams* params;
+    const ErosionBrush* brush;
+    int tileSize;
+    int tilesX;
+    int tilesZ;
+    int phase;          // Checkerboard phase 0-3 currently being processed
+    int round;
+    long dropletsPerTileRound;
+    int reach;          // How far outside its tile a droplet may wander
+} ErosionPass;
+
+void defaultHydraulicErosionParams(HydraulicErosionParams* params, long droplets) {
+    params->droplets = droplets;
+    params->seed = 1;
+    params->maxLifetime = 30;
+    params->erosionRadius = 3;
+    params->inertia = 0.05f;
+    params->sedimentCapacity = 4.0f;
+    params->minSedimentCapacity = 0.01f;
+    params->erodeSpeed = 0.3f;
+    params->depositSpeed = 0.3f;
+    params->evaporateSpeed = 0.01f;
+    params->gravity = 4.0f;
+    params->initialWater = 1.0f;
+    params->initialSpeed = 1.0f;
+}
+
+static void buildBrush(ErosionBrush* brush, int radius) {
+    float total = 0.0f;
+    brush->count = 0;
+    for (int z = -radius; z <= radius; z++) {
+        for (int x = -radius; x <= radius; x++) {
+            float distance = sqrtf((float)(x * x + z * z));
+            if (distance >= radius || brush->count >= EROSION_MAX_BRUSH) continue;
+            brush->offsetX[brush->count] = x;
+            brush->offsetZ[brush->count] = z;
+            brush->weight[brush->count] = 1.0f - distance / radius;
+            total += brush->weight[brush->count];
+            brush->count++;
+        }
+    }
+    for (int i = 0; i < brush->count; i++) {
+        brush->weight[i] /= total;
+    }
+}
+
+// Height and gradient at a fractional position, bilinearly interpolated
+static float sampleGradient(const Terrain* terrain, float posX, float posZ, float* gradX, float* gradZ) {
+    int cellX = (int)posX;
+    int cellZ = (int)posZ;
+    float u = posX - cellX;
+    float v = posZ - cellZ;
+
+    const float* row = TERRAIN_ROW(terrain, cellZ);
+    const float* next = row + terrain->stride;
+    float h00 = row[cellX];
+    float h10 = row[cellX + 1];
+    float h01 = next[cellX];
+    float h11 = next[cellX + 1];
+
+    *gradX = (h10 - h00) * (1 - v) + (h11 - h01) * v;
+    *gradZ = (h01 - h00) * (1 - u) + (h11 - h10) * u;
+    return h00 * (1 - u) * (1 - v) + h10 * u * (1 - v) + h01 * (1 - u) * v + h11 * u * v;
+}
+
+// A droplet at (posX, posZ) reads and writes cells up to 'radius' away, plus
+// the +1 neighbours used for bilinear sampling; all of them must lie inside the region
+static int insideRegion(float posX, float posZ, int radius, int minX, int minZ, int maxX, int maxZ) {
+    return posX >= minX + radius && posX < maxX - radius - 1 &&
+           posZ >= minZ + radius && posZ < maxZ - radius - 1;
+}
+
+// Simulate one droplet. The droplet dies when it leaves the map or the region
+// [minX, maxX) x [minZ, maxZ) it is allowed to touch in the current phase.
+static void simulateDroplet(const ErosionPass* pass, float posX, float posZ, int minX, int minZ, int maxX, int maxZ) {
+    Terrain* terrain = pass->terrain;
+    const HydraulicErosionParams* p = pass->params;
+    const ErosionBrush* brush = pass->brush;
+    int radius = p->erosionRadius;
+
+    float dirX = 0.0f, dirZ = 0.0f;
+    float speed = p->initialSpeed;
+    float water = p->initialWater;
+    float sediment = 0.0f;
+
+    if (!insideRegion(posX, posZ, radius, minX, minZ, maxX, maxZ)) return;
+
+    for (int lifetime = 0; lifetime < p->maxLifetime; lifetime++) {
+        int cellX = (int)posX;
+        int cellZ = (int)posZ;
+        float offsetX = posX - cellX;
+        float offsetZ = posZ - cellZ;
+
+        float gradX, gradZ;
+        float height = sampleGradient(terrain, posX, posZ, &gradX, &gradZ);
+
+        // Blend the previous direction with the downhill gradient and normalize
+        dirX = dirX * p->inertia - gradX * (1 - p->inertia);
+        dirZ = dirZ * p->inertia - gradZ * (1 - p->inertia);
+        float length = sqrtf(dirX * dirX + dirZ * dirZ);
+        if (length != 0.0f) {
+            dirX /= length;
+            dirZ /= length;
+        }
+        posX += dirX;
+        posZ += dirZ;
+
+        // Stop when the droplet stalls or leaves the cells it may touch
+        if ((dirX == 0.0f && dirZ == 0.0f) || !insideRegion(posX, posZ, radius, minX, minZ, maxX, maxZ)) {
+            break;
+        }
+
+        float unusedX, unusedZ;
+        float newHeight = sampleGradient(terrain, posX, posZ, &unusedX, &unusedZ);
+        float deltaHeight = newHeight - height;
+
+        float capacity = fmaxf(-deltaHeight * speed * water * p->sedimentCapacity, p->minSedimentCapacity);
+
+        if (sediment > capacity || deltaHeight > 0) {
+            // Deposit into the four cells around the old position; when moving uphill
+            // fill the pit up to the new height at most
+            float amount = deltaHeight > 0 ? fminf(deltaHeight, sediment) : (sediment - capacity) * p->depositSpeed;
+            sediment -= amount;
+
+            float* row = TERRAIN_ROW(terrain, cellZ);
+            float* next = row + terrain->stride;
+            row[cellX] += amount * (1 - offsetX) * (1 - offsetZ);
+            row[cellX + 1] += amount * offsetX * (1 - offsetZ);
+            next[cellX] += amount * (1 - offsetX) * offsetZ;
+            next[cellX + 1] += amount * offsetX * offsetZ;
+        } else {
+            // Erode no more than the height difference, spread over the brush
+            float amount = fminf((capacity - sediment) * p->erodeSpeed, -deltaHeight);
+            for (int i = 0; i < brush->count; i++) {
+                float* cell = &TERRAIN_HEIGHT(terrain, cellX + brush->offsetX[i], cellZ + brush->offsetZ[i]);
+                float weighted = amount * brush->weight[i];
+                float removed = *cell < weighted ? *cell : weighted;
+                *cell -= removed;
+                sediment += removed;
+            }
+        }
+
+        speed = sqrtf(fmaxf(speed * speed + deltaHeight * p->gravity, 0.0f));
+        water *= (1 - p->evaporateSpeed);
+    }
+}
+
+// Run this round's droplets for one tile of the current phase
+static void erodeTileJob(void* context, int index, int worker) {
+    (void)worker;
+    const ErosionPass* pass = (const ErosionPass*)context;
+    Terrain* terrain = pass->terrain;
+
+    // Map the job index onto the tiles of this checkerboard phase
+    int phaseX = pass->phase & 1;
+    int phaseZ = pass->phase >> 1;
+    int phaseTilesX = (pass->tilesX - phaseX + 1) / 2;
+    int tileX = (index % phaseTilesX) * 2 + phaseX;
+    int tileZ = (index / phaseTilesX) * 2 + phaseZ;
+
+    int x0 = tileX * pass->tileSize;
+    int z0 = tileZ * pass->tileSize;
+    int x1 = x0 + pass->tileSize < terrain->width ? x0 + pass->tileSize : terrain->width;
+    int z1 = z0 + pass->tileSize < terrain->depth ? z0 + pass->tileSize : terrain->depth;
+
+    // Region this tile's droplets may touch, clamped to the map
+    int minX = x0 - pass->reach > 0 ? x0 - pass->reach : 0;
+    int minZ = z0 - pass->reach > 0 ? z0 - pass->reach : 0;
+    int maxX = x1 + pass->reach < terrain->width ? x1 + pass->reach : terrain->width;
+    int maxZ = z1 + pass->reach < terrain->depth ? z1 + pass->reach : terrain->depth;
+
+    unsigned int tileId = (unsigned int)(tileZ * pass->tilesX + tileX);
+    unsigned int first = (unsigned int)(pass->round * pass->dropletsPerTileRound);
+    for (long i = 0; i < pass->dropletsPerTileRound; i++) {
+        // Two independent draws per droplet, keyed by tile and droplet number only
+        unsigned int counter = (first + (unsigned int)i) * 2u;
+        unsigned int seed = pass->params->seed ^ (tileId * 0x27D4EB2Du);
+        float rx = (hashCounter(seed, counter) >> 8) * (1.0f / 16777216.0f);
+        float rz = (hashCounter(seed, counter + 1) >> 8) * (1.0f / 16777216.0f);
+        simulateDroplet(pass, x0 + rx * (x1 - x0), z0 + rz * (z1 - z0), minX, minZ, maxX, maxZ);
+    }
+}
+
+void erodeTerrainHydraulic(Terrain* terrain, const HydraulicErosionParams* params, HydraulicErosionStats* stats) {
+    if (!terrain || !terrain->heights || !params || params->droplets <= 0) return;
+
+    double start = getTimeSeconds();
+
+    ErosionBrush* brush = (ErosionBrush*)malloc(sizeof(ErosionBrush));
+    if (!brush) {
+        fprintf(stderr, "Failed to allocate erosion brush.\n");
+        return;
+    }
+    int radius = params->erosionRadius > 0 ? params->erosionRadius : 1;
+    buildBrush(brush, radius);
+
+    // A droplet moves at most one cell per step, so tiles twice the droplet's reach
+    // guarantee that two tiles of the same phase never share a cell
+    ErosionPass pass;
+    pass.terrain = terrain;
+    pass.params = params;
+    pass.brush = brush;
+    pass.reach = params->maxLifetime + radius + 2;
+    pass.tileSize = 2 * pass.reach + 2;
+    pass.tilesX = (terrain->width + pass.tileSize - 1) / pass.tileSize;
+    pass.tilesZ = (terrain->depth + pass.tileSize - 1) / pass.tileSize;
+
+    long tiles = (long)pass.tilesX * pass.tilesZ;
+    pass.dropletsPerTileRound = params->droplets / (tiles * EROSION_ROUNDS);
+    if (pass.dropletsPerTileRound < 1) pass.dropletsPerTileRound = 1;
+
+    for (pass.round = 0; pass.round < EROSION_ROUNDS; pass.round++) {
+        for (pass.phase = 0; pass.phase < 4; pass.phase++) {
+            int phaseTilesX = (pass.tilesX - (pass.phase & 1) + 1) / 2;
+            int phaseTilesZ = (pass.tilesZ - (pass.phase >> 1) + 1) / 2;
+            jobsParallelFor(phaseTilesX * phaseTilesZ, erodeTileJob, &pass);
+        }
+    }
+
+    free(brush);
+    terrainFillApron(terrain);
+
+    double seconds = getTimeSeconds() - start;
+    if (stats) {
+        stats->droplets = pass.dropletsPerTileRound * tiles * EROSION_ROUNDS;
+        stats->seconds = seconds;
+        stats->dropletsPerSecond = seconds > 0.0 ? stats->droplets / seconds : 0.0;
+    }
+}
+
+void defaultThermalErosionParams(ThermalErosionParams* params, int iterations) {
+    params->iterations = iterations;
+    params->talus = 1.0f / MAX_HEIGHT;  // One voxel of drop per cell
+    params->rate = 0.1f;
+}
+
+typedef struct {
+    const Terrain* source;
+    Terrain* destination;
+    const ThermalErosionParams* params;
+    int tilesX;
+    int halo;           // Steps to run for each tile in this group
+    int localStride;    // Floats per row of the per-worker scratch tiles
+    float* scratch;     // Two scratch tiles per worker
+} ThermalPass;
+
+// max(v, 0) as a plain select; unlike fmaxf this compiles to a single SIMD max
+// without needing fast-math flags
+static inline float positivePart(float v) {
+    return v > 0.0f ? v : 0.0f;
+}
+
+// One relaxation step for cells [1, count - 1) of a row. Written as straight-line
+// arithmetic over whole rows so the compiler emits SIMD code for it.
+static void thermalRow(float* restrict out, const float* restrict up, const float* restrict row,
+                       const float* restrict down, int count, float talus, float rate) {
+    for (int x = 1; x < count - 1; x++) {
+        float h = row[x];
+        float dl = row[x - 1] - h;
+        float dr = row[x + 1] - h;
+        float du = up[x] - h;
+        float dd = down[x] - h;
+        float gain = positivePart(dl - talus) + positivePart(dr - talus) +
+                     positivePart(du - talus) + positivePart(dd - talus);
+        float loss = positivePart(-dl - talus) + positivePart(-dr - talus) +
+                     positivePart(-du - talus) + positivePart(-dd - talus);
+        out[x] = h + rate * (gain - loss);
+    }
+}
+
+static int clampInt(int value, int lo, int hi) {
+    return value < lo ? lo : (value > hi ? hi : value);
+}
+
+static void thermalTileJob(void* context, int index, int worker) {
+    const ThermalPass* pass = (const ThermalPass*)context;
+    const Terrain* source = pass->source;
+    int width = source->width;
+    int depth = source->depth;
+    int halo = pass->halo;
+    int stride = pass->localStride;
+
+    int tileX = index % pass->tilesX;
+    int tileZ = index / pass->tilesX;
+    int x0 = tileX * THERMAL_TILE;
+    int z0 = tileZ * THERMAL_TILE;
+    int x1 = x0 + THERMAL_TILE < width ? x0 + THERMAL_TILE : width;
+    int z1 = z0 + THERMAL_TILE < depth ? z0 + THERMAL_TILE : depth;
+
+    // Local tile covers [x0 - halo, x1 + halo) plus one ring the kernel reads but never writes
+    int originX = x0 - halo - 1;
+    int originZ = z0 - halo - 1;
+    int localW = (x1 - x0) + 2 * halo + 2;
+    int localD = (z1 - z0) + 2 * halo + 2;
+
+    size_t tileFloats = (size_t)stride * (THERMAL_TILE + 2 * THERMAL_MAX_HALO + 2);
+    float* current = pass->scratch + (size_t)worker * 2 * tileFloats;
+    float* next = current + tileFloats;
+
+    // Load with clamped coordinates so cells beyond the map mirror the edge
+    for (int lz = 0; lz < localD; lz++) {
+        const float* row = TERRAIN_ROW(source, clampInt(originZ + lz, 0, depth - 1));
+        float* local = current + (size_t)lz * stride;
+        for (int lx = 0; lx < localW; lx++) {
+            local[lx] = row[clampInt(originX + lx, 0, width - 1)];
+        }
+    }
+
+    for (int step = 0; step < halo; step++) {
+        for (int lz = 1; lz < localD - 1; lz++) {
+            float* row = current + (size_t)lz * stride;
+            thermalRow(next + (size_t)lz * stride, row - stride, row, row + stride,
+                       localW, pass->params->talus, pass->params->rate);
+        }
+
+        // Cells outside the map keep mirroring their edge cell, which makes the
+        // border a no-flux boundary exactly as in a single-step global update.
+        // Only tiles touching the map edge have such cells.
+        int firstX = clampInt(-originX, 1, localW - 1);
+        int endX = clampInt(width - originX, 1, localW - 1);
+        for (int lz = 1; lz < localD - 1; lz++) {
+            int sourceZ = clampInt(originZ + lz, 0, depth - 1) - originZ;
+            float* row = next + (size_t)lz * stride;
+            if (sourceZ != lz) {
+                memcpy(row + 1, next + (size_t)sourceZ * stride + 1, (size_t)(localW - 2) * sizeof(float));
+            }
+            for (int lx = 1; lx < firstX; lx++) row[lx] = row[firstX];
+            for (int lx = endX; lx < localW - 1; lx++) row[lx] = row[endX - 1];
+        }
+
+        float* swap = current;
+        current = next;
+        next = swap;
+    }
+
+    // After 'halo' steps only the centre tile is exact; write it out
+    for (int z = z0; z < z1; z++) {
+        const float* local = current + (size_t)(z - originZ) * stride + (x0 - originX);
+        float* row = TERRAIN_ROW(pass->destination, z);
+        for (int x = x0; x < x1; x++) {
+            row[x] = local[x - x0];
+        }
+    }
+}
+
+void erodeTerrainThermal(Terrain* terrain, const ThermalErosionParams* params, ThermalErosionStats* stats) {
+    if (!terrain || !terrain->heights || !params || params->iterations <= 0) return;
+
+    double start = getTimeSeconds();
+
+    // Second buffer with the same layout; the two swap storage after every group
+    Terrain* buffer = createTerrainWithApron(terrain->width, terrain->depth, terrain->apron);
+    int workers = jobsWorkerCount();
+    int localStride = (THERMAL_TILE + 2 * THERMAL_MAX_HALO + 2 + TERRAIN_ROW_FLOATS - 1) & ~(TERRAIN_ROW_FLOATS - 1);
+    size_t tileFloats = (size_t)localStride * (THERMAL_TILE + 2 * THERMAL_MAX_HALO + 2);
+    float* scratch = (float*)aligned_alloc(TERRAIN_ALIGNMENT, (size_t)workers * 2 * tileFloats * sizeof(float));
+    if (!buffer || !scratch) {
+        fprintf(stderr, "Failed to allocate thermal erosion buffers.\n");
+        destroyTerrain(buffer);
+        free(scratch);
+        return;
+    }
+
+    ThermalPass pass;
+    pass.params = params;
+    pass.tilesX = (terrain->width + THERMAL_TILE - 1) / THERMAL_TILE;
+    pass.localStride = localStride;
+    pass.scratch = scratch;
+    int tilesZ = (terrain->depth + THERMAL_TILE - 1) / THERMAL_TILE;
+    float* originalStorage = terrain->storage;
+    float* originalHeights = terrain->heights;
+
+    for (int done = 0; done < params->iterations; done += pass.halo) {
+        pass.halo = params->iterations - done < THERMAL_MAX_HALO ? params->iterations - done : THERMAL_MAX_HALO;
+        pass.source = terrain;
+        pass.destination = buffer;
+        jobsParallelFor(pass.tilesX * tilesZ, thermalTileJob, &pass);
+
+        // The freshly written buffer becomes the terrain's storage
+        float* storage = terrain->storage;
+        float* heights = terrain->heights;
+        terrain->storage = buffer->storage;
+        terrain->heights = buffer->heights;
+        buffer->storage = storage;
+        buffer->heights = heights;
+    }
+
+    // After an odd number of groups the result is in the second buffer. Copy it
+    // back so pointers into terrain->heights held by callers stay valid.
+    if (terrain->heights != originalHeights) {
+        for (int z = 0; z < terrain->depth; z++) {
+            memcpy(originalHeights + (size_t)z * terrain->stride, TERRAIN_ROW(terrain, z), (size_t)terrain->width * sizeof(float));
+        }
+        buffer->storage = terrain->storage;
+        buffer->heights = terrain->heights;
+        terrain->storage = originalStorage;
+        terrain->heights = originalHeights;
+    }
+
+    destroyTerrain(buffer);
+    free(scratch);
+    terrainFillApron(terrain);
+
+    double seconds = getTimeSeconds() - start;
+    if (stats) {
+        stats->iterations = params->iterations;
+        stats->seconds = seconds;
+        stats->cellsPerSecond = seconds > 0.0 ? (double)terrain->width * terrain->depth * params->iterations / seconds : 0.0;
+    }
+}
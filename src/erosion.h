@@ -0,0 +1,62 @@
+// erosion.h
+#ifndef EROSION_H
+#define EROSION_H
+
+#include "terrain.h"
+
+// Parameters for droplet-based hydraulic erosion. Heights are the normalized
+// 0-1 values produced by generateTerrain, so the defaults below are tuned for that range.
+typedef struct {
+    long droplets;              // Total droplets to simulate
+    unsigned int seed;          // Seed for the counter-based RNG; same seed -> same result
+    int maxLifetime;            // Steps before a droplet evaporates completely
+    int erosionRadius;          // Radius of the erosion brush in cells
+    float inertia;              // 0 = follow the gradient, 1 = keep the previous direction
+    float sedimentCapacity;     // Multiplier for how much sediment a droplet can carry
+    float minSedimentCapacity;  // Keeps capacity above zero on flat ground
+    float erodeSpeed;
+    float depositSpeed;
+    float evaporateSpeed;
+    float gravity;
+    float initialWater;
+    float initialSpeed;
+} HydraulicErosionParams;
+
+typedef struct {
+    long droplets;              // Droplets actually simulated
+    double seconds;             // Wall-clock time of the pass
+    double dropletsPerSecond;
+} HydraulicErosionStats;
+
+// Fill params with the default settings and 'droplets' droplets
+void defaultHydraulicErosionParams(HydraulicErosionParams* params, long droplets);
+
+// Run hydraulic erosion over terrain->heights on all cores. The map is split into
+// tiles that are processed in four checkerboard phases; tiles of the same phase are
+// far enough apart that their droplets never touch the same cells, so the result
+// does not depend on thread count or scheduling. stats may be NULL.
+void erodeTerrainHydraulic(Terrain* terrain, const HydraulicErosionParams* params, HydraulicErosionStats* stats);
+
+// Parameters for thermal (talus) erosion. Material slides from a cell to each of its
+// four neighbours whenever the height difference exceeds 'talus'.
+typedef struct {
+    int iterations;     // Relaxation steps to run in this call
+    float talus;        // Stable height difference between neighbouring cells
+    float rate;         // Fraction of the excess moved per neighbour per step; <= 0.125 is stable
+} ThermalErosionParams;
+
+typedef struct {
+    int iterations;
+    double seconds;
+    double cellsPerSecond;      // Cell updates per second (cells x iterations)
+} ThermalErosionStats;
+
+void defaultThermalErosionParams(ThermalErosionParams* params, int iterations);
+
+// Run thermal erosion over terrain->heights. Iterations are grouped so that each
+// tile is loaded once with a halo as wide as the group and relaxed several steps in
+// cache before being written to a second buffer. The result ends up in the
+// terrain's own storage, so terrain->heights is unchanged. stats may be NULL.
+void erodeTerrainThermal(Terrain* terrain, const ThermalErosionParams* params, ThermalErosionStats* stats);
+
+#endif // EROSION_H
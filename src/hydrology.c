@@ -0,0 +1,480 @@
+// hydrology.c
+#include "hydrology.h"
+#include "jobs.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HYDROLOGY_BAND_ROWS 64      // Rows per job for per-cell passes
+#define HYDROLOGY_LEVEL_CHUNK 4096  // Cells per job when accumulating one level
+
+// Neighbour offsets counter-clockwise from +x, matching flowAngle = k * pi / 4
+static const int neighbourX[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+static const int neighbourZ[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+
+Hydrology* createHydrology(int width, int depth) {
+    if (width <= 0 || depth <= 0) return NULL;
+
+    Hydrology* hydrology = (Hydrology*)calloc(1, sizeof(Hydrology));
+    if (!hydrology) return NULL;
+
+    size_t cells = (size_t)width * depth;
+    hydrology->width = width;
+    hydrology->depth = depth;
+    hydrology->filled = (float*)malloc(cells * sizeof(float));
+    hydrology->order = (int*)malloc(cells * sizeof(int));
+    hydrology->parent = (int*)malloc(cells * sizeof(int));
+    hydrology->receiver = (int*)malloc(cells * sizeof(int));
+    hydrology->receiver2 = (int*)malloc(cells * sizeof(int));
+    hydrology->weight = (float*)malloc(cells * sizeof(float));
+    hydrology->flowAngle = (float*)malloc(cells * sizeof(float));
+    hydrology->level = (int*)malloc(cells * sizeof(int));
+    hydrology->accumulation = (float*)malloc(cells * sizeof(float));
+
+    if (!hydrology->filled || !hydrology->order || !hydrology->parent || !hydrology->receiver ||
+        !hydrology->receiver2 || !hydrology->weight || !hydrology->flowAngle || !hydrology->level ||
+        !hydrology->accumulation) {
+        destroyHydrology(hydrology);
+        return NULL;
+    }
+
+    return hydrology;
+}
+
+void destroyHydrology(Hydrology* hydrology) {
+    if (!hydrology) return;
+    free(hydrology->filled);
+    free(hydrology->order);
+    free(hydrology->parent);
+    free(hydrology->receiver);
+    free(hydrology->receiver2);
+    free(hydrology->weight);
+    free(hydrology->flowAngle);
+    free(hydrology->level);
+    free(hydrology->accumulation);
+    free(hydrology);
+}
+
+// ---------------------------------------------------------------------------
+// Priority queues. Both pop cells in nondecreasing height; ties pop in insertion
+// order so results are deterministic.
+
+typedef struct {
+    float height;
+    unsigned int sequence;
+    int cell;
+} HeapEntry;
+
+typedef struct {
+    HeapEntry* entries;
+    size_t count;
+    unsigned int sequence;
+} CellHeap;
+
+static int heapLess(const HeapEntry* a, const HeapEntry* b) {
+    return a->height < b->height || (a->height == b->height && a->sequence < b->sequence);
+}
+
+static void heapPush(CellHeap* heap, float height, int cell) {
+    size_t i = heap->count++;
+    HeapEntry entry = { height, heap->sequence++, cell };
+    while (i > 0) {
+        size_t up = (i - 1) / 2;
+        if (!heapLess(&entry, &heap->entries[up])) break;
+        heap->entries[i] = heap->entries[up];
+        i = up;
+    }
+    heap->entries[i] = entry;
+}
+
+static int heapPop(CellHeap* heap) {
+    int cell = heap->entries[0].cell;
+    HeapEntry last = heap->entries[--heap->count];
+    size_t i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= heap->count) break;
+        if (child + 1 < heap->count && heapLess(&heap->entries[child + 1], &heap->entries[child])) child++;
+        if (!heapLess(&heap->entries[child], &last)) break;
+        heap->entries[i] = heap->entries[child];
+        i = child;
+    }
+    heap->entries[i] = last;
+    return cell;
+}
+
+// Bucket queue over quantized heights: one FIFO list per level, threaded through
+// a shared 'next' array. The flood only ever pushes at or above the current
+// level, so a single forward sweep over the buckets pops everything in O(N + levels).
+typedef struct {
+    int* head;
+    int* tail;
+    int* next;
+    int levels;
+    int current;
+} BucketQueue;
+
+static int quantizeHeight(float height, int levels) {
+    if (height <= 0.0f) return 0;
+    if (height >= 1.0f) return levels - 1;
+    return (int)(height * (levels - 1));
+}
+
+static void bucketPush(BucketQueue* queue, int level, int cell) {
+    if (level < queue->current) level = queue->current;
+    queue->next[cell] = -1;
+    if (queue->tail[level] < 0) {
+        queue->head[level] = cell;
+    } else {
+        queue->next[queue->tail[level]] = cell;
+    }
+    queue->tail[level] = cell;
+}
+
+static int bucketPop(BucketQueue* queue) {
+    while (queue->current < queue->levels && queue->head[queue->current] < 0) {
+        queue->current++;
+    }
+    if (queue->current >= queue->levels) return -1;
+    int cell = queue->head[queue->current];
+    queue->head[queue->current] = queue->next[cell];
+    if (queue->head[queue->current] < 0) queue->tail[queue->current] = -1;
+    return cell;
+}
+
+// ---------------------------------------------------------------------------
+
+void hydrologyFillDepressions(Hydrology* hydrology, const Terrain* terrain, int quantizeLevels) {
+    if (!hydrology || !terrain || !terrain->heights) return;
+    if (terrain->width != hydrology->width || terrain->depth != hydrology->depth) return;
+
+    int width = hydrology->width;
+    int depth = hydrology->depth;
+    size_t cells = (size_t)width * depth;
+
+    unsigned char* queued = (unsigned char*)calloc(cells, 1);
+    CellHeap heap = { NULL, 0, 0 };
+    BucketQueue buckets = { NULL, NULL, NULL, quantizeLevels, 0 };
+    if (quantizeLevels > 0) {
+        buckets.head = (int*)malloc((size_t)quantizeLevels * sizeof(int));
+        buckets.tail = (int*)malloc((size_t)quantizeLevels * sizeof(int));
+        buckets.next = (int*)malloc(cells * sizeof(int));
+        if (buckets.head) memset(buckets.head, 0xff, (size_t)quantizeLevels * sizeof(int));
+        if (buckets.tail) memset(buckets.tail, 0xff, (size_t)quantizeLevels * sizeof(int));
+    } else {
+        heap.entries = (HeapEntry*)malloc(cells * sizeof(HeapEntry));
+    }
+    if (!queued || (quantizeLevels > 0 ? (!buckets.head || !buckets.tail || !buckets.next) : !heap.entries)) {
+        fprintf(stderr, "Failed to allocate priority-flood queues.\n");
+        free(queued);
+        free(heap.entries);
+        free(buckets.head);
+        free(buckets.tail);
+        free(buckets.next);
+        return;
+    }
+
+    // Seed the flood with every edge cell; they drain straight off the map
+    for (int z = 0; z < depth; z++) {
+        for (int x = 0; x < width; x++) {
+            if (x != 0 && z != 0 && x != width - 1 && z != depth - 1) continue;
+            int cell = z * width + x;
+            float height = TERRAIN_HEIGHT(terrain, x, z);
+            hydrology->filled[cell] = height;
+            hydrology->parent[cell] = -1;
+            queued[cell] = 1;
+            if (quantizeLevels > 0) {
+                bucketPush(&buckets, quantizeHeight(height, quantizeLevels), cell);
+            } else {
+                heapPush(&heap, height, cell);
+            }
+        }
+    }
+
+    // Grow inwards from the lowest queued cell. A neighbour lower than the cell that
+    // reaches it lies in a depression and is raised to that cell's level.
+    size_t popped = 0;
+    for (;;) {
+        int cell;
+        if (quantizeLevels > 0) {
+            cell = bucketPop(&buckets);
+            if (cell < 0) break;
+        } else {
+            if (heap.count == 0) break;
+            cell = heapPop(&heap);
+        }
+        hydrology->order[popped++] = cell;
+
+        int cx = cell % width;
+        int cz = cell / width;
+        float spill = hydrology->filled[cell];
+        for (int k = 0; k < 8; k++) {
+            int nx = cx + neighbourX[k];
+            int nz = cz + neighbourZ[k];
+            if (nx < 0 || nx >= width || nz < 0 || nz >= depth) continue;
+            int neighbour = nz * width + nx;
+            if (queued[neighbour]) continue;
+            queued[neighbour] = 1;
+
+            float height = TERRAIN_HEIGHT(terrain, nx, nz);
+            float level = height > spill ? height : spill;
+            hydrology->filled[neighbour] = level;
+            hydrology->parent[neighbour] = cell;
+            if (quantizeLevels > 0) {
+                bucketPush(&buckets, quantizeHeight(level, quantizeLevels), neighbour);
+            } else {
+                heapPush(&heap, level, neighbour);
+            }
+        }
+    }
+
+    free(queued);
+    free(heap.entries);
+    free(buckets.head);
+    free(buckets.tail);
+    free(buckets.next);
+}
+
+typedef struct {
+    Hydrology* hydrology;
+    FlowMethod method;
+} FlowPass;
+
+// Pick receivers for one cell. Only strictly lower neighbours of the filled surface
+// qualify, apart from the flood parent on flats; parent links form a tree, so the
+// flow graph stays acyclic.
+static void computeCellFlow(Hydrology* hydrology, FlowMethod method, int x, int z) {
+    int width = hydrology->width;
+    int cell = z * width + x;
+    const float* filled = hydrology->filled;
+    float center = filled[cell];
+
+    // Out-of-map neighbours repeat the centre height, so they never receive flow
+    float e[8];
+    for (int k = 0; k < 8; k++) {
+        int nx = x + neighbourX[k];
+        int nz = z + neighbourZ[k];
+        e[k] = (nx < 0 || nx >= width || nz < 0 || nz >= hydrology->depth) ? center : filled[nz * width + nx];
+    }
+
+    int best = -1;
+    float bestSlope = 0.0f;
+    float bestAngle = 0.0f;
+    float bestShare = 1.0f;     // D-inf: fraction going to the first facet cell
+
+    if (method == FLOW_D8) {
+        for (int k = 0; k < 8; k++) {
+            float slope = (center - e[k]) / ((k & 1) ? 1.41421356f : 1.0f);
+            if (slope > bestSlope) {
+                bestSlope = slope;
+                best = k;
+                bestAngle = k * 0.78539816f;
+            }
+        }
+    } else {
+        // Eight triangular facets, each between cardinal neighbour k and diagonal k + 1
+        // (or diagonal k and cardinal k + 1); take the steepest downhill plane
+        for (int k = 0; k < 8; k++) {
+            int cardinal = (k & 1) ? (k + 1) & 7 : k;
+            int diagonal = (k & 1) ? k : k + 1;
+            float s1 = center - e[cardinal];
+            float s2 = e[cardinal] - e[diagonal];
+            float r = atan2f(s2, s1);
+            float slope;
+            if (r < 0.0f) {
+                r = 0.0f;
+                slope = s1;
+            } else if (r > 0.78539816f) {
+                r = 0.78539816f;
+                slope = (center - e[diagonal]) / 1.41421356f;
+            } else {
+                slope = sqrtf(s1 * s1 + s2 * s2);
+            }
+            if (slope > bestSlope) {
+                bestSlope = slope;
+                best = k;
+                // Share of the flow for the facet's first cell in counter-clockwise order
+                float fraction = r / 0.78539816f;
+                bestShare = (k & 1) ? fraction : 1.0f - fraction;
+                bestAngle = (k & 1) ? (k + 1) * 0.78539816f - r : k * 0.78539816f + r;
+            }
+        }
+    }
+
+    hydrology->receiver2[cell] = -1;
+    hydrology->weight[cell] = 1.0f;
+
+    if (best < 0) {
+        // Flat or pit-free edge: follow the flood back towards the outlet
+        int parent = hydrology->parent[cell];
+        hydrology->receiver[cell] = parent;
+        if (parent >= 0) {
+            hydrology->flowAngle[cell] = atan2f((float)(parent / width - z), (float)(parent % width - x));
+            if (hydrology->flowAngle[cell] < 0.0f) hydrology->flowAngle[cell] += 6.28318531f;
+        } else {
+            hydrology->flowAngle[cell] = -1.0f;
+        }
+        return;
+    }
+
+    hydrology->flowAngle[cell] = bestAngle;
+    int first = best;
+    int second = (best + 1) & 7;
+    int firstCell = (z + neighbourZ[first]) * width + (x + neighbourX[first]);
+    hydrology->receiver[cell] = firstCell;
+
+    if (method == FLOW_DINF && bestShare < 1.0f) {
+        // Drop a facet cell that is not strictly lower or lies off the map
+        int nx = x + neighbourX[second];
+        int nz = z + neighbourZ[second];
+        int inside = nx >= 0 && nx < width && nz >= 0 && nz < hydrology->depth;
+        if (inside && e[second] < center) {
+            if (bestShare <= 0.0f || !(e[first] < center)) {
+                hydrology->receiver[cell] = nz * width + nx;
+            } else {
+                hydrology->receiver2[cell] = nz * width + nx;
+                hydrology->weight[cell] = bestShare;
+            }
+        }
+    }
+}
+
+static void flowBandJob(void* context, int band, int worker) {
+    (void)worker;
+    FlowPass* pass = (FlowPass*)context;
+    Hydrology* hydrology = pass->hydrology;
+    int z0 = band * HYDROLOGY_BAND_ROWS;
+    int z1 = z0 + HYDROLOGY_BAND_ROWS < hydrology->depth ? z0 + HYDROLOGY_BAND_ROWS : hydrology->depth;
+    for (int z = z0; z < z1; z++) {
+        for (int x = 0; x < hydrology->width; x++) {
+            computeCellFlow(hydrology, pass->method, x, z);
+        }
+    }
+}
+
+void hydrologyComputeFlow(Hydrology* hydrology, FlowMethod method) {
+    if (!hydrology) return;
+    FlowPass pass = { hydrology, method };
+    int bands = (hydrology->depth + HYDROLOGY_BAND_ROWS - 1) / HYDROLOGY_BAND_ROWS;
+    jobsParallelFor(bands, flowBandJob, &pass);
+}
+
+typedef struct {
+    Hydrology* hydrology;
+    const int* cells;       // Cells of the level being accumulated
+    int count;
+} AccumulatePass;
+
+// Pull flow from every neighbour that drains into the cell. All donors sit on a
+// lower level, so they are final, and no two jobs write the same cell.
+static void accumulateChunkJob(void* context, int chunk, int worker) {
+    (void)worker;
+    AccumulatePass* pass = (AccumulatePass*)context;
+    Hydrology* hydrology = pass->hydrology;
+    int width = hydrology->width;
+    int depth = hydrology->depth;
+    int start = chunk * HYDROLOGY_LEVEL_CHUNK;
+    int end = start + HYDROLOGY_LEVEL_CHUNK < pass->count ? start + HYDROLOGY_LEVEL_CHUNK : pass->count;
+
+    for (int i = start; i < end; i++) {
+        int cell = pass->cells[i];
+        int x = cell % width;
+        int z = cell / width;
+        float total = 1.0f;
+        for (int k = 0; k < 8; k++) {
+            int nx = x + neighbourX[k];
+            int nz = z + neighbourZ[k];
+            if (nx < 0 || nx >= width || nz < 0 || nz >= depth) continue;
+            int donor = nz * width + nx;
+            if (hydrology->receiver[donor] == cell) {
+                total += hydrology->accumulation[donor] * hydrology->weight[donor];
+            } else if (hydrology->receiver2[donor] == cell) {
+                total += hydrology->accumulation[donor] * (1.0f - hydrology->weight[donor]);
+            }
+        }
+        hydrology->accumulation[cell] = total;
+    }
+}
+
+void hydrologyAccumulate(Hydrology* hydrology) {
+    if (!hydrology) return;
+
+    int cells = hydrology->width * hydrology->depth;
+    int* level = hydrology->level;
+
+    // Kahn's algorithm: a cell's level is final once all of its donors are done
+    int* pending = (int*)calloc((size_t)cells, sizeof(int));
+    int* queue = (int*)malloc((size_t)cells * sizeof(int));
+    if (!pending || !queue) {
+        fprintf(stderr, "Failed to allocate flow accumulation buffers.\n");
+        free(pending);
+        free(queue);
+        return;
+    }
+    for (int cell = 0; cell < cells; cell++) {
+        if (hydrology->receiver[cell] >= 0) pending[hydrology->receiver[cell]]++;
+        if (hydrology->receiver2[cell] >= 0) pending[hydrology->receiver2[cell]]++;
+    }
+
+    int head = 0;
+    int tail = 0;
+    for (int cell = 0; cell < cells; cell++) {
+        level[cell] = 0;
+        if (pending[cell] == 0) queue[tail++] = cell;
+    }
+
+    int maxLevel = 0;
+    while (head < tail) {
+        int cell = queue[head++];
+        int next = level[cell] + 1;
+        if (level[cell] > maxLevel) maxLevel = level[cell];
+        int receivers[2] = { hydrology->receiver[cell], hydrology->receiver2[cell] };
+        for (int r = 0; r < 2; r++) {
+            int target = receivers[r];
+            if (target < 0) continue;
+            if (level[target] < next) level[target] = next;
+            if (--pending[target] == 0) queue[tail++] = target;
+        }
+    }
+    free(pending);
+    free(queue);
+
+    // Counting sort of the cells by level
+    int* offsets = (int*)calloc((size_t)maxLevel + 2, sizeof(int));
+    int* sorted = (int*)malloc((size_t)cells * sizeof(int));
+    if (!offsets || !sorted) {
+        fprintf(stderr, "Failed to allocate flow accumulation buffers.\n");
+        free(offsets);
+        free(sorted);
+        return;
+    }
+    for (int cell = 0; cell < cells; cell++) offsets[level[cell] + 1]++;
+    for (int l = 0; l <= maxLevel; l++) offsets[l + 1] += offsets[l];
+    int* cursor = (int*)malloc(((size_t)maxLevel + 1) * sizeof(int));
+    if (!cursor) {
+        free(offsets);
+        free(sorted);
+        return;
+    }
+    memcpy(cursor, offsets, ((size_t)maxLevel + 1) * sizeof(int));
+    for (int cell = 0; cell < cells; cell++) sorted[cursor[level[cell]]++] = cell;
+    free(cursor);
+
+    // Levels run in order; cells inside one level are independent
+    AccumulatePass pass;
+    pass.hydrology = hydrology;
+    for (int l = 0; l <= maxLevel; l++) {
+        pass.cells = sorted + offsets[l];
+        pass.count = offsets[l + 1] - offsets[l];
+        int chunks = (pass.count + HYDROLOGY_LEVEL_CHUNK - 1) / HYDROLOGY_LEVEL_CHUNK;
+        if (chunks == 1) {
+            accumulateChunkJob(&pass, 0, 0);
+        } else {
+            jobsParallelFor(chunks, accumulateChunkJob, &pass);
+        }
+    }
+
+    free(offsets);
+    free(sorted);
+}
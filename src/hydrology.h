@@ -0,0 +1,45 @@
+// hydrology.h
+#ifndef HYDROLOGY_H
+#define HYDROLOGY_H
+
+#include "terrain.h"
+
+#define HYDROLOGY_DEFAULT_LEVELS 65536  // Height quantization for the bucketed flood
+
+typedef enum {
+    FLOW_D8,    // All flow goes to the steepest of the eight neighbours
+    FLOW_DINF   // Flow is split between the two cells bounding the steepest facet
+} FlowMethod;
+
+// Auxiliary planes derived from a terrain, each width * depth cells, row-major
+// and unpadded (cell index = z * width + x)
+typedef struct {
+    int width;
+    int depth;
+    float* filled;          // Depression-filled heights, same scale as Terrain.heights
+    int* order;             // Cells in the order the flood reached them, outlets first
+    int* parent;            // Cell each cell was reached from during the flood, -1 for outlets
+    int* receiver;          // Primary downstream cell, -1 when the cell drains off the map
+    int* receiver2;         // Second D-infinity receiver, -1 if none
+    float* weight;          // Fraction of the flow sent to 'receiver' (the rest goes to receiver2)
+    float* flowAngle;       // Flow direction in radians, 0 = +x, pi/2 = +z; -1 for outlets
+    int* level;             // Longest upstream path length, used to schedule accumulation
+    float* accumulation;    // Contributing area in cells, the cell itself included
+} Hydrology;
+
+Hydrology* createHydrology(int width, int depth);
+void destroyHydrology(Hydrology* hydrology);
+
+// Priority-flood depression filling seeded from the map edge. With quantizeLevels > 0
+// heights are bucketed into that many levels and processed with an O(N) bucket
+// queue; with 0 a binary heap orders the exact float heights.
+void hydrologyFillDepressions(Hydrology* hydrology, const Terrain* terrain, int quantizeLevels);
+
+// Flow directions on the filled surface. Flat cells drain towards the cell they were
+// flooded from, so every cell has a path off the map.
+void hydrologyComputeFlow(Hydrology* hydrology, FlowMethod method);
+
+// Flow accumulation in topological order, in parallel across independent cells
+void hydrologyAccumulate(Hydrology* hydrology);
+
+#endif // HYDROLOGY_H
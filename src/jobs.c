@@ -0,0 +1,150 @@
+// jobs.c
+#include "jobs.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define JOBS_MAX_THREADS 64
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t wake;        // Signalled when a new batch is posted or on shutdown
+    pthread_cond_t done;        // Signalled when the last worker leaves a batch
+    pthread_mutex_t submit;     // Serializes concurrent jobsParallelFor callers
+    pthread_t threads[JOBS_MAX_THREADS];
+    int threadCount;            // Background threads (the caller is worker 0)
+    bool started;
+    bool quit;
+
+    // Current batch
+    JobFunction function;
+    void* context;
+    int count;
+    atomic_int next;
+    int generation;             // Bumped for every batch so sleepers notice new work
+    int busy;                   // Background threads still inside the batch
+} JobPool;
+
+static JobPool pool = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+    .submit = PTHREAD_MUTEX_INITIALIZER,
+};
+static pthread_once_t poolOnce = PTHREAD_ONCE_INIT;
+static _Thread_local bool insideJob = false;
+static _Thread_local int currentWorker = 0;
+
+// Pull indices from the shared counter until the batch is exhausted
+static void runBatch(JobFunction function, void* context, int count, int worker) {
+    insideJob = true;
+    for (;;) {
+        int index = atomic_fetch_add(&pool.next, 1);
+        if (index >= count) break;
+        function(context, index, worker);
+    }
+    insideJob = false;
+}
+
+static void* workerMain(void* argument) {
+    int worker = (int)(size_t)argument;
+    int seen = 0;
+    currentWorker = worker;
+
+    pthread_mutex_lock(&pool.lock);
+    for (;;) {
+        while (!pool.quit && pool.generation == seen) {
+            pthread_cond_wait(&pool.wake, &pool.lock);
+        }
+        if (pool.quit) break;
+        seen = pool.generation;
+
+        JobFunction function = pool.function;
+        void* context = pool.context;
+        int count = pool.count;
+        pthread_mutex_unlock(&pool.lock);
+
+        runBatch(function, context, count, worker);
+
+        pthread_mutex_lock(&pool.lock);
+        if (--pool.busy == 0) {
+            pthread_cond_signal(&pool.done);
+        }
+    }
+    pthread_mutex_unlock(&pool.lock);
+    return NULL;
+}
+
+static void startPool(void) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores < 1) cores = 1;
+    if (cores > JOBS_MAX_THREADS) cores = JOBS_MAX_THREADS;
+
+    pool.threadCount = 0;
+    for (long i = 1; i < cores; i++) {
+        if (pthread_create(&pool.threads[pool.threadCount], NULL, workerMain, (void*)(size_t)i) != 0) {
+            fprintf(stderr, "Failed to start worker thread %ld, continuing with %d\n", i, pool.threadCount);
+            break;
+        }
+        pool.threadCount++;
+    }
+    pool.started = true;
+}
+
+int jobsWorkerCount(void) {
+    pthread_once(&poolOnce, startPool);
+    return pool.threadCount + 1;
+}
+
+void jobsParallelFor(int count, JobFunction function, void* context) {
+    if (count <= 0 || !function) return;
+    pthread_once(&poolOnce, startPool);
+
+    // Nested calls, single items and a pool without threads run inline
+    if (insideJob || count == 1 || pool.threadCount == 0 || pool.quit) {
+        for (int i = 0; i < count; i++) {
+            function(context, i, currentWorker);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&pool.submit);
+
+    pthread_mutex_lock(&pool.lock);
+    pool.function = function;
+    pool.context = context;
+    pool.count = count;
+    atomic_store(&pool.next, 0);
+    pool.busy = pool.threadCount;
+    pool.generation++;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    runBatch(function, context, count, 0);
+
+    // Wait until every background thread has left the batch before it goes out of scope
+    pthread_mutex_lock(&pool.lock);
+    while (pool.busy > 0) {
+        pthread_cond_wait(&pool.done, &pool.lock);
+    }
+    pthread_mutex_unlock(&pool.lock);
+
+    pthread_mutex_unlock(&pool.submit);
+}
+
+void jobsShutdown(void) {
+    if (!pool.started) return;
+
+    pthread_mutex_lock(&pool.lock);
+    pool.quit = true;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    for (int i = 0; i < pool.threadCount; i++) {
+        pthread_join(pool.threads[i], NULL);
+    }
+    pool.threadCount = 0;
+}
@@ -0,0 +1,17 @@
+// jobs.h
+#ifndef JOBS_H
+#define JOBS_H
+
+// Shared worker pool for data-parallel passes (erosion, meshing, culling, ...).
+// The pool starts lazily with one thread per online core; the calling thread
+// also takes part, so jobsParallelFor never idles the caller.
+
+// Called once per index; 'worker' is in [0, jobsWorkerCount()) and is stable for
+// the duration of the call, so it can select per-thread scratch memory.
+typedef void (*JobFunction)(void* context, int index, int worker);
+
+int jobsWorkerCount(void);
+void jobsParallelFor(int count, JobFunction function, void* context);
+void jobsShutdown(void);
+
+#endif // JOBS_H
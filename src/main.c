@@ -1,5 +1,13 @@
 #include "terrain.h"
 #include "render.h"
+#include "erosion.h"
+#include "jobs.h"
+#include "water.h"
+#include "normals.h"
+#include "materials.h"
+#include "pyramid.h"
+#include "edit.h"
+#include "snapshot.h"
 #include <GLFW/glfw3.h>
 #include <stdio.h>
 
@@ -15,14 +23,55 @@ int main() {
     // Generate the terrain heights using Perlin noise
     generateTerrain(terrain);
 
+    // Carve the raw fBm with one droplet per cell on average
+    HydraulicErosionParams erosionParams;
+    HydraulicErosionStats erosionStats;
+    defaultHydraulicErosionParams(&erosionParams, (long)terrain->width * terrain->depth);
+    erodeTerrainHydraulic(terrain, &erosionParams, &erosionStats);
+    printf("Hydraulic erosion: %ld droplets in %.3f s (%.0f droplets/s)\n",
+           erosionStats.droplets, erosionStats.seconds, erosionStats.dropletsPerSecond);
+
+    // Relax slopes steeper than one voxel per cell
+    ThermalErosionParams thermalParams;
+    ThermalErosionStats thermalStats;
+    defaultThermalErosionParams(&thermalParams, 50);
+    erodeTerrainThermal(terrain, &thermalParams, &thermalStats);
+    printf("Thermal erosion: %d iterations in %.3f s (%.0f cells/s)\n",
+           thermalStats.iterations, thermalStats.seconds, thermalStats.cellsPerSecond);
+
+    // Shared normals and slopes for rendering, materials and queries
+    terrainComputeNormals(terrain);
+
+    // Flood everything below the old sea level and let it settle into lakes
+    WaterSim* water = createWaterSim(terrain);
+    if (water) {
+        water->wetDepth = WATER_RENDER_DEPTH;
+        waterFillToLevel(water, 0.2f * MAX_HEIGHT * VOXEL_SIZE);
+        waterSimulate(water, 200, NULL);
+    }
+    terrainComputeMaterials(terrain, water);
+
+    // Picking pyramid and editor for sculpting. Edits go through the snapshot
+    // store, which also keeps their undo history.
+    HeightPyramid* pyramid = createHeightPyramid(terrain);
+    TerrainStore* store = createTerrainStore(terrain);
+    TerrainEditor* editor = createTerrainEditor(terrain, pyramid, water, store);
+
     initializeGraphics();
+    renderSetWater(water);
+    renderSetEditor(editor);
     
     startRenderLoop(terrain);
     
     // Clean up
     cleanupGraphics();
 
+    destroyTerrainEditor(editor);
+    destroyTerrainStore(store);
+    destroyHeightPyramid(pyramid);
+    destroyWaterSim(water);
     destroyTerrain(terrain);
+    jobsShutdown();
     return 0;
 }
 
@@ -0,0 +1,93 @@
+// materials.c
+#include "materials.h"
+#include "normals.h"
+#include "jobs.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MATERIALS_BAND_ROWS 64  // Rows per parallel job
+
+typedef struct {
+    Terrain* terrain;
+    const WaterSim* water;
+    int x0, z0, x1, z1;
+    atomic_int changed;
+} MaterialPass;
+
+Material chooseMaterial(float heightValue, float waterDepth, float slope) {
+    int underwater = waterDepth < 0.0f ? heightValue < SEA_LEVEL : waterDepth > WATER_RENDER_DEPTH;
+    if (underwater) { // Water
+        return MATERIAL_WATER;
+    } else if (slope > STEEP_SLOPE && heightValue < 0.8f) { // Cliffs below the snow line
+        return MATERIAL_MOUNTAIN;
+    } else if (heightValue < 0.4f) { // Sand
+        return MATERIAL_SAND;
+    } else if (heightValue < 0.6f) { // Grassland
+        return MATERIAL_GRASS;
+    } else if (heightValue < 0.8f) { // Mountain
+        return MATERIAL_MOUNTAIN;
+    } else { // Snow/Mountain Peaks
+        return MATERIAL_SNOW;
+    }
+}
+
+static void materialBandJob(void* context, int band, int worker) {
+    (void)worker;
+    MaterialPass* pass = (MaterialPass*)context;
+    Terrain* terrain = pass->terrain;
+    const WaterSim* water = pass->water;
+    int z0 = pass->z0 + band * MATERIALS_BAND_ROWS;
+    int z1 = z0 + MATERIALS_BAND_ROWS < pass->z1 ? z0 + MATERIALS_BAND_ROWS : pass->z1;
+    int changed = 0;
+
+    for (int z = z0; z < z1; z++) {
+        for (int x = pass->x0; x < pass->x1; x++) {
+            float waterDepth = water ? WATER_DEPTH(water, x, z) : -1.0f;
+            float slope = terrain->slopes ? TERRAIN_SLOPE(terrain, x, z) : 0.0f;
+            unsigned char material = (unsigned char)chooseMaterial(TERRAIN_HEIGHT(terrain, x, z), waterDepth, slope);
+            if (TERRAIN_MATERIAL(terrain, x, z) != material) {
+                TERRAIN_MATERIAL(terrain, x, z) = material;
+                changed++;
+            }
+        }
+    }
+
+    if (changed) atomic_fetch_add(&pass->changed, changed);
+}
+
+int terrainUpdateMaterials(Terrain* terrain, const WaterSim* water, int x0, int z0, int x1, int z1) {
+    if (!terrain || !terrain->heights) return 0;
+
+    if (!terrain->materials) {
+        size_t bytes = ((size_t)terrain->depth * terrain->stride + TERRAIN_ALIGNMENT - 1) & ~(size_t)(TERRAIN_ALIGNMENT - 1);
+        terrain->materials = (unsigned char*)aligned_alloc(TERRAIN_ALIGNMENT, bytes);
+        if (!terrain->materials) {
+            fprintf(stderr, "Failed to allocate material plane.\n");
+            return 0;
+        }
+        // An out-of-range value makes every cell count as changed on the first pass
+        memset(terrain->materials, MATERIAL_COUNT, bytes);
+    }
+    if (water && (water->width != terrain->width || water->depth != terrain->depth)) water = NULL;
+
+    MaterialPass pass;
+    pass.terrain = terrain;
+    pass.water = water;
+    pass.x0 = x0 > 0 ? x0 : 0;
+    pass.z0 = z0 > 0 ? z0 : 0;
+    pass.x1 = x1 < terrain->width ? x1 : terrain->width;
+    pass.z1 = z1 < terrain->depth ? z1 : terrain->depth;
+    atomic_init(&pass.changed, 0);
+    if (pass.x0 >= pass.x1 || pass.z0 >= pass.z1) return 0;
+
+    int bands = (pass.z1 - pass.z0 + MATERIALS_BAND_ROWS - 1) / MATERIALS_BAND_ROWS;
+    jobsParallelFor(bands, materialBandJob, &pass);
+    return atomic_load(&pass.changed);
+}
+
+int terrainComputeMaterials(Terrain* terrain, const WaterSim* water) {
+    if (!terrain) return 0;
+    return terrainUpdateMaterials(terrain, water, 0, 0, terrain->width, terrain->depth);
+}
@@ -0,0 +1,35 @@
+// materials.h
+#ifndef MATERIALS_H
+#define MATERIALS_H
+
+#include "terrain.h"
+#include "water.h"
+
+// Surface materials, in the order their textures are loaded by the renderer
+typedef enum {
+    MATERIAL_WATER,
+    MATERIAL_SAND,
+    MATERIAL_GRASS,
+    MATERIAL_MOUNTAIN,
+    MATERIAL_SNOW,
+    MATERIAL_COUNT
+} Material;
+
+// Same layout as the normal and slope planes: terrain stride, no apron
+#define TERRAIN_MATERIAL(t, x, z) ((t)->materials[TERRAIN_INDEX(t, x, z)])
+
+#define WATER_RENDER_DEPTH 0.5f   // Minimum water depth (world units) shown as water
+#define SEA_LEVEL 0.2f            // Normalized height treated as water without a water simulation
+#define STEEP_SLOPE 1.5f          // Rise over run above which lowland cells show bare rock
+
+// Material for one cell. Pass a negative waterDepth when there is no water
+// simulation to fall back to the fixed sea level.
+Material chooseMaterial(float heightValue, float waterDepth, float slope);
+
+// Recompute materials in [x0, x1) x [z0, z1), allocating the plane on first use.
+// Uses the slope plane when present and 'water' when non-NULL.
+// Returns the number of cells whose material changed.
+int terrainUpdateMaterials(Terrain* terrain, const WaterSim* water, int x0, int z0, int x1, int z1);
+int terrainComputeMaterials(Terrain* terrain, const WaterSim* water);
+
+#endif // MATERIALS_H
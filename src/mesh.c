@@ -0,0 +1,734 @@
+// mesh.c
+#include "mesh.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const float faceNormals[6][3] = {
+    {  0.0f,  0.0f, -1.0f },    // FRONT
+    {  0.0f,  0.0f,  1.0f },    // BACK
+    { -1.0f,  0.0f,  0.0f },    // LEFT
+    {  1.0f,  0.0f,  0.0f },    // RIGHT
+    {  0.0f,  1.0f,  0.0f },    // TOP
+    {  0.0f, -1.0f,  0.0f }     // BOTTOM
+};
+
+// Axis-aligned rectangle of voxel faces in grid units. (x, y, z) is the first voxel
+// covered; 'width' runs along x (along z for LEFT/RIGHT) and 'height' along z for
+// TOP and along y for the sides, in columns and voxels. 'step' is the depth of the
+// cell behind a BACK or RIGHT wall: 1 except for reduced levels of detail, where
+// the last cell of a partial chunk is cut short at the chunk edge.
+typedef struct {
+    int x, y, z;
+    int width, height;
+    unsigned char face;
+    unsigned char material;
+    unsigned char step;
+} MeshQuad;
+
+// Growable list of quads for one material
+typedef struct {
+    MeshQuad* quads;
+    size_t count;
+    size_t capacity;
+} QuadList;
+
+void initTerrainMesh(TerrainMesh* mesh) {
+    memset(mesh, 0, sizeof(TerrainMesh));
+}
+
+void freeTerrainMesh(TerrainMesh* mesh) {
+    if (!mesh) return;
+    free(mesh->vertices);
+    free(mesh->indices);
+    initTerrainMesh(mesh);
+}
+
+static int reserveMesh(TerrainMesh* mesh, size_t quads) {
+    size_t vertices = quads * 4;
+    size_t indices = quads * 6;
+
+    if (vertices > mesh->vertexCapacity) {
+        MeshVertex* grown = (MeshVertex*)realloc(mesh->vertices, vertices * sizeof(MeshVertex));
+        if (!grown) return 0;
+        mesh->vertices = grown;
+        mesh->vertexCapacity = vertices;
+    }
+    if (indices > mesh->indexCapacity) {
+        unsigned int* grown = (unsigned int*)realloc(mesh->indices, indices * sizeof(unsigned int));
+        if (!grown) return 0;
+        mesh->indices = grown;
+        mesh->indexCapacity = indices;
+    }
+    return 1;
+}
+
+// Size the mesh for per-material quad counts and lay the materials out back to back.
+// 'cursor' receives the first quad slot of each material.
+static int layoutMesh(TerrainMesh* mesh, const size_t quads[MATERIAL_COUNT], size_t cursor[MATERIAL_COUNT]) {
+    size_t total = 0;
+    for (int m = 0; m < MATERIAL_COUNT; m++) {
+        cursor[m] = total;
+        mesh->ranges[m].firstIndex = total * 6;
+        mesh->ranges[m].indexCount = quads[m] * 6;
+        total += quads[m];
+    }
+
+    if (total * 4 > 0xFFFFFFFFu || !reserveMesh(mesh, total)) {
+        fprintf(stderr, "Failed to allocate terrain mesh (%zu quads).\n", total);
+        mesh->vertexCount = 0;
+        mesh->indexCount = 0;
+        memset(mesh->ranges, 0, sizeof(mesh->ranges));
+        return 0;
+    }
+    mesh->vertexCount = total * 4;
+    mesh->indexCount = total * 6;
+    return 1;
+}
+
+// Corners of a quad in grid units (columns across, voxels up), in the order the
+// 0-1-2, 0-2-3 index pattern expects: counter-clockwise seen from outside the solid
+static void quadCorners(const MeshQuad* quad, int corners[4][3]) {
+    int x = quad->x, y = quad->y, z = quad->z;
+    int w = quad->width;
+    int h = quad->height;
+
+    switch (quad->face) {
+        case FRONT: {
+            int c[4][3] = { { x, y, z }, { x, y + h, z }, { x + w, y + h, z }, { x + w, y, z } };
+            memcpy(corners, c, sizeof(c));
+            break;
+        }
+        case BACK: {
+            int zf = z + quad->step;
+            int c[4][3] = { { x, y, zf }, { x + w, y, zf }, { x + w, y + h, zf }, { x, y + h, zf } };
+            memcpy(corners, c, sizeof(c));
+            break;
+        }
+        case LEFT: {
+            int c[4][3] = { { x, y, z }, { x, y, z + w }, { x, y + h, z + w }, { x, y + h, z } };
+            memcpy(corners, c, sizeof(c));
+            break;
+        }
+        case RIGHT: {
+            int xf = x + quad->step;
+            int c[4][3] = { { xf, y, z }, { xf, y + h, z }, { xf, y + h, z + w }, { xf, y, z + w } };
+            memcpy(corners, c, sizeof(c));
+            break;
+        }
+        default: {
+            int c[4][3] = { { x, y + 1, z }, { x, y + 1, z + h }, { x + w, y + 1, z + h }, { x + w, y + 1, z } };
+            memcpy(corners, c, sizeof(c));
+            break;
+        }
+    }
+}
+
+// Write one quad into slot 'slot'. Texture coordinates repeat once per voxel.
+static void writeQuad(TerrainMesh* mesh, size_t slot, const Terrain* terrain, const MeshQuad* quad) {
+    const float s = VOXEL_SIZE;
+    int corners[4][3];
+    quadCorners(quad, corners);
+
+    MeshVertex* vertex = mesh->vertices + slot * 4;
+    for (int i = 0; i < 4; i++) {
+        const int* c = corners[i];
+        vertex[i].position[0] = TERRAIN_ORIGIN_X(terrain) + c[0] * s;
+        vertex[i].position[1] = c[1] * s;
+        vertex[i].position[2] = TERRAIN_ORIGIN_Z(terrain) + c[2] * s;
+        memcpy(vertex[i].normal, faceNormals[quad->face], sizeof(faceNormals[quad->face]));
+
+        // Along the face from its first corner: x and y on FRONT/BACK, y and z on
+        // LEFT/RIGHT, x and z on TOP
+        int u = quad->face == LEFT || quad->face == RIGHT ? c[1] - corners[0][1] : c[0] - corners[0][0];
+        int v = quad->face == FRONT || quad->face == BACK ? c[1] - corners[0][1] : c[2] - corners[0][2];
+        vertex[i].uv[0] = (float)u;
+        vertex[i].uv[1] = (float)v;
+        vertex[i].material = quad->material;
+    }
+
+    unsigned int base = (unsigned int)(slot * 4);
+    unsigned int* index = mesh->indices + slot * 6;
+    index[0] = base;
+    index[1] = base + 1;
+    index[2] = base + 2;
+    index[3] = base;
+    index[4] = base + 2;
+    index[5] = base + 3;
+}
+
+// Same quad as four packed vertices relative to the mesh origin
+static void writePackedQuad(PackedMesh* mesh, size_t slot, const MeshQuad* quad) {
+    int corners[4][3];
+    quadCorners(quad, corners);
+
+    PackedVertex* vertex = mesh->vertices + slot * 4;
+    for (int i = 0; i < 4; i++) {
+        vertex[i] = packVoxelVertex(corners[i][0] - mesh->originX, corners[i][1], corners[i][2] - mesh->originZ,
+                                    quad->face, quad->material);
+    }
+}
+
+void initPackedMesh(PackedMesh* mesh) {
+    memset(mesh, 0, sizeof(PackedMesh));
+}
+
+void freePackedMesh(PackedMesh* mesh) {
+    if (!mesh) return;
+    free(mesh->vertices);
+    initPackedMesh(mesh);
+}
+
+// Occupancy ---------------------------------------------------------------
+
+// Solid voxels of a column as bits 0..top, empty outside the map so border walls
+// are emitted
+static inline uint64_t columnMask(const Terrain* terrain, int x, int z) {
+    if (x < 0 || z < 0 || x >= terrain->width || z >= terrain->depth) return 0;
+    return occupancyMask((int)(TERRAIN_HEIGHT(terrain, x, z) * MAX_HEIGHT));
+}
+
+static inline Material columnMaterial(const Terrain* terrain, int x, int z) {
+    if (terrain->materials) return (Material)TERRAIN_MATERIAL(terrain, x, z);
+    return chooseMaterial(TERRAIN_HEIGHT(terrain, x, z), -1.0f, 0.0f);
+}
+
+// Masks for [x0, x1) x [z0, z1) plus a one-column border, row-major with
+// (x1 - x0 + 2) masks per row; the rectangle's first column is at (1, 1)
+static uint64_t* buildOccupancy(const Terrain* terrain, int x0, int z0, int x1, int z1, uint64_t* masks) {
+    int cols = x1 - x0 + 2;
+    for (int z = z0 - 1; z <= z1; z++) {
+        uint64_t* row = masks + (size_t)(z - z0 + 1) * cols;
+        for (int x = x0 - 1; x <= x1; x++) {
+            row[x - x0 + 1] = columnMask(terrain, x, z);
+        }
+    }
+    return masks;
+}
+
+// Exposed faces of a column in the six directions, indexed by FaceType: a side
+// face shows where the neighbour is empty, a top where the voxel above is empty
+static inline void exposedFaces(uint64_t own, const uint64_t* centre, int cols, uint64_t exposed[6]) {
+    exposed[FRONT] = own & ~centre[-cols];
+    exposed[BACK] = own & ~centre[cols];
+    exposed[LEFT] = own & ~centre[-1];
+    exposed[RIGHT] = own & ~centre[1];
+    exposed[TOP] = own & ~(own >> 1);
+    exposed[BOTTOM] = 0;    // Ground layer, never visible
+}
+
+// Number of runs of consecutive set bits
+static inline int runCount(uint64_t bits) {
+    return __builtin_popcountll(bits & ~(bits << 1));
+}
+
+// Pop the lowest run of set bits, returning its first bit and length
+static inline int popRun(uint64_t* bits, int* length) {
+    int start = __builtin_ctzll(*bits);
+    uint64_t shifted = ~(*bits >> start);
+    *length = shifted ? __builtin_ctzll(shifted) : 64 - start;
+    uint64_t run = *length >= 64 ? ~0ULL : (1ULL << *length) - 1;
+    *bits &= ~(run << start);
+    return start;
+}
+
+static void clampRect(const Terrain* terrain, int* x0, int* z0, int* x1, int* z1) {
+    if (*x0 < 0) *x0 = 0;
+    if (*z0 < 0) *z0 = 0;
+    if (*x1 > terrain->width) *x1 = terrain->width;
+    if (*z1 > terrain->depth) *z1 = terrain->depth;
+}
+
+static size_t countColumnQuads(const Terrain* terrain, const uint64_t* masks, int x0, int z0, int x1, int z1,
+                               size_t quads[MATERIAL_COUNT]) {
+    int cols = x1 - x0 + 2;
+    size_t total = 0;
+    for (int z = z0; z < z1; z++) {
+        const uint64_t* row = masks + (size_t)(z - z0 + 1) * cols + 1;
+        for (int x = x0; x < x1; x++) {
+            const uint64_t* centre = row + (x - x0);
+            if (!*centre) continue;
+
+            uint64_t exposed[6];
+            exposedFaces(*centre, centre, cols, exposed);
+            size_t count = 0;
+            for (int face = 0; face < 6; face++) {
+                count += (size_t)(face == TOP ? __builtin_popcountll(exposed[face]) : runCount(exposed[face]));
+            }
+            if (quads) quads[columnMaterial(terrain, x, z)] += count;
+            total += count;
+        }
+    }
+    return total;
+}
+
+int buildTerrainMesh(const Terrain* terrain, TerrainMesh* mesh) {
+    if (!terrain) return 0;
+    return buildTerrainMeshRect(terrain, 0, 0, terrain->width, terrain->depth, mesh);
+}
+
+int buildTerrainMeshRect(const Terrain* terrain, int x0, int z0, int x1, int z1, TerrainMesh* mesh) {
+    if (!terrain || !terrain->heights || !mesh) return 0;
+    clampRect(terrain, &x0, &z0, &x1, &z1);
+
+    size_t quads[MATERIAL_COUNT] = { 0 };
+    size_t cursor[MATERIAL_COUNT];
+    if (x1 <= x0 || z1 <= z0) return layoutMesh(mesh, quads, cursor);
+
+    int cols = x1 - x0 + 2;
+    uint64_t* masks = (uint64_t*)malloc((size_t)cols * (z1 - z0 + 2) * sizeof(uint64_t));
+    if (!masks) {
+        fprintf(stderr, "Failed to allocate occupancy masks.\n");
+        return 0;
+    }
+    buildOccupancy(terrain, x0, z0, x1, z1, masks);
+
+    // Count quads per material so every material's geometry is contiguous
+    countColumnQuads(terrain, masks, x0, z0, x1, z1, quads);
+    if (!layoutMesh(mesh, quads, cursor)) {
+        free(masks);
+        return 0;
+    }
+
+    for (int z = z0; z < z1; z++) {
+        const uint64_t* row = masks + (size_t)(z - z0 + 1) * cols + 1;
+        for (int x = x0; x < x1; x++) {
+            const uint64_t* centre = row + (x - x0);
+            if (!*centre) continue;
+
+            uint64_t exposed[6];
+            exposedFaces(*centre, centre, cols, exposed);
+            Material material = columnMaterial(terrain, x, z);
+
+            // One wall per run of exposed voxels on each side
+            for (int side = FRONT; side <= RIGHT; side++) {
+                while (exposed[side]) {
+                    int length;
+                    int start = popRun(&exposed[side], &length);
+                    MeshQuad wall = { x, start, z, 1, length, (unsigned char)side, (unsigned char)material, 1 };
+                    writeQuad(mesh, cursor[material]++, terrain, &wall);
+                }
+            }
+            while (exposed[TOP]) {
+                int y = __builtin_ctzll(exposed[TOP]);
+                exposed[TOP] &= exposed[TOP] - 1;
+                MeshQuad cap = { x, y, z, 1, 1, TOP, (unsigned char)material, 1 };
+                writeQuad(mesh, cursor[material]++, terrain, &cap);
+            }
+        }
+    }
+
+    free(masks);
+    return 1;
+}
+// Greedy meshing -----------------------------------------------------------
+
+static int pushQuad(QuadList* list, const MeshQuad* quad) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 256;
+        MeshQuad* grown = (MeshQuad*)realloc(list->quads, capacity * sizeof(MeshQuad));
+        if (!grown) return 0;
+        list->quads = grown;
+        list->capacity = capacity;
+    }
+    list->quads[list->count++] = *quad;
+    return 1;
+}
+
+// Scratch shared by the planes of one chunk, and kept between builds by callers
+// that mesh many chunks
+struct MeshScratch {
+    int* keys;
+    size_t keyCapacity;
+    uint64_t* masks;        // Chunk occupancy with a one-column border
+    Material* materials;
+    size_t columnQuads;     // Quads the column-span mesher would emit, for stats
+    QuadList lists[MATERIAL_COUNT];
+    int failed;
+};
+
+MeshScratch* createMeshScratch(void) {
+    MeshScratch* scratch = (MeshScratch*)calloc(1, sizeof(MeshScratch));
+    if (!scratch) return NULL;
+    scratch->masks = (uint64_t*)malloc((size_t)(MESH_CHUNK_SIZE + 2) * (MESH_CHUNK_SIZE + 2) * sizeof(uint64_t));
+    scratch->materials = (Material*)malloc((size_t)MESH_CHUNK_SIZE * MESH_CHUNK_SIZE * sizeof(Material));
+    if (!scratch->masks || !scratch->materials) {
+        destroyMeshScratch(scratch);
+        return NULL;
+    }
+    return scratch;
+}
+
+void destroyMeshScratch(MeshScratch* scratch) {
+    if (!scratch) return;
+    for (int m = 0; m < MATERIAL_COUNT; m++) free(scratch->lists[m].quads);
+    free(scratch->keys);
+    free(scratch->masks);
+    free(scratch->materials);
+    free(scratch);
+}
+
+static int reserveKeys(MeshScratch* scratch, size_t count) {
+    if (count <= scratch->keyCapacity) return 1;
+    int* grown = (int*)realloc(scratch->keys, count * sizeof(int));
+    if (!grown) return 0;
+    scratch->keys = grown;
+    scratch->keyCapacity = count;
+    return 1;
+}
+
+// Cover every non-negative key of a cols x rows grid with maximal same-key
+// rectangles: grow right first, then down while the whole row matches. Keys are
+// consumed (set to -1) as they are covered. 'quad' supplies the face; its
+// position and size are filled in by 'place' for each rectangle.
+typedef void (*PlaceQuad)(MeshQuad* quad, int col, int row, int width, int height, int key, const void* context);
+
+static void greedyMerge(MeshScratch* scratch, int cols, int rows, MeshQuad quad, PlaceQuad place, const void* context) {
+    int* keys = scratch->keys;
+
+    for (int row = 0; row < rows; row++) {
+        for (int col = 0; col < cols; col++) {
+            int key = keys[row * cols + col];
+            if (key < 0) continue;
+
+            int width = 1;
+            while (col + width < cols && keys[row * cols + col + width] == key) width++;
+
+            int height = 1;
+            for (; row + height < rows; height++) {
+                const int* next = keys + (row + height) * cols + col;
+                int matches = 1;
+                for (int i = 0; i < width && matches; i++) matches = next[i] == key;
+                if (!matches) break;
+            }
+
+            for (int r = row; r < row + height; r++) {
+                for (int i = 0; i < width; i++) keys[r * cols + col + i] = -1;
+            }
+
+            place(&quad, col, row, width, height, key, context);
+            if (!pushQuad(&scratch->lists[quad.material], &quad)) scratch->failed = 1;
+            col += width - 1;
+        }
+    }
+}
+
+typedef struct {
+    int x0, z0;     // Chunk origin
+    int x1, z1;     // Chunk far edge; the last cell of a partial chunk stops there
+    int line;       // Row (FRONT/BACK) or column (LEFT/RIGHT) of the wall plane
+    int yMin;       // Lowest voxel of the plane's grid
+    int step;       // Columns per grid cell
+} PlaneOrigin;
+
+// Far edge of 'cells' cells of 'step' columns from 'start', cut at the chunk edge
+static inline int cellEnd(int start, int cells, int step, int end) {
+    int edge = start + cells * step;
+    return edge < end ? edge : end;
+}
+
+// Top keys pack the column height with the material so only equal tops merge
+static void placeTop(MeshQuad* quad, int col, int row, int width, int height, int key, const void* context) {
+    const PlaneOrigin* origin = (const PlaneOrigin*)context;
+    quad->x = origin->x0 + col * origin->step;
+    quad->z = origin->z0 + row * origin->step;
+    quad->y = key / MATERIAL_COUNT;
+    quad->step = (unsigned char)origin->step;
+    quad->width = cellEnd(origin->x0, col + width, origin->step, origin->x1) - quad->x;
+    quad->height = cellEnd(origin->z0, row + height, origin->step, origin->z1) - quad->z;
+    quad->material = (unsigned char)(key % MATERIAL_COUNT);
+}
+
+static void placeWallZ(MeshQuad* quad, int col, int row, int width, int height, int key, const void* context) {
+    const PlaneOrigin* origin = (const PlaneOrigin*)context;
+    quad->x = origin->x0 + col * origin->step;
+    quad->y = origin->yMin + row;
+    quad->z = origin->line;
+    quad->step = (unsigned char)(cellEnd(origin->line, 1, origin->step, origin->z1) - origin->line);
+    quad->width = cellEnd(origin->x0, col + width, origin->step, origin->x1) - quad->x;
+    quad->height = height;
+    quad->material = (unsigned char)key;
+}
+
+static void placeWallX(MeshQuad* quad, int col, int row, int width, int height, int key, const void* context) {
+    const PlaneOrigin* origin = (const PlaneOrigin*)context;
+    quad->x = origin->line;
+    quad->y = origin->yMin + row;
+    quad->z = origin->z0 + col * origin->step;
+    quad->step = (unsigned char)(cellEnd(origin->line, 1, origin->step, origin->x1) - origin->line);
+    quad->width = cellEnd(origin->z0, col + width, origin->step, origin->z1) - quad->z;
+    quad->height = height;
+    quad->material = (unsigned char)key;
+}
+
+// Merge the walls of one line of columns facing one direction, given the exposed
+// voxels of each column as masks
+static void greedyWalls(MeshScratch* scratch, int count, const uint64_t* exposed, const Material* materials,
+                        FaceType face, PlaceQuad place, PlaneOrigin origin) {
+    uint64_t any = 0;
+    for (int i = 0; i < count; i++) any |= exposed[i];
+    if (!any) return;
+
+    int yMin = __builtin_ctzll(any);
+    int rows = 64 - __builtin_clzll(any) - yMin;
+    if (!reserveKeys(scratch, (size_t)rows * count)) {
+        scratch->failed = 1;
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        uint64_t bits = exposed[i] >> yMin;
+        for (int row = 0; row < rows; row++) {
+            scratch->keys[row * count + i] = ((bits >> row) & 1) ? (int)materials[i] : -1;
+        }
+    }
+
+    origin.yMin = yMin;
+    MeshQuad quad = { 0, 0, 0, 0, 0, (unsigned char)face, 0, 1 };
+    greedyMerge(scratch, count, rows, quad, place, &origin);
+}
+
+// Collect merged quads for a grid of cols x rows cells whose occupancy (with a
+// one-cell border) and materials are in the scratch. Cell (0, 0) is column
+// (x0, z0); each cell covers 'step' columns per side, clipped to [x0, x1) x [z0, z1). Rectangles never cross the
+// grid, so chunks can be rebuilt independently.
+static void greedyGrid(MeshScratch* scratch, int cols, int rows, int x0, int z0, int x1, int z1, int step) {
+    int paddedCols = cols + 2;
+    uint64_t lineExposed[MESH_CHUNK_SIZE];
+    Material lineMaterials[MESH_CHUNK_SIZE];
+    const uint64_t* masks = scratch->masks;
+    const Material* materials = scratch->materials;
+
+#define CHUNK_MASK(x, z) (masks + ((z) + 1) * paddedCols + (x) + 1)
+
+    // Tops: heightmap columns have a single top, keyed by height and material so
+    // only equal tops merge
+    if (!reserveKeys(scratch, (size_t)cols * rows)) {
+        scratch->failed = 1;
+        return;
+    }
+    for (int z = 0; z < rows; z++) {
+        for (int x = 0; x < cols; x++) {
+            uint64_t own = *CHUNK_MASK(x, z);
+            scratch->keys[z * cols + x] = own ? (63 - __builtin_clzll(own)) * MATERIAL_COUNT + (int)materials[z * cols + x] : -1;
+        }
+    }
+    PlaneOrigin origin = { x0, z0, x1, z1, 0, 0, step };
+    MeshQuad topQuad = { 0, 0, 0, 0, 0, TOP, 0, 1 };
+    greedyMerge(scratch, cols, rows, topQuad, placeTop, &origin);
+
+    // Walls facing -Z/+Z, one plane per row of columns
+    for (int side = FRONT; side <= BACK; side++) {
+        int dz = side == FRONT ? -1 : 1;
+        for (int z = 0; z < rows; z++) {
+            for (int x = 0; x < cols; x++) {
+                lineExposed[x] = *CHUNK_MASK(x, z) & ~*CHUNK_MASK(x, z + dz);
+                lineMaterials[x] = materials[z * cols + x];
+            }
+            origin.line = z0 + z * step;
+            greedyWalls(scratch, cols, lineExposed, lineMaterials, (FaceType)side, placeWallZ, origin);
+        }
+    }
+
+    // Walls facing -X/+X, one plane per column
+    for (int side = LEFT; side <= RIGHT; side++) {
+        int dx = side == LEFT ? -1 : 1;
+        for (int x = 0; x < cols; x++) {
+            for (int z = 0; z < rows; z++) {
+                lineExposed[z] = *CHUNK_MASK(x, z) & ~*CHUNK_MASK(x + dx, z);
+                lineMaterials[z] = materials[z * cols + x];
+            }
+            origin.line = x0 + x * step;
+            greedyWalls(scratch, rows, lineExposed, lineMaterials, (FaceType)side, placeWallX, origin);
+        }
+    }
+#undef CHUNK_MASK
+}
+
+// Full-resolution chunk
+static void greedyChunk(const Terrain* terrain, int x0, int z0, int x1, int z1, MeshScratch* scratch) {
+    int cols = x1 - x0;
+    int rows = z1 - z0;
+
+    buildOccupancy(terrain, x0, z0, x1, z1, scratch->masks);
+    for (int z = 0; z < rows; z++) {
+        for (int x = 0; x < cols; x++) {
+            scratch->materials[z * cols + x] = columnMaterial(terrain, x0 + x, z0 + z);
+        }
+    }
+    scratch->columnQuads += countColumnQuads(terrain, scratch->masks, x0, z0, x1, z1, NULL);
+    greedyGrid(scratch, cols, rows, x0, z0, x1, z1, 1);
+}
+
+// Chunk at a reduced level of detail: each cell of 'step' x 'step' columns becomes
+// one column as tall as the highest of them, with that column's material. Cells
+// outside the chunk count as empty, so the chunk's border walls reach the ground
+// as skirts that hide cracks against neighbours at other levels.
+static void pooledChunk(const Terrain* terrain, int x0, int z0, int x1, int z1, int step, MeshScratch* scratch) {
+    int cols = (x1 - x0 + step - 1) / step;
+    int rows = (z1 - z0 + step - 1) / step;
+    int paddedCols = cols + 2;
+
+    memset(scratch->masks, 0, (size_t)paddedCols * (rows + 2) * sizeof(uint64_t));
+    for (int z = 0; z < rows; z++) {
+        for (int x = 0; x < cols; x++) {
+            int highest = -1, bestX = x0 + x * step, bestZ = z0 + z * step;
+            for (int cz = z0 + z * step; cz < z0 + (z + 1) * step && cz < z1; cz++) {
+                for (int cx = x0 + x * step; cx < x0 + (x + 1) * step && cx < x1; cx++) {
+                    int top = (int)(TERRAIN_HEIGHT(terrain, cx, cz) * MAX_HEIGHT);
+                    if (top > highest) {
+                        highest = top;
+                        bestX = cx;
+                        bestZ = cz;
+                    }
+                }
+            }
+            scratch->masks[(size_t)(z + 1) * paddedCols + x + 1] = occupancyMask(highest);
+            scratch->materials[z * cols + x] = columnMaterial(terrain, bestX, bestZ);
+        }
+    }
+    scratch->columnQuads += countColumnQuads(terrain, scratch->masks, 0, 0, cols, rows, NULL);
+    greedyGrid(scratch, cols, rows, x0, z0, x1, z1, step);
+}
+
+int buildTerrainMeshGreedy(const Terrain* terrain, TerrainMesh* mesh, MeshStats* stats) {
+    if (!terrain) return 0;
+    return buildTerrainMeshGreedyRect(terrain, 0, 0, terrain->width, terrain->depth, mesh, stats);
+}
+
+int buildTerrainMeshGreedyRect(const Terrain* terrain, int x0, int z0, int x1, int z1, TerrainMesh* mesh, MeshStats* stats) {
+    return buildTerrainMeshLodRect(terrain, x0, z0, x1, z1, 0, mesh, stats);
+}
+
+int buildTerrainMeshLodRect(const Terrain* terrain, int x0, int z0, int x1, int z1, int lod, TerrainMesh* mesh, MeshStats* stats) {
+    MeshScratch* scratch = createMeshScratch();
+    if (!scratch) {
+        fprintf(stderr, "Failed to allocate greedy meshing scratch.\n");
+        return 0;
+    }
+    int ok = buildTerrainMeshLodRectScratch(scratch, terrain, x0, z0, x1, z1, lod, mesh, stats);
+    destroyMeshScratch(scratch);
+    return ok;
+}
+
+// Run the greedy mesher over a clamped rectangle into the scratch's quad lists
+static int collectQuads(MeshScratch* scratch, const Terrain* terrain, int x0, int z0, int x1, int z1, int lod) {
+    if (lod < 0) lod = 0;
+    if (lod > MESH_MAX_LOD) lod = MESH_MAX_LOD;
+
+    // Keep the buffers, forget the previous build
+    for (int m = 0; m < MATERIAL_COUNT; m++) scratch->lists[m].count = 0;
+    scratch->columnQuads = 0;
+    scratch->failed = 0;
+
+    for (int cz = z0; cz < z1 && !scratch->failed; cz += MESH_CHUNK_SIZE) {
+        for (int cx = x0; cx < x1 && !scratch->failed; cx += MESH_CHUNK_SIZE) {
+            int cx1 = cx + MESH_CHUNK_SIZE < x1 ? cx + MESH_CHUNK_SIZE : x1;
+            int cz1 = cz + MESH_CHUNK_SIZE < z1 ? cz + MESH_CHUNK_SIZE : z1;
+            if (lod == 0) {
+                greedyChunk(terrain, cx, cz, cx1, cz1, scratch);
+            } else {
+                pooledChunk(terrain, cx, cz, cx1, cz1, 1 << lod, scratch);
+            }
+        }
+    }
+
+    if (scratch->failed) fprintf(stderr, "Failed to allocate greedy meshing scratch.\n");
+    return !scratch->failed;
+}
+
+int buildTerrainMeshLodRectScratch(MeshScratch* scratch, const Terrain* terrain, int x0, int z0, int x1, int z1, int lod,
+                                   TerrainMesh* mesh, MeshStats* stats) {
+    if (!scratch || !terrain || !terrain->heights || !mesh) return 0;
+    clampRect(terrain, &x0, &z0, &x1, &z1);
+
+    int ok = collectQuads(scratch, terrain, x0, z0, x1, z1, lod);
+    size_t quads[MATERIAL_COUNT];
+    size_t cursor[MATERIAL_COUNT];
+    for (int m = 0; m < MATERIAL_COUNT; m++) quads[m] = scratch->lists[m].count;
+
+    if (ok) ok = layoutMesh(mesh, quads, cursor);
+    if (ok) {
+        for (int m = 0; m < MATERIAL_COUNT; m++) {
+            for (size_t i = 0; i < scratch->lists[m].count; i++) {
+                writeQuad(mesh, cursor[m]++, terrain, &scratch->lists[m].quads[i]);
+            }
+        }
+        if (stats) {
+            stats->columnQuads = scratch->columnQuads;
+            stats->greedyQuads = mesh->indexCount / 6;
+        }
+    }
+    return ok;
+}
+
+int buildPackedMeshLodRect(MeshScratch* scratch, const Terrain* terrain, int x0, int z0, int x1, int z1, int lod,
+                           PackedMesh* mesh, MeshStats* stats) {
+    if (!scratch || !terrain || !terrain->heights || !mesh) return 0;
+    clampRect(terrain, &x0, &z0, &x1, &z1);
+    if (x1 - x0 > PACKED_MAX_SPAN || z1 - z0 > PACKED_MAX_SPAN) {
+        fprintf(stderr, "Packed meshes cover at most %d columns per side.\n", PACKED_MAX_SPAN);
+        return 0;
+    }
+
+    if (!collectQuads(scratch, terrain, x0, z0, x1, z1, lod)) return 0;
+
+    size_t total = 0;
+    size_t cursor[MATERIAL_COUNT];
+    for (int m = 0; m < MATERIAL_COUNT; m++) {
+        cursor[m] = total;
+        mesh->ranges[m].firstIndex = total * 6;
+        mesh->ranges[m].indexCount = scratch->lists[m].count * 6;
+        total += scratch->lists[m].count;
+    }
+    if (total * 4 > mesh->vertexCapacity) {
+        PackedVertex* grown = (PackedVertex*)realloc(mesh->vertices, total * 4 * sizeof(PackedVertex));
+        if (!grown) {
+            fprintf(stderr, "Failed to allocate packed terrain mesh (%zu quads).\n", total);
+            mesh->vertexCount = 0;
+            memset(mesh->ranges, 0, sizeof(mesh->ranges));
+            return 0;
+        }
+        mesh->vertices = grown;
+        mesh->vertexCapacity = total * 4;
+    }
+    mesh->vertexCount = total * 4;
+    mesh->originX = x0;
+    mesh->originZ = z0;
+
+    for (int m = 0; m < MATERIAL_COUNT; m++) {
+        for (size_t i = 0; i < scratch->lists[m].count; i++) {
+            writePackedQuad(mesh, cursor[m]++, &scratch->lists[m].quads[i]);
+        }
+    }
+    if (stats) {
+        stats->columnQuads = scratch->columnQuads;
+        stats->greedyQuads = total;
+    }
+    return 1;
+}
+
+float terrainLodError(const Terrain* terrain, int x0, int z0, int x1, int z1, int lod) {
+    if (!terrain || lod <= 0) return 0.0f;
+    clampRect(terrain, &x0, &z0, &x1, &z1);
+    if (lod > MESH_MAX_LOD) lod = MESH_MAX_LOD;
+
+    // Pooled cells are as tall as their highest column; the error is how far the
+    // lowest column in a cell is raised
+    int step = 1 << lod;
+    int worst = 0;
+    for (int bz = z0; bz < z1; bz += step) {
+        for (int bx = x0; bx < x1; bx += step) {
+            int lowest = 0x7FFFFFFF, highest = -0x7FFFFFFF;
+            for (int z = bz; z < bz + step && z < z1; z++) {
+                for (int x = bx; x < bx + step && x < x1; x++) {
+                    int top = (int)(TERRAIN_HEIGHT(terrain, x, z) * MAX_HEIGHT);
+                    if (top < lowest) lowest = top;
+                    if (top > highest) highest = top;
+                }
+            }
+            if (highest - lowest > worst) worst = highest - lowest;
+        }
+    }
+    return worst * VOXEL_SIZE;
+}
@@ -0,0 +1,129 @@
+// mesh.h
+#ifndef MESH_H
+#define MESH_H
+
+#include "terrain.h"
+#include "materials.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define MESH_CHUNK_SIZE 32  // Columns per side of a greedy meshing chunk
+#define MESH_MAX_LOD 5      // Coarsest level of detail: one cell per chunk
+
+typedef struct {
+    float position[3];
+    float normal[3];
+    float uv[2];
+    unsigned int material;  // Material of the face, the texture array layer to sample
+} MeshVertex;
+
+// Voxel vertex packed into 32 bits for retained chunk meshes, decoded by the
+// terrain vertex shader against a per-chunk origin:
+//   bits  0-7   x, columns from the mesh origin
+//   bits  8-15  z, columns from the mesh origin
+//   bits 16-21  y, voxels above the ground
+//   bits 22-24  face (FaceType), which selects the normal
+//   bits 25-28  material
+// Quad corners always sit on the voxel grid and textures repeat once per voxel,
+// so texture coordinates are derived from the position rather than stored.
+typedef uint32_t PackedVertex;
+
+#define PACKED_Y_SHIFT 16
+#define PACKED_FACE_SHIFT 22
+#define PACKED_MATERIAL_SHIFT 25
+#define PACKED_MAX_SPAN 255     // Columns per side a packed mesh can cover
+
+static inline PackedVertex packVoxelVertex(int x, int y, int z, int face, int material) {
+    return (PackedVertex)(x & 0xFF) | (PackedVertex)(z & 0xFF) << 8 | (PackedVertex)(y & 0x3F) << PACKED_Y_SHIFT |
+           (PackedVertex)(face & 0x7) << PACKED_FACE_SHIFT | (PackedVertex)(material & 0xF) << PACKED_MATERIAL_SHIFT;
+}
+
+// Consecutive indices of one material's faces
+typedef struct {
+    size_t firstIndex;
+    size_t indexCount;
+} MeshRange;
+
+// CPU-side terrain geometry: quads as indexed triangles, grouped by material.
+// Independent of OpenGL.
+typedef struct {
+    MeshVertex* vertices;
+    size_t vertexCount;
+    size_t vertexCapacity;
+    unsigned int* indices;
+    size_t indexCount;
+    size_t indexCapacity;
+    MeshRange ranges[MATERIAL_COUNT];
+} TerrainMesh;
+
+// Packed voxel geometry of one rectangle: four vertices per quad and no index
+// buffer, since every quad uses the same 0-1-2, 0-2-3 pattern and all meshes can
+// share one. Ranges count indices of that pattern.
+typedef struct {
+    PackedVertex* vertices;
+    size_t vertexCount;
+    size_t vertexCapacity;
+    MeshRange ranges[MATERIAL_COUNT];
+    int originX, originZ;   // Column at local (0, 0)
+} PackedMesh;
+
+// Column occupancy as a bitmask, bit y set for each solid voxel. MAX_HEIGHT
+// keeps heightmap columns within 51 voxels; taller columns are capped at 64.
+static inline uint64_t occupancyMask(int top) {
+    if (top < 0) return 0;
+    if (top >= 63) return ~0ULL;
+    return (2ULL << top) - 1;
+}
+
+// Quad counts of the same region as plain column spans and after greedy merging
+typedef struct {
+    size_t columnQuads;
+    size_t greedyQuads;
+} MeshStats;
+
+void initTerrainMesh(TerrainMesh* mesh);
+void freeTerrainMesh(TerrainMesh* mesh);
+
+// Column-span surface: one top quad per column and, for each side, one wall quad
+// covering the voxels above the neighbouring column (or down to the ground at the
+// map border). Hidden voxel faces and the bottom are never visited, so the cost is
+// O(columns) regardless of height. Buffers in 'mesh' are reused across rebuilds.
+// Returns 0 on allocation failure.
+int buildTerrainMesh(const Terrain* terrain, TerrainMesh* mesh);
+
+// Same for the columns in [x0, x1) x [z0, z1); walls facing columns outside the
+// rectangle still follow the real neighbours, so rectangles tile without seams
+int buildTerrainMeshRect(const Terrain* terrain, int x0, int z0, int x1, int z1, TerrainMesh* mesh);
+
+// Greedy meshing: the same surface, with coplanar faces of equal material merged
+// into maximal rectangles per MESH_CHUNK_SIZE chunk and face direction. Flat
+// plateaus and walls of equal material collapse into a few quads. 'stats' is optional.
+int buildTerrainMeshGreedy(const Terrain* terrain, TerrainMesh* mesh, MeshStats* stats);
+int buildTerrainMeshGreedyRect(const Terrain* terrain, int x0, int z0, int x1, int z1, TerrainMesh* mesh, MeshStats* stats);
+
+// Greedy mesh at a reduced level of detail: every 2^lod x 2^lod columns of a chunk
+// become one column as tall as their highest, and chunk borders get skirts down to
+// the ground so chunks at different levels never show cracks. Level 0 is the
+// full-resolution greedy mesh, without skirts.
+int buildTerrainMeshLodRect(const Terrain* terrain, int x0, int z0, int x1, int z1, int lod, TerrainMesh* mesh, MeshStats* stats);
+
+// Working memory of the greedy mesher, reused across builds. Builds may run on
+// several threads at once as long as each uses its own scratch and mesh.
+typedef struct MeshScratch MeshScratch;
+MeshScratch* createMeshScratch(void);
+void destroyMeshScratch(MeshScratch* scratch);
+int buildTerrainMeshLodRectScratch(MeshScratch* scratch, const Terrain* terrain, int x0, int z0, int x1, int z1, int lod,
+                                   TerrainMesh* mesh, MeshStats* stats);
+
+// Same greedy surface as packed vertices relative to (x0, z0). The rectangle may
+// span at most PACKED_MAX_SPAN columns; MAX_HEIGHT keeps y within its 6 bits.
+void initPackedMesh(PackedMesh* mesh);
+void freePackedMesh(PackedMesh* mesh);
+int buildPackedMeshLodRect(MeshScratch* scratch, const Terrain* terrain, int x0, int z0, int x1, int z1, int lod,
+                           PackedMesh* mesh, MeshStats* stats);
+
+// Largest height error (world units) of a level of detail over a rectangle, for
+// screen-space error selection
+float terrainLodError(const Terrain* terrain, int x0, int z0, int x1, int z1, int lod);
+
+#endif // MESH_H
@@ -0,0 +1,191 @@
+// normals.c
+#include "normals.h"
+#include "jobs.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NORMALS_BAND_ROWS 32  // Rows per parallel job
+
+typedef struct {
+    Terrain* terrain;
+    int x0, z0, x1, z1;
+} NormalPass;
+
+typedef struct {
+    Terrain* terrain;
+    const TiledHeightmap* map;
+} TiledNormalPass;
+
+static inline float signNotZero(float v) {
+    return v >= 0.0f ? 1.0f : -1.0f;
+}
+
+static inline unsigned short packOctahedral(float nx, float ny, float nz) {
+    // Project onto the octahedron, using y as the folding axis since terrain
+    // normals point up and then never need the fold
+    float invL1 = 1.0f / (fabsf(nx) + fabsf(ny) + fabsf(nz));
+    float u = nx * invL1;
+    float v = nz * invL1;
+    if (ny < 0.0f) {
+        float foldedU = (1.0f - fabsf(v)) * signNotZero(u);
+        float foldedV = (1.0f - fabsf(u)) * signNotZero(v);
+        u = foldedU;
+        v = foldedV;
+    }
+    unsigned int qu = (unsigned int)(u * 127.5f + 127.5f + 0.5f);
+    unsigned int qv = (unsigned int)(v * 127.5f + 127.5f + 0.5f);
+    if (qu > 255) qu = 255;
+    if (qv > 255) qv = 255;
+    return (unsigned short)((qu << 8) | qv);
+}
+
+unsigned short packNormal(float nx, float ny, float nz) {
+    return packOctahedral(nx, ny, nz);
+}
+
+void unpackNormal(unsigned short packed, float normal[3]) {
+    float u = (float)(packed >> 8) / 127.5f - 1.0f;
+    float v = (float)(packed & 0xff) / 127.5f - 1.0f;
+    float y = 1.0f - fabsf(u) - fabsf(v);
+    if (y < 0.0f) {
+        float unfoldedU = (1.0f - fabsf(v)) * signNotZero(u);
+        float unfoldedV = (1.0f - fabsf(u)) * signNotZero(v);
+        u = unfoldedU;
+        v = unfoldedV;
+    }
+    float invLength = 1.0f / sqrtf(u * u + y * y + v * v);
+    normal[0] = u * invLength;
+    normal[1] = y * invLength;
+    normal[2] = v * invLength;
+}
+
+// Central differences over a run of cells. The apron supplies the neighbours of
+// edge cells, so the loop has no bounds checks and vectorizes.
+static void normalRow(const Terrain* terrain, int z, int x0, int x1) {
+    const float* row = TERRAIN_ROW(terrain, z);
+    const float* up = row - terrain->stride;
+    const float* down = row + terrain->stride;
+    unsigned short* normals = terrain->normals + (size_t)z * terrain->stride;
+    float* slopes = terrain->slopes + (size_t)z * terrain->stride;
+    float scale = MAX_HEIGHT * VOXEL_SIZE / (2.0f * VOXEL_SIZE);
+
+    for (int x = x0; x < x1; x++) {
+        float dx = (row[x + 1] - row[x - 1]) * scale;
+        float dz = (down[x] - up[x]) * scale;
+        slopes[x] = sqrtf(dx * dx + dz * dz);
+
+        // Normal of the surface y = h(x, z) is (-dh/dx, 1, -dh/dz) normalized; the
+        // octahedral projection only needs it up to scale
+        normals[x] = packOctahedral(-dx, 1.0f, -dz);
+    }
+}
+
+static void normalBandJob(void* context, int band, int worker) {
+    (void)worker;
+    NormalPass* pass = (NormalPass*)context;
+    int z0 = pass->z0 + band * NORMALS_BAND_ROWS;
+    int z1 = z0 + NORMALS_BAND_ROWS < pass->z1 ? z0 + NORMALS_BAND_ROWS : pass->z1;
+    for (int z = z0; z < z1; z++) {
+        normalRow(pass->terrain, z, pass->x0, pass->x1);
+    }
+}
+
+static int allocateNormalPlanes(Terrain* terrain) {
+    if (terrain->normals && terrain->slopes) return 1;
+
+    // aligned_alloc wants a multiple of the alignment
+    size_t cells = (size_t)terrain->depth * terrain->stride;
+    size_t normalBytes = (cells * sizeof(unsigned short) + TERRAIN_ALIGNMENT - 1) & ~(size_t)(TERRAIN_ALIGNMENT - 1);
+    size_t slopeBytes = cells * sizeof(float);
+    if (!terrain->normals) terrain->normals = (unsigned short*)aligned_alloc(TERRAIN_ALIGNMENT, normalBytes);
+    if (!terrain->slopes) terrain->slopes = (float*)aligned_alloc(TERRAIN_ALIGNMENT, slopeBytes);
+    if (!terrain->normals || !terrain->slopes) {
+        fprintf(stderr, "Failed to allocate normal and slope planes.\n");
+        return 0;
+    }
+    return 1;
+}
+
+void terrainUpdateNormals(Terrain* terrain, int x0, int z0, int x1, int z1) {
+    if (!terrain || !terrain->heights) return;
+    if (terrain->apron < 1) {
+        fprintf(stderr, "Normal computation needs a terrain apron of at least one cell.\n");
+        return;
+    }
+    if (!allocateNormalPlanes(terrain)) return;
+
+    NormalPass pass;
+    pass.terrain = terrain;
+    pass.x0 = x0 - 1 > 0 ? x0 - 1 : 0;
+    pass.z0 = z0 - 1 > 0 ? z0 - 1 : 0;
+    pass.x1 = x1 + 1 < terrain->width ? x1 + 1 : terrain->width;
+    pass.z1 = z1 + 1 < terrain->depth ? z1 + 1 : terrain->depth;
+    if (pass.x0 >= pass.x1 || pass.z0 >= pass.z1) return;
+
+    int bands = (pass.z1 - pass.z0 + NORMALS_BAND_ROWS - 1) / NORMALS_BAND_ROWS;
+    jobsParallelFor(bands, normalBandJob, &pass);
+}
+
+void terrainComputeNormals(Terrain* terrain) {
+    if (!terrain) return;
+    terrainUpdateNormals(terrain, 0, 0, terrain->width, terrain->depth);
+}
+
+// One tile per job, visiting its cells in row order. The neighbours come from the
+// tiled copy, where the z - 1 / z + 1 cells sit in the same tile most of the time.
+static void tiledNormalJob(void* context, int tile, int worker) {
+    (void)worker;
+    const TiledNormalPass* pass = (const TiledNormalPass*)context;
+    Terrain* terrain = pass->terrain;
+    const TiledHeightmap* map = pass->map;
+    int x0 = (tile % map->tilesX) << map->tileShift;
+    int z0 = (tile / map->tilesX) << map->tileShift;
+    int x1 = x0 + map->tileEdge < map->width ? x0 + map->tileEdge : map->width;
+    int z1 = z0 + map->tileEdge < map->depth ? z0 + map->tileEdge : map->depth;
+    float scale = MAX_HEIGHT * VOXEL_SIZE / (2.0f * VOXEL_SIZE);
+
+    const float* data = map->data + (size_t)tile * map->tileArea;
+    const unsigned int* spreadX = map->spreadX;
+    for (int z = z0; z < z1; z++) {
+        unsigned short* normals = terrain->normals + (size_t)z * terrain->stride;
+        float* slopes = terrain->slopes + (size_t)z * terrain->stride;
+        int lz = z - z0;
+        int interiorZ = lz > 0 && z + 1 < z1 && lz < map->tileEdge - 1;
+        const float* row = data + map->spreadZ[lz];
+        const float* up = interiorZ ? data + map->spreadZ[lz - 1] : NULL;
+        const float* down = interiorZ ? data + map->spreadZ[lz + 1] : NULL;
+
+        for (int x = x0; x < x1; x++) {
+            float neighbors[4];
+            int lx = x - x0;
+            if (interiorZ && lx > 0 && x + 1 < x1) {
+                // Inside the tile every neighbour is one table lookup away
+                neighbors[0] = row[spreadX[lx - 1]];
+                neighbors[1] = row[spreadX[lx + 1]];
+                neighbors[2] = up[spreadX[lx]];
+                neighbors[3] = down[spreadX[lx]];
+            } else {
+                tiledNeighbors4(map, x, z, neighbors);
+            }
+            float dx = (neighbors[1] - neighbors[0]) * scale;
+            float dz = (neighbors[3] - neighbors[2]) * scale;
+            slopes[x] = sqrtf(dx * dx + dz * dz);
+            normals[x] = packOctahedral(-dx, 1.0f, -dz);
+        }
+    }
+}
+
+void terrainComputeNormalsTiled(Terrain* terrain, const TiledHeightmap* map) {
+    if (!terrain || !terrain->heights || !map) return;
+    if (map->width != terrain->width || map->depth != terrain->depth) {
+        fprintf(stderr, "Tiled heightmap does not match the terrain size.\n");
+        return;
+    }
+    if (!allocateNormalPlanes(terrain)) return;
+
+    TiledNormalPass pass;
+    pass.terrain = terrain;
+    pass.map = map;
+    jobsParallelFor(map->tilesX * map->tilesZ, tiledNormalJob, &pass);
+}
@@ -0,0 +1,32 @@
+// normals.h
+#ifndef NORMALS_H
+#define NORMALS_H
+
+#include "terrain.h"
+#include "tiles.h"
+
+// Per-cell normals and slopes derived from Terrain.heights. Both planes use the
+// terrain's row stride without an apron: cell (x, z) lives at TERRAIN_INDEX(t, x, z)
+// for 0 <= x < width, 0 <= z < depth.
+#define TERRAIN_NORMAL(t, x, z) ((t)->normals[TERRAIN_INDEX(t, x, z)])
+#define TERRAIN_SLOPE(t, x, z)  ((t)->slopes[TERRAIN_INDEX(t, x, z)])
+
+// Compute normals and slopes for the whole terrain, allocating the planes on first use.
+// Requires an apron of at least one cell.
+void terrainComputeNormals(Terrain* terrain);
+
+// Recompute only [x0, x1) x [z0, z1), widened by one cell since the normals of the
+// cells around an edit depend on it
+void terrainUpdateNormals(Terrain* terrain, int x0, int z0, int x1, int z1);
+
+// Same result as terrainComputeNormals, reading the heights from a tiled copy of the
+// terrain (see tiledImportTerrain) one tile at a time
+void terrainComputeNormalsTiled(Terrain* terrain, const TiledHeightmap* map);
+
+// Octahedral encoding: the unit vector is projected onto the octahedron
+// |x| + |y| + |z| = 1, folded into the plane and stored as two 8-bit coordinates
+// (u in the high byte, v in the low byte)
+unsigned short packNormal(float nx, float ny, float nz);
+void unpackNormal(unsigned short packed, float normal[3]);
+
+#endif // NORMALS_H
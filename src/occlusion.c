@@ -0,0 +1,283 @@
+// occlusion.c
+#include "occlusion.h"
+#include "jobs.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define OCCLUSION_MIN_W 1e-3f   // Clip w below which a vertex counts as behind the camera
+
+// Corners of a box as bit patterns (x, y, z) and the 12 triangles of its faces,
+// counter-clockwise seen from outside
+static const int boxTriangles[12][3] = {
+    { 0, 1, 3 }, { 0, 3, 2 },   // -X
+    { 4, 6, 7 }, { 4, 7, 5 },   // +X
+    { 0, 4, 5 }, { 0, 5, 1 },   // -Y
+    { 2, 3, 7 }, { 2, 7, 6 },   // +Y
+    { 0, 2, 6 }, { 0, 6, 4 },   // -Z
+    { 1, 5, 7 }, { 1, 7, 3 }    // +Z
+};
+
+OcclusionBuffer* createOcclusionBuffer(int width, int height) {
+    if (width <= 0 || height <= 0) return NULL;
+
+    OcclusionBuffer* buffer = (OcclusionBuffer*)calloc(1, sizeof(OcclusionBuffer));
+    if (!buffer) return NULL;
+    buffer->width = width;
+    buffer->height = height;
+
+    int w = width, h = height;
+    while (buffer->levels < OCCLUSION_MAX_LEVELS) {
+        buffer->levelWidth[buffer->levels] = w;
+        buffer->levelHeight[buffer->levels] = h;
+        buffer->depth[buffer->levels] = (float*)malloc((size_t)w * h * sizeof(float));
+        if (!buffer->depth[buffer->levels]) {
+            fprintf(stderr, "Failed to allocate occlusion buffer.\n");
+            destroyOcclusionBuffer(buffer);
+            return NULL;
+        }
+        buffer->levels++;
+        if (w == 1 && h == 1) break;
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+    }
+
+    buffer->triangleCapacity = OCCLUSION_MAX_OCCLUDERS * 12;
+    buffer->triangles = (float*)malloc((size_t)buffer->triangleCapacity * 9 * sizeof(float));
+    if (!buffer->triangles) {
+        fprintf(stderr, "Failed to allocate occlusion buffer.\n");
+        destroyOcclusionBuffer(buffer);
+        return NULL;
+    }
+    return buffer;
+}
+
+void destroyOcclusionBuffer(OcclusionBuffer* buffer) {
+    if (!buffer) return;
+    for (int i = 0; i < buffer->levels; i++) {
+        free(buffer->depth[i]);
+    }
+    free(buffer->triangles);
+    free(buffer);
+}
+
+// Project the corners of a box. Returns 0 if any corner is behind the near plane.
+static int projectBox(const OcclusionBuffer* buffer, const float m[16], const float min[3], const float max[3],
+                      float screen[8][3]) {
+    for (int corner = 0; corner < 8; corner++) {
+        float x = (corner & 4) ? max[0] : min[0];
+        float y = (corner & 2) ? max[1] : min[1];
+        float z = (corner & 1) ? max[2] : min[2];
+
+        float cw = m[3] * x + m[7] * y + m[11] * z + m[15];
+        float cz = m[2] * x + m[6] * y + m[10] * z + m[14];
+        if (cw < OCCLUSION_MIN_W || cz < -cw) return 0;
+
+        float invW = 1.0f / cw;
+        float cx = m[0] * x + m[4] * y + m[8] * z + m[12];
+        float cy = m[1] * x + m[5] * y + m[9] * z + m[13];
+        screen[corner][0] = (cx * invW * 0.5f + 0.5f) * buffer->width;
+        screen[corner][1] = (cy * invW * 0.5f + 0.5f) * buffer->height;
+        screen[corner][2] = cz * invW * 0.5f + 0.5f;
+    }
+    return 1;
+}
+
+static void chunkBox(const ChunkGrid* grid, int chunk, float min[3], float max[3]) {
+    min[0] = grid->centerX[chunk] - grid->extentX[chunk];
+    min[1] = grid->centerY[chunk] - grid->extentY[chunk];
+    min[2] = grid->centerZ[chunk] - grid->extentZ[chunk];
+    max[0] = grid->centerX[chunk] + grid->extentX[chunk];
+    max[1] = grid->centerY[chunk] + grid->extentY[chunk];
+    max[2] = grid->centerZ[chunk] + grid->extentZ[chunk];
+}
+
+// Rasterize every occluder triangle into rows [y0, y1) of level 0, keeping the
+// nearest depth at each pixel centre. Triangles are front-facing (counter-clockwise).
+static void rasterizeBand(OcclusionBuffer* buffer, int y0, int y1) {
+    const int width = buffer->width;
+    float* depth = buffer->depth[0];
+
+    for (int y = y0; y < y1; y++) {
+        float* row = depth + (size_t)y * width;
+        for (int x = 0; x < width; x++) row[x] = 1.0f;
+    }
+
+    for (int t = 0; t < buffer->triangleCount; t++) {
+        const float* v = buffer->triangles + t * 9;
+        float ax = v[0], ay = v[1], az = v[2];
+        float bx = v[3], by = v[4], bz = v[5];
+        float cx = v[6], cy = v[7], cz = v[8];
+
+        float minY = ay < by ? (ay < cy ? ay : cy) : (by < cy ? by : cy);
+        float maxY = ay > by ? (ay > cy ? ay : cy) : (by > cy ? by : cy);
+        int py0 = (int)minY, py1 = (int)maxY + 1;
+        if (py0 < y0) py0 = y0;
+        if (py1 > y1) py1 = y1;
+        if (py0 >= py1) continue;
+
+        float minX = ax < bx ? (ax < cx ? ax : cx) : (bx < cx ? bx : cx);
+        float maxX = ax > bx ? (ax > cx ? ax : cx) : (bx > cx ? bx : cx);
+        int px0 = (int)minX, px1 = (int)maxX + 1;
+        if (px0 < 0) px0 = 0;
+        if (px1 > width) px1 = width;
+        if (px0 >= px1) continue;
+
+        // Edge functions w = A * x + B * y + C, stepped along each row; depth is
+        // interpolated the same way from the normalized barycentrics
+        float invArea = 1.0f / ((bx - ax) * (cy - ay) - (by - ay) * (cx - ax));
+        float a0 = by - cy, b0 = cx - bx, c0 = bx * cy - by * cx;
+        float a1 = cy - ay, b1 = ax - cx, c1 = cx * ay - cy * ax;
+        float a2 = ay - by, b2 = bx - ax, c2 = ax * by - ay * bx;
+        float dz = (a0 * az + a1 * bz + a2 * cz) * invArea;
+
+        for (int py = py0; py < py1; py++) {
+            float sy = py + 0.5f;
+            float sx = px0 + 0.5f;
+            float w0 = a0 * sx + b0 * sy + c0;
+            float w1 = a1 * sx + b1 * sy + c1;
+            float w2 = a2 * sx + b2 * sy + c2;
+            float z = (w0 * az + w1 * bz + w2 * cz) * invArea;
+            float* row = depth + (size_t)py * width;
+
+            for (int px = px0; px < px1; px++) {
+                int inside = (w0 >= 0.0f) & (w1 >= 0.0f) & (w2 >= 0.0f);
+                row[px] = inside && z < row[px] ? z : row[px];
+                w0 += a0;
+                w1 += a1;
+                w2 += a2;
+                z += dz;
+            }
+        }
+    }
+}
+
+static void rasterizeBandJob(void* context, int index, int worker) {
+    (void)worker;
+    OcclusionBuffer* buffer = (OcclusionBuffer*)context;
+    int y0 = index * OCCLUSION_BAND_ROWS;
+    int y1 = y0 + OCCLUSION_BAND_ROWS < buffer->height ? y0 + OCCLUSION_BAND_ROWS : buffer->height;
+    rasterizeBand(buffer, y0, y1);
+}
+
+// Each level keeps the farthest depth of the 2x2 texels below it
+static void buildDepthPyramid(OcclusionBuffer* buffer) {
+    for (int level = 1; level < buffer->levels; level++) {
+        const float* source = buffer->depth[level - 1];
+        float* target = buffer->depth[level];
+        int sw = buffer->levelWidth[level - 1], sh = buffer->levelHeight[level - 1];
+        int w = buffer->levelWidth[level], h = buffer->levelHeight[level];
+
+        for (int y = 0; y < h; y++) {
+            int sy0 = y * 2, sy1 = y * 2 + 1 < sh ? y * 2 + 1 : sh - 1;
+            for (int x = 0; x < w; x++) {
+                int sx0 = x * 2, sx1 = x * 2 + 1 < sw ? x * 2 + 1 : sw - 1;
+                float a = source[sy0 * sw + sx0], b = source[sy0 * sw + sx1];
+                float c = source[sy1 * sw + sx0], d = source[sy1 * sw + sx1];
+                float ab = a > b ? a : b;
+                float cd = c > d ? c : d;
+                target[y * w + x] = ab > cd ? ab : cd;
+            }
+        }
+    }
+}
+
+// True if the box is certainly behind the rasterized occluders
+static int boxOccluded(const OcclusionBuffer* buffer, const float m[16], const float min[3], const float max[3]) {
+    float screen[8][3];
+    if (!projectBox(buffer, m, min, max, screen)) return 0;
+
+    float minX = screen[0][0], maxX = minX, minY = screen[0][1], maxY = minY, nearest = screen[0][2];
+    for (int i = 1; i < 8; i++) {
+        if (screen[i][0] < minX) minX = screen[i][0];
+        if (screen[i][0] > maxX) maxX = screen[i][0];
+        if (screen[i][1] < minY) minY = screen[i][1];
+        if (screen[i][1] > maxY) maxY = screen[i][1];
+        if (screen[i][2] < nearest) nearest = screen[i][2];
+    }
+
+    int x0 = (int)minX, x1 = (int)maxX, y0 = (int)minY, y1 = (int)maxY;
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 >= buffer->width) x1 = buffer->width - 1;
+    if (y1 >= buffer->height) y1 = buffer->height - 1;
+    if (x0 > x1 || y0 > y1) return 0;
+
+    // Coarsest level at which the rectangle spans at most 2x2 texels
+    int level = 0;
+    while (level + 1 < buffer->levels && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)) {
+        level++;
+    }
+
+    const float* depth = buffer->depth[level];
+    int w = buffer->levelWidth[level];
+    for (int y = y0 >> level; y <= y1 >> level; y++) {
+        for (int x = x0 >> level; x <= x1 >> level; x++) {
+            if (nearest <= depth[y * w + x]) return 0;
+        }
+    }
+    return 1;
+}
+
+int occlusionCullChunks(OcclusionBuffer* buffer, ChunkGrid* grid, const float viewProjection[16], CullStats* stats) {
+    if (!buffer || !grid) return grid ? grid->visibleCount : 0;
+
+    // Occluders: solid boxes under the nearest visible chunks
+    buffer->triangleCount = 0;
+    int occluders = 0;
+    for (int i = 0; i < grid->visibleCount && occluders < OCCLUSION_MAX_OCCLUDERS; i++) {
+        int chunk = grid->order[i];
+        if (grid->occluderTop[chunk] <= 0.0f) continue;
+
+        float min[3], max[3], screen[8][3];
+        chunkBox(grid, chunk, min, max);
+        min[1] = 0.0f;
+        max[1] = grid->occluderTop[chunk];
+        if (!projectBox(buffer, viewProjection, min, max, screen)) continue;  // Straddles the near plane
+
+        for (int t = 0; t < 12; t++) {
+            // Box faces wind counter-clockwise seen from outside; keep the front faces
+            const float* a = screen[boxTriangles[t][0]];
+            const float* b = screen[boxTriangles[t][1]];
+            const float* c = screen[boxTriangles[t][2]];
+            if ((b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]) <= 0.0f) continue;
+
+            float* v = buffer->triangles + (size_t)buffer->triangleCount * 9;
+            for (int k = 0; k < 3; k++) {
+                const float* corner = screen[boxTriangles[t][k]];
+                v[k * 3] = corner[0];
+                v[k * 3 + 1] = corner[1];
+                v[k * 3 + 2] = corner[2];
+            }
+            buffer->triangleCount++;
+        }
+        occluders++;
+    }
+
+    // Too few occluders to hide anything: keep the frustum result as it is
+    if (occluders == 0) return grid->visibleCount;
+
+    int bands = (buffer->height + OCCLUSION_BAND_ROWS - 1) / OCCLUSION_BAND_ROWS;
+    jobsParallelFor(bands, rasterizeBandJob, buffer);
+    buildDepthPyramid(buffer);
+
+    // Drop hidden chunks from the draw order, preserving front-to-back order
+    int kept = 0;
+    for (int i = 0; i < grid->visibleCount; i++) {
+        int chunk = grid->order[i];
+        float min[3], max[3];
+        chunkBox(grid, chunk, min, max);
+        if (boxOccluded(buffer, viewProjection, min, max)) {
+            grid->visible[chunk] = 0;
+        } else {
+            grid->order[kept++] = chunk;
+        }
+    }
+
+    int occluded = grid->visibleCount - kept;
+    grid->visibleCount = kept;
+    if (stats) {
+        stats->visible = kept;
+        stats->occluded = occluded;
+    }
+    return kept;
+}
@@ -0,0 +1,38 @@
+// occlusion.h
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include "chunks.h"
+
+#define OCCLUSION_MAX_LEVELS 12
+#define OCCLUSION_MAX_OCCLUDERS 32      // Nearest chunks rasterized as occluders each frame
+#define OCCLUSION_BAND_ROWS 32          // Depth buffer rows per rasterization job
+
+// Low-resolution software depth buffer with a max-depth pyramid. Occluders are
+// the solid boxes under each chunk (from the ground up to its lowest column top),
+// which never cover anything the real surface does not. Depth is NDC z mapped to
+// [0, 1], larger is farther.
+typedef struct {
+    int width;
+    int height;
+    int levels;
+    int levelWidth[OCCLUSION_MAX_LEVELS];
+    int levelHeight[OCCLUSION_MAX_LEVELS];
+    float* depth[OCCLUSION_MAX_LEVELS];     // Level 0 is the depth buffer; level k holds the max of 2x2 texels of k-1
+
+    float* triangles;       // Screen-space occluder triangles, 3 vertices of (x, y, depth) each
+    int triangleCount;
+    int triangleCapacity;
+} OcclusionBuffer;
+
+OcclusionBuffer* createOcclusionBuffer(int width, int height);
+void destroyOcclusionBuffer(OcclusionBuffer* buffer);
+
+// Rasterize occluder boxes of the nearest visible chunks in grid->order, then
+// drop chunks hidden behind them from grid->order (keeping its front-to-back
+// order) and count them in stats->occluded. Rasterization runs on the shared
+// worker pool. With no usable occluders nothing is culled.
+// Returns the number of chunks left visible.
+int occlusionCullChunks(OcclusionBuffer* buffer, ChunkGrid* grid, const float viewProjection[16], CullStats* stats);
+
+#endif // OCCLUSION_H
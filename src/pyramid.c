@@ -0,0 +1,242 @@
+// pyramid.c
+#include "pyramid.h"
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+
+// Column top in voxel units for a normalized height
+static float columnTop(float heightValue) {
+    return (float)((int)(heightValue * MAX_HEIGHT) + 1);
+}
+
+HeightPyramid* createHeightPyramid(const Terrain* terrain) {
+    if (!terrain || !terrain->heights) return NULL;
+
+    HeightPyramid* pyramid = (HeightPyramid*)calloc(1, sizeof(HeightPyramid));
+    if (!pyramid) return NULL;
+
+    // Halve the grid until a single cell covers the whole map
+    int width = terrain->width;
+    int depth = terrain->depth;
+    for (int level = 0; level < PYRAMID_MAX_LEVELS; level++) {
+        pyramid->width[level] = width;
+        pyramid->depth[level] = depth;
+        pyramid->minHeights[level] = (float*)malloc((size_t)width * depth * sizeof(float));
+        pyramid->maxHeights[level] = (float*)malloc((size_t)width * depth * sizeof(float));
+        pyramid->levels = level + 1;
+        if (!pyramid->minHeights[level] || !pyramid->maxHeights[level]) {
+            destroyHeightPyramid(pyramid);
+            return NULL;
+        }
+        if (width == 1 && depth == 1) break;
+        width = (width + 1) / 2;
+        depth = (depth + 1) / 2;
+    }
+
+    pyramidUpdateRect(pyramid, terrain, 0, 0, terrain->width, terrain->depth);
+    return pyramid;
+}
+
+void destroyHeightPyramid(HeightPyramid* pyramid) {
+    if (!pyramid) return;
+    for (int level = 0; level < pyramid->levels; level++) {
+        free(pyramid->minHeights[level]);
+        free(pyramid->maxHeights[level]);
+    }
+    free(pyramid);
+}
+
+void pyramidUpdateRect(HeightPyramid* pyramid, const Terrain* terrain, int x0, int z0, int x1, int z1) {
+    if (!pyramid || !terrain || !terrain->heights) return;
+
+    if (x0 < 0) x0 = 0;
+    if (z0 < 0) z0 = 0;
+    if (x1 > terrain->width) x1 = terrain->width;
+    if (z1 > terrain->depth) z1 = terrain->depth;
+    if (x0 >= x1 || z0 >= z1) return;
+
+    // Level 0 comes straight from the heightmap
+    int width = pyramid->width[0];
+    for (int z = z0; z < z1; z++) {
+        const float* row = TERRAIN_ROW(terrain, z);
+        for (int x = x0; x < x1; x++) {
+            float top = columnTop(row[x]);
+            pyramid->minHeights[0][z * width + x] = top;
+            pyramid->maxHeights[0][z * width + x] = top;
+        }
+    }
+
+    // Propagate the touched rectangle upwards, shrinking it with each level
+    for (int level = 1; level < pyramid->levels; level++) {
+        x0 >>= 1;
+        z0 >>= 1;
+        x1 = (x1 + 1) >> 1;
+        z1 = (z1 + 1) >> 1;
+
+        int childWidth = pyramid->width[level - 1];
+        int childDepth = pyramid->depth[level - 1];
+        const float* childMin = pyramid->minHeights[level - 1];
+        const float* childMax = pyramid->maxHeights[level - 1];
+        float* levelMin = pyramid->minHeights[level];
+        float* levelMax = pyramid->maxHeights[level];
+        width = pyramid->width[level];
+
+        for (int z = z0; z < z1; z++) {
+            for (int x = x0; x < x1; x++) {
+                float lo = FLT_MAX;
+                float hi = -FLT_MAX;
+                for (int dz = 0; dz < 2; dz++) {
+                    int cz = 2 * z + dz;
+                    if (cz >= childDepth) break;
+                    for (int dx = 0; dx < 2; dx++) {
+                        int cx = 2 * x + dx;
+                        if (cx >= childWidth) break;
+                        lo = fminf(lo, childMin[cz * childWidth + cx]);
+                        hi = fmaxf(hi, childMax[cz * childWidth + cx]);
+                    }
+                }
+                levelMin[z * width + x] = lo;
+                levelMax[z * width + x] = hi;
+            }
+        }
+    }
+}
+
+// Parametric distance to the far side of the block [start, start + size) along one axis
+static float blockExit(float origin, float direction, int start, int size) {
+    if (direction > 0.0f) return ((float)(start + size) - origin) / direction;
+    if (direction < 0.0f) return ((float)start - origin) / direction;
+    return FLT_MAX;
+}
+
+// Clamp the cell the ray occupies along one axis into [lo, hi]
+static int clampCell(float position, int lo, int hi) {
+    int cell = (int)floorf(position);
+    if (cell < lo) return lo;
+    if (cell > hi) return hi;
+    return cell;
+}
+
+int pyramidRaycast(const HeightPyramid* pyramid, const Terrain* terrain,
+                   const float origin[3], const float direction[3], float maxDistance, TerrainHit* hit) {
+    if (!hit) return 0;
+    hit->hit = 0;
+    if (!pyramid || !terrain || !origin || !direction) return 0;
+
+    float length = sqrtf(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+    if (length == 0.0f) return 0;
+
+    // Work in grid space: one unit per voxel, cell (0, 0) at the origin
+    float o[3] = {
+        (origin[0] - TERRAIN_ORIGIN_X(terrain)) / VOXEL_SIZE,
+        origin[1] / VOXEL_SIZE,
+        (origin[2] - TERRAIN_ORIGIN_Z(terrain)) / VOXEL_SIZE
+    };
+    float d[3] = { direction[0] / length, direction[1] / length, direction[2] / length };
+    float tFar = maxDistance / VOXEL_SIZE;
+
+    // Clip the ray against the terrain bounding box; remember which slab it entered through
+    int top = pyramid->levels - 1;
+    float boxMax[3] = { (float)terrain->width, pyramid->maxHeights[top][0], (float)terrain->depth };
+    float tNear = 0.0f;
+    int entryAxis = 1;
+    for (int axis = 0; axis < 3; axis++) {
+        if (d[axis] == 0.0f) {
+            if (o[axis] < 0.0f || o[axis] > boxMax[axis]) return 0;
+            continue;
+        }
+        float t0 = (0.0f - o[axis]) / d[axis];
+        float t1 = (boxMax[axis] - o[axis]) / d[axis];
+        if (t0 > t1) { float swap = t0; t0 = t1; t1 = swap; }
+        if (t0 > tNear) { tNear = t0; entryAxis = axis; }
+        if (t1 < tFar) tFar = t1;
+    }
+    if (tNear > tFar) return 0;
+
+    float t = tNear;
+    int level = top;
+
+    // The current cell is tracked as integers so that stepping across a block
+    // boundary never depends on float round-off at the boundary itself
+    int cellX = clampCell(o[0] + d[0] * t, 0, terrain->width - 1);
+    int cellZ = clampCell(o[2] + d[2] * t, 0, terrain->depth - 1);
+
+    // Descend into blocks the ray dips below, skip blocks it passes over entirely
+    for (;;) {
+        if (t > tFar || cellX < 0 || cellX >= terrain->width || cellZ < 0 || cellZ >= terrain->depth) {
+            return 0;
+        }
+
+        int size = 1 << level;
+        int blockX = cellX >> level;
+        int blockZ = cellZ >> level;
+        float blockMax = pyramid->maxHeights[level][blockZ * pyramid->width[level] + blockX];
+
+        float tExitX = blockExit(o[0], d[0], blockX << level, size);
+        float tExitZ = blockExit(o[2], d[2], blockZ << level, size);
+        float tExit = fminf(fminf(tExitX, tExitZ), tFar);
+
+        float yEnter = o[1] + d[1] * t;
+        float yExit = o[1] + d[1] * tExit;
+
+        if (fminf(yEnter, yExit) >= blockMax) {
+            // The ray stays above this whole block: step into the neighbouring block
+            // along the exit axis and clamp the other axis to this block's extent
+            if (tExitX < tExitZ) {
+                entryAxis = 0;
+                cellX = d[0] > 0.0f ? (blockX + 1) << level : (blockX << level) - 1;
+                cellZ = clampCell(o[2] + d[2] * tExitX, blockZ << level, ((blockZ + 1) << level) - 1);
+            } else {
+                entryAxis = 2;
+                cellZ = d[2] > 0.0f ? (blockZ + 1) << level : (blockZ << level) - 1;
+                cellX = clampCell(o[0] + d[0] * tExitZ, blockX << level, ((blockX + 1) << level) - 1);
+            }
+            if (tExit >= tFar) return 0;
+            t = tExit;
+            if (level < top) level++;
+            continue;
+        }
+
+        if (level > 0) {
+            level--;
+            continue;
+        }
+
+        // Level 0: the ray reaches below this column's top inside the cell
+        float tHit = t;
+        FaceType face;
+        if (yEnter < blockMax) {
+            if (entryAxis == 0) face = d[0] > 0.0f ? LEFT : RIGHT;
+            else if (entryAxis == 2) face = d[2] > 0.0f ? FRONT : BACK;
+            else face = d[1] > 0.0f ? BOTTOM : TOP;
+        } else {
+            tHit = (blockMax - o[1]) / d[1];
+            face = TOP;
+        }
+
+        float hitY = o[1] + d[1] * tHit;
+        int voxelY = (int)floorf(hitY);
+        if (voxelY >= (int)blockMax) voxelY = (int)blockMax - 1;
+        if (voxelY < 0) voxelY = 0;
+
+        hit->hit = 1;
+        hit->x = cellX;
+        hit->y = voxelY;
+        hit->z = cellZ;
+        hit->face = face;
+        hit->distance = tHit * VOXEL_SIZE;
+        hit->position[0] = origin[0] + d[0] * hit->distance;
+        hit->position[1] = origin[1] + d[1] * hit->distance;
+        hit->position[2] = origin[2] + d[2] * hit->distance;
+        return 1;
+    }
+}
+
+void pyramidRaycastBatch(const HeightPyramid* pyramid, const Terrain* terrain,
+                         const float* origins, const float* directions, const float* maxDistances,
+                         int count, TerrainHit* hits) {
+    if (!origins || !directions || !maxDistances || !hits) return;
+    for (int i = 0; i < count; i++) {
+        pyramidRaycast(pyramid, terrain, origins + i * 3, directions + i * 3, maxDistances[i], &hits[i]);
+    }
+}
@@ -0,0 +1,46 @@
+// pyramid.h
+#ifndef PYRAMID_H
+#define PYRAMID_H
+
+#include "terrain.h"
+
+#define PYRAMID_MAX_LEVELS 16
+
+// Min/max mip pyramid over the voxel column tops of a terrain.
+// Level 0 holds one value per cell: the top of the column in voxel units,
+// i.e. (int)(height * MAX_HEIGHT) + 1. Each higher level halves the grid and
+// stores the min and max of the 2x2 block below it.
+typedef struct {
+    int levels;
+    int width[PYRAMID_MAX_LEVELS];
+    int depth[PYRAMID_MAX_LEVELS];
+    float* minHeights[PYRAMID_MAX_LEVELS];
+    float* maxHeights[PYRAMID_MAX_LEVELS];
+} HeightPyramid;
+
+// Result of a terrain ray cast
+typedef struct {
+    int hit;            // Non-zero if the ray hit a voxel
+    int x, y, z;        // Cell coordinates and voxel layer of the hit voxel
+    FaceType face;      // Face of the voxel the ray entered through
+    float distance;     // World-space distance from the ray origin
+    float position[3];  // World-space hit point
+} TerrainHit;
+
+HeightPyramid* createHeightPyramid(const Terrain* terrain);
+void destroyHeightPyramid(HeightPyramid* pyramid);
+
+// Rebuild the cells in [x0, x1) x [z0, z1) and every pyramid level above them
+void pyramidUpdateRect(HeightPyramid* pyramid, const Terrain* terrain, int x0, int z0, int x1, int z1);
+
+// Cast a world-space ray (direction need not be normalized) against the voxel
+// columns, up to maxDistance world units. Returns hit->hit.
+int pyramidRaycast(const HeightPyramid* pyramid, const Terrain* terrain,
+                   const float origin[3], const float direction[3], float maxDistance, TerrainHit* hit);
+
+// Cast 'count' rays; origins and directions are packed xyz triplets
+void pyramidRaycastBatch(const HeightPyramid* pyramid, const Terrain* terrain,
+                         const float* origins, const float* directions, const float* maxDistances,
+                         int count, TerrainHit* hits);
+
+#endif // PYRAMID_H
@@ -0,0 +1,113 @@
+// query.c
+#include "query.h"
+#include "normals.h"
+#include <math.h>
+#include <stddef.h>
+
+// Resolve up to QUERY_BATCH positions. The work is split into three passes so the
+// coordinate and interpolation passes are plain arithmetic over arrays (which the
+// compiler vectorizes) and only the gather touches the heightmap.
+static void sampleBlock(const Terrain* terrain, const float* xs, const float* zs,
+                        float* outHeights, float* outNormals, int count) {
+    int index00[QUERY_BATCH];
+    float fracX[QUERY_BATCH], fracZ[QUERY_BATCH];
+    float h00[QUERY_BATCH], h10[QUERY_BATCH], h01[QUERY_BATCH], h11[QUERY_BATCH];
+
+    // Cell centres sit half a voxel in from the cell corner
+    float originX = TERRAIN_ORIGIN_X(terrain) + 0.5f * VOXEL_SIZE;
+    float originZ = TERRAIN_ORIGIN_Z(terrain) + 0.5f * VOXEL_SIZE;
+    float invCell = 1.0f / VOXEL_SIZE;
+    float maxX = (float)(terrain->width - 1);
+    float maxZ = (float)(terrain->depth - 1);
+
+    // The lower corner is kept one cell inside the far edge so that the +1 neighbour
+    // always exists, even without an apron; the fraction then reaches 1.0 at the edge
+    float lastCornerX = (float)(terrain->width > 1 ? terrain->width - 2 : 0);
+    float lastCornerZ = (float)(terrain->depth > 1 ? terrain->depth - 2 : 0);
+    int stepX = terrain->width > 1 ? 1 : 0;
+    int stepZ = terrain->depth > 1 ? terrain->stride : 0;
+
+    // Pass 1: world position -> clamped grid coordinate, corner index and fraction
+    for (int i = 0; i < count; i++) {
+        float gx = fminf(fmaxf((xs[i] - originX) * invCell, 0.0f), maxX);
+        float gz = fminf(fmaxf((zs[i] - originZ) * invCell, 0.0f), maxZ);
+        float cx = fminf(floorf(gx), lastCornerX);
+        float cz = fminf(floorf(gz), lastCornerZ);
+        fracX[i] = gx - cx;
+        fracZ[i] = gz - cz;
+        index00[i] = (int)cz * terrain->stride + (int)cx;
+    }
+
+    // Pass 2: gather the four surrounding cells
+    const float* heights = terrain->heights;
+    for (int i = 0; i < count; i++) {
+        const float* p = heights + index00[i];
+        h00[i] = p[0];
+        h10[i] = p[stepX];
+        h01[i] = p[stepZ];
+        h11[i] = p[stepZ + stepX];
+    }
+
+    // Pass 3: bilinear blend, scaled to world units
+    float scale = MAX_HEIGHT * VOXEL_SIZE;
+    for (int i = 0; i < count; i++) {
+        float top = h00[i] + fracX[i] * (h10[i] - h00[i]);
+        float bottom = h01[i] + fracX[i] * (h11[i] - h01[i]);
+        outHeights[i] = (top + fracZ[i] * (bottom - top)) * scale;
+    }
+
+    if (!outNormals) return;
+
+    // Prefer the shared precomputed normals when the terrain has them
+    if (terrain->normals) {
+        for (int i = 0; i < count; i++) {
+            int z = index00[i] / terrain->stride;
+            int x = index00[i] - z * terrain->stride;
+            float n00[3], n10[3], n01[3], n11[3];
+            unpackNormal(TERRAIN_NORMAL(terrain, x, z), n00);
+            unpackNormal(TERRAIN_NORMAL(terrain, x + stepX, z), n10);
+            unpackNormal(TERRAIN_NORMAL(terrain, x, z + (stepZ ? 1 : 0)), n01);
+            unpackNormal(TERRAIN_NORMAL(terrain, x + stepX, z + (stepZ ? 1 : 0)), n11);
+
+            float blended[3];
+            for (int c = 0; c < 3; c++) {
+                float top = n00[c] + fracX[i] * (n10[c] - n00[c]);
+                float bottom = n01[c] + fracX[i] * (n11[c] - n01[c]);
+                blended[c] = top + fracZ[i] * (bottom - top);
+            }
+            float invLength = 1.0f / sqrtf(blended[0] * blended[0] + blended[1] * blended[1] + blended[2] * blended[2]);
+            outNormals[i * 3 + 0] = blended[0] * invLength;
+            outNormals[i * 3 + 1] = blended[1] * invLength;
+            outNormals[i * 3 + 2] = blended[2] * invLength;
+        }
+        return;
+    }
+
+    // Otherwise use the normal of the bilinear patch from its partial derivatives (world units per world unit)
+    float slopeScale = scale * invCell;
+    for (int i = 0; i < count; i++) {
+        float dx = ((h10[i] - h00[i]) + fracZ[i] * ((h11[i] - h01[i]) - (h10[i] - h00[i]))) * slopeScale;
+        float dz = ((h01[i] - h00[i]) + fracX[i] * ((h11[i] - h10[i]) - (h01[i] - h00[i]))) * slopeScale;
+        float invLength = 1.0f / sqrtf(dx * dx + 1.0f + dz * dz);
+        outNormals[i * 3 + 0] = -dx * invLength;
+        outNormals[i * 3 + 1] = invLength;
+        outNormals[i * 3 + 2] = -dz * invLength;
+    }
+}
+
+void terrainSampleHeights(const Terrain* terrain, const float* xs, const float* zs,
+                          float* outHeights, float* outNormals, int count) {
+    if (!terrain || !terrain->heights || !xs || !zs || !outHeights) return;
+
+    for (int start = 0; start < count; start += QUERY_BATCH) {
+        int n = count - start < QUERY_BATCH ? count - start : QUERY_BATCH;
+        sampleBlock(terrain, xs + start, zs + start, outHeights + start,
+                    outNormals ? outNormals + start * 3 : NULL, n);
+    }
+}
+
+float terrainHeightAt(const Terrain* terrain, float worldX, float worldZ) {
+    float height = 0.0f;
+    terrainSampleHeights(terrain, &worldX, &worldZ, &height, NULL, 1);
+    return height;
+}
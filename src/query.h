@@ -0,0 +1,23 @@
+// query.h
+#ifndef QUERY_H
+#define QUERY_H
+
+#include "terrain.h"
+
+#define QUERY_BATCH 64  // Positions resolved per internal block
+
+// Batched height queries for gameplay and physics code.
+// Positions are world-space (x, z) pairs in the same frame renderTerrain draws in.
+// Heights are bilinearly interpolated between cell centres and returned in world units.
+// Positions outside the map are clamped to the nearest edge.
+//
+// outNormals is optional (NULL to skip) and receives count * 3 floats (x, y, z),
+// the unit normal at each position: the precomputed normals from terrainComputeNormals
+// blended bilinearly when available, otherwise the normal of the interpolated surface.
+void terrainSampleHeights(const Terrain* terrain, const float* xs, const float* zs,
+                          float* outHeights, float* outNormals, int count);
+
+// Single-position convenience wrapper around terrainSampleHeights
+float terrainHeightAt(const Terrain* terrain, float worldX, float worldZ);
+
+#endif // QUERY_H
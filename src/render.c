@@ -1,12 +1,21 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <GL/glew.h>
 #include "render.h"
+#include "materials.h"
+#include "mesh.h"
+#include "shader.h"
+#include "camera.h"
+#include "occlusion.h"
+#include "rtin.h"
+#include "jobs.h"
 #include "stb_image.h"
 #include <GL/gl.h>
-#include <GL/glu.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
 
 // Define the window dimensions
 #define WINDOW_WIDTH 2048
@@ -15,9 +24,6 @@
 // Define Voxel Threshold for Culling
 #define VOXEL_THRESHOLD 0.1f  // Adjust as necessary
 
-// Define Voxel Size
-#define VOXEL_SIZE 1.0f  // Adjust to scale individual voxels
-
 // Declare a global pointer to the GLFW window
 static GLFWwindow* window = NULL;
 
@@ -30,84 +36,343 @@ bool firstMouse = true;
 
 float fov = 45.0f;
 
-// Texture IDs
-GLuint textureWater, textureSand, textureGrass, textureMountain, textureSnow;
-
-// Function to set up basic lighting
-void setupLighting() {
-    glEnable(GL_LIGHTING);
-    glEnable(GL_LIGHT0); // Enable the first light source
+// Material textures, one array layer per Material in enum order
+static const char* materialTextureFiles[MATERIAL_COUNT] = {
+    "textures/water.jpeg",
+    "textures/sand.png",
+    "textures/grass.png",
+    "textures/mountain.png",
+    "textures/snow.png"
+};
+static GLuint materialTextures = 0;
+
+// Core-profile terrain shaders. Both vertex formats feed one fragment shader that
+// picks sand, grass, mountain and snow from the height and slope of each pixel,
+// blending across the thresholds, and lights it per pixel with a directional
+// light. Only water comes from the vertex material, since it follows the water
+// simulation rather than the height.
+static const GLfloat lightDirection[3] = { 0.0f, 0.70710678f, 0.70710678f };  // Towards the light
+#define MATERIAL_BLEND_HEIGHT (0.5f * VOXEL_SIZE)   // Half-width of the blend around each height threshold
+
+// Smooth surfaces: float MeshVertex attributes
+static GLuint terrainProgram = 0;
+static GLint terrainViewProjectionLocation = -1;
+
+static const char* terrainVertexShader =
+    "#version 330 core\n"
+    "layout(location = 0) in vec3 position;\n"
+    "layout(location = 1) in vec3 normal;\n"
+    "layout(location = 2) in vec2 uv;\n"
+    "layout(location = 3) in uint material;\n"
+    "uniform mat4 viewProjection;\n"
+    "out vec3 worldPosition;\n"
+    "out vec3 worldNormal;\n"
+    "out vec2 texCoord;\n"
+    "flat out uint layer;\n"
+    "void main() {\n"
+    "    worldPosition = position;\n"
+    "    worldNormal = normal;\n"
+    "    texCoord = uv;\n"
+    "    layer = material;\n"
+    "    gl_Position = viewProjection * vec4(position, 1.0);\n"
+    "}\n";
+
+// Voxel chunks: packed vertices (see PackedVertex) decoded against the chunk origin
+static GLuint voxelProgram = 0;
+static GLint voxelViewProjectionLocation = -1;
+static GLint chunkOriginLocation = -1;
+
+static const char* voxelVertexShader =
+    "#version 330 core\n"
+    "layout(location = 0) in uint vertexData;\n"
+    "uniform mat4 viewProjection;\n"
+    "uniform vec3 chunkOrigin;\n"
+    "uniform float voxelSize;\n"
+    "out vec3 worldPosition;\n"
+    "out vec3 worldNormal;\n"
+    "out vec2 texCoord;\n"
+    "flat out uint layer;\n"
+    "const vec3 faceNormals[6] = vec3[6](vec3(0.0, 0.0, -1.0), vec3(0.0, 0.0, 1.0), vec3(-1.0, 0.0, 0.0),\n"
+    "                                    vec3(1.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0), vec3(0.0, -1.0, 0.0));\n"
+    "void main() {\n"
+    "    vec3 local = vec3(float(vertexData & 0xFFu), float((vertexData >> 16) & 0x3Fu), float((vertexData >> 8) & 0xFFu));\n"
+    "    uint face = (vertexData >> 22) & 0x7u;\n"
+    "    worldPosition = chunkOrigin + local * voxelSize;\n"
+    "    worldNormal = faceNormals[face];\n"
+    "    // Repeat once per voxel: x and y on FRONT/BACK, y and z on LEFT/RIGHT, x and z on TOP\n"
+    "    texCoord = face < 2u ? local.xy : (face < 4u ? local.yz : local.xz);\n"
+    "    layer = (vertexData >> 25) & 0xFu;\n"
+    "    gl_Position = viewProjection * vec4(worldPosition, 1.0);\n"
+    "}\n";
+
+// Displaced grid: one shared chunk-sized grid, instanced per visible chunk and
+// lifted by the heightmap texture, so GPU memory grows with the map rather than
+// the mesh
+static GLuint displacedProgram = 0;
+static GLint displacedViewProjectionLocation = -1;
+static GLint displacedTerrainOriginLocation = -1;
+
+static const char* displacedVertexShader =
+    "#version 330 core\n"
+    "layout(location = 0) in uvec2 gridVertex;   // Column within the chunk\n"
+    "layout(location = 1) in ivec2 chunkColumn;  // First column of the chunk, per instance\n"
+    "uniform sampler2D heightmap;                // Normalized height per column\n"
+    "uniform usampler2D materialMap;             // Material per column\n"
+    "uniform mat4 viewProjection;\n"
+    "uniform vec2 terrainOrigin;                 // World x and z of column (0, 0)\n"
+    "uniform float heightScale;\n"
+    "uniform float voxelSize;\n"
+    "out vec3 worldPosition;\n"
+    "out vec3 worldNormal;\n"
+    "out vec2 texCoord;\n"
+    "flat out uint layer;\n"
+    "float heightAt(ivec2 column) {\n"
+    "    return texelFetch(heightmap, clamp(column, ivec2(0), textureSize(heightmap, 0) - 1), 0).r * heightScale;\n"
+    "}\n"
+    "void main() {\n"
+    "    // Edge chunks may overhang the map; their extra vertices fold onto its edge\n"
+    "    ivec2 column = min(chunkColumn + ivec2(gridVertex), textureSize(heightmap, 0));\n"
+    "    // Central differences, as terrainComputeNormals\n"
+    "    float dx = heightAt(column + ivec2(1, 0)) - heightAt(column - ivec2(1, 0));\n"
+    "    float dz = heightAt(column + ivec2(0, 1)) - heightAt(column - ivec2(0, 1));\n"
+    "    worldNormal = vec3(-dx, 2.0 * voxelSize, -dz);\n"
+    "    worldPosition = vec3(terrainOrigin.x + float(column.x) * voxelSize, heightAt(column),\n"
+    "                         terrainOrigin.y + float(column.y) * voxelSize);\n"
+    "    texCoord = vec2(column);\n"
+    "    layer = texelFetch(materialMap, clamp(column, ivec2(0), textureSize(materialMap, 0) - 1), 0).r;\n"
+    "    gl_Position = viewProjection * vec4(worldPosition, 1.0);\n"
+    "}\n";
+
+// Layers are in Material order: water, sand, grass, mountain, snow
+static const char* terrainFragmentShader =
+    "#version 330 core\n"
+    "uniform sampler2DArray materials;\n"
+    "uniform vec3 lightDirection;\n"
+    "uniform vec3 materialHeights;   // World heights where sand meets grass, grass mountain, mountain snow\n"
+    "uniform float blendHeight;\n"
+    "uniform vec2 cliffSlopes;       // Rise over run where cliffs start and where they are bare rock\n"
+    "in vec3 worldPosition;\n"
+    "in vec3 worldNormal;\n"
+    "in vec2 texCoord;\n"
+    "flat in uint layer;\n"
+    "out vec4 fragColor;\n"
+    "vec3 layerColor(float material) {\n"
+    "    return texture(materials, vec3(texCoord, material)).rgb;\n"
+    "}\n"
+    "void main() {\n"
+    "    vec3 n = normalize(worldNormal);\n"
+    "    vec3 albedo;\n"
+    "    if (layer == 0u) {\n"
+    "        albedo = layerColor(0.0);\n"
+    "    } else {\n"
+    "        float h = worldPosition.y;\n"
+    "        float grass = smoothstep(materialHeights.x - blendHeight, materialHeights.x + blendHeight, h);\n"
+    "        float mountain = smoothstep(materialHeights.y - blendHeight, materialHeights.y + blendHeight, h);\n"
+    "        float snow = smoothstep(materialHeights.z - blendHeight, materialHeights.z + blendHeight, h);\n"
+    "        albedo = mix(mix(mix(layerColor(1.0), layerColor(2.0), grass), layerColor(3.0), mountain), layerColor(4.0), snow);\n"
+    "        // Steep ground below the snow line is rock\n"
+    "        float slope = length(n.xz) / max(n.y, 1e-3);\n"
+    "        float cliff = smoothstep(cliffSlopes.x, cliffSlopes.y, slope) * (1.0 - snow);\n"
+    "        albedo = mix(albedo, layerColor(3.0), cliff);\n"
+    "    }\n"
+    "    float light = min(0.2 + max(dot(n, lightDirection), 0.0), 1.0);  // Ambient plus diffuse\n"
+    "    fragColor = vec4(albedo * light, 1.0);\n"
+    "}\n";
+
+// Camera matrices, rebuilt by updateCameraView
+static float projectionMatrix[16];
+static float viewMatrix[16];
+#define CAMERA_NEAR 0.1f
+#define CAMERA_FAR 1000.0f
+
+// Optional water simulation driving the water material
+static WaterSim* waterSim = NULL;
+#define WATER_MAX_STEPS_PER_FRAME 8 // Drop simulation time rather than stall the frame
+
+void renderSetWater(WaterSim* water) {
+    waterSim = water;
+}
 
-    // Define light properties
-    GLfloat lightPos[] = { 0.0f, 100.0f, 100.0f, 1.0f };  // Elevated light position
-    GLfloat lightColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };    // White light
+// Optional editor for sculpting with the mouse at the screen centre
+static TerrainEditor* terrainEditor = NULL;
+#define SCULPT_RADIUS 8.0f          // Brush radius in world units
+#define SCULPT_RATE 0.5f            // Normalized height per second at the brush centre
 
-    glLightfv(GL_LIGHT0, GL_POSITION, lightPos);
-    glLightfv(GL_LIGHT0, GL_DIFFUSE, lightColor);  // Diffuse light
-    glLightfv(GL_LIGHT0, GL_SPECULAR, lightColor); // Specular light
+void renderSetEditor(TerrainEditor* editor) {
+    terrainEditor = editor;
 }
 
-// Function to load a texture using stb_image
-GLuint loadTexture(const char* filename) {
-    int width, height, nrChannels;
+// One indexed mesh with its own buffers, for the smooth surface
+typedef struct {
+    GLuint vao, vbo, ibo;
+    GLsizei indexCount;
+} MeshBuffers;
+
+// Retained terrain geometry: one packed vertex range per MESH_CHUNK_SIZE chunk and
+// level of detail. Levels are built the first time they are drawn and released
+// when the chunk's columns change.
+typedef struct {
+    int block;              // Range in vertexPool, or -1
+    GLsizei indexCount;
+} ChunkLevel;
+
+static GLuint quadIndexBuffer = 0;  // 0-1-2, 0-2-3 for every quad, shared by all packed meshes
+static size_t quadIndexQuads = 0;
+
+// Every chunk level lives in one vertex buffer, suballocated by vertex and drawn
+// with a base vertex against quadIndexBuffer, so streaming chunks never creates or
+// deletes buffer objects. The buffer is replaced only to grow it, or to compact it
+// once its free space is scattered over many small ranges.
+#define VERTEX_POOL_INITIAL_VERTICES (1u << 20)
+#define VERTEX_POOL_COMPACT_FRAGMENTATION 0.5f  // Share of free space outside the largest range
+static Suballocator* vertexPool = NULL;
+static GLuint vertexPoolBuffer = 0;
+static GLuint vertexPoolVao = 0;
+
+typedef struct {
+    ChunkLevel levels[MESH_MAX_LOD + 1];
+    float lodError[MESH_MAX_LOD + 1];   // World-space height error of each level
+    unsigned int built;                 // Bit per level whose buffers are current
+    int lod;                            // Level selected for this frame
+    bool dirty;
+} ChunkBuffers;
+
+static ChunkGrid* chunkGrid = NULL;
+static ChunkBuffers* chunkBuffers = NULL;
+static int* dirtyChunks = NULL;     // Chunks refreshed this frame, one slot per chunk
+
+// Chunk levels are meshed on the worker pool MESH_BUILD_BATCH at a time, each
+// worker with its own scratch, into upload-ready arrays; the GL thread only
+// uploads them
+#define MESH_BUILD_BATCH 64
+typedef struct {
+    int chunk, lod;
+    MeshStats stats;
+    int ok;
+} ChunkBuild;
+
+static MeshScratch** meshScratch = NULL;    // One per worker
+static int meshScratchCount = 0;
+static ChunkBuild chunkBuilds[MESH_BUILD_BATCH];
+static PackedMesh builtMeshes[MESH_BUILD_BATCH];
+static OcclusionBuffer* occlusionBuffer = NULL;
+#define OCCLUSION_RESOLUTION 256    // Software depth buffer size for occlusion culling
+static bool terrainMeshDirty = true;
+static CullStats cullStats;
+
+// Coarser levels are drawn while their height error covers at most this many pixels
+#define LOD_DEFAULT_THRESHOLD 2.0f
+static float lodThreshold = LOD_DEFAULT_THRESHOLD;
+
+// Smooth mode: one RTIN surface instead of voxel chunks, for overview renders.
+// Off while smoothMaxError is negative.
+static TerrainRtin* terrainRtin = NULL;
+static MeshBuffers smoothBuffers;
+static TerrainMesh smoothMesh;
+static float smoothMaxError = -1.0f;
+static float smoothLoggedError = -1.0f;    // Error limit of the last rebuild reported on stdout
+static bool smoothMeshDirty = true;
+
+// Displaced mode: heights and materials live in textures updated in place, and
+// every visible chunk draws the same grid
+static bool displacedMode = false;
+static bool displacedDirty = true;      // Re-upload both textures before the next frame
+static GLuint heightmapTexture = 0;     // R32F, one texel per column
+static GLuint materialMapTexture = 0;   // R8UI, one texel per column
+static GLuint gridVao = 0, gridVbo = 0, gridIbo = 0, instanceVbo = 0;
+static GLsizei gridIndexCount = 0;
+static int* instanceColumns = NULL;     // First column of each visible chunk, two ints each
+
+// Camera state from the last updateCameraView, used for picking
+static float cameraEye[3] = { 0.0f, 0.0f, 150.0f };
+static float cameraForward[3] = { 0.0f, 0.0f, -1.0f };
+
+// Load images into the layers of one GL_TEXTURE_2D_ARRAY, so every material is
+// drawn with a single texture binding. All layers take the size of the first
+// image; others are resampled (nearest) to fit.
+GLuint loadTextureArray(const char* const* filenames, int count) {
+    int layerWidth = 0, layerHeight = 0;
+    unsigned char* layers = NULL;
     stbi_set_flip_vertically_on_load(true); // Flip vertically to match OpenGL's coordinate system
-    unsigned char* data = stbi_load(filename, &width, &height, &nrChannels, 0);
-    if (!data) {
-        fprintf(stderr, "Failed to load texture: %s\n", filename);
-        return 0;
-    }
 
-    printf("Loaded texture: %s (Width: %d, Height: %d, Channels: %d)\n", filename, width, height, nrChannels);
-
-    GLuint textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-
-    // Set texture wrapping and filtering options
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);	// Repeat horizontally
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);	// Repeat vertically
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); // Minification
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);               // Magnification
+    for (int i = 0; i < count; i++) {
+        int width, height, nrChannels;
+        unsigned char* data = stbi_load(filenames[i], &width, &height, &nrChannels, 4);  // Always expand to RGBA
+        if (!data) {
+            fprintf(stderr, "Failed to load texture: %s\n", filenames[i]);
+            free(layers);
+            return 0;
+        }
+        printf("Loaded texture: %s (Width: %d, Height: %d, Channels: %d)\n", filenames[i], width, height, nrChannels);
+
+        if (!layers) {
+            layerWidth = width;
+            layerHeight = height;
+            layers = (unsigned char*)malloc((size_t)layerWidth * layerHeight * 4 * count);
+            if (!layers) {
+                fprintf(stderr, "Failed to allocate texture array.\n");
+                stbi_image_free(data);
+                return 0;
+            }
+        }
 
-    // Determine the image format
-    GLenum format;
-    if (nrChannels == 1) {
-        format = GL_RED;
-    }
-    else if (nrChannels == 3) {
-        format = GL_RGB;
-    }
-    else if (nrChannels == 4) {
-        format = GL_RGBA;
-    }
-    else {
-        fprintf(stderr, "Unsupported number of channels: %d in texture %s\n", nrChannels, filename);
+        unsigned char* layer = layers + (size_t)layerWidth * layerHeight * 4 * i;
+        if (width == layerWidth && height == layerHeight) {
+            memcpy(layer, data, (size_t)width * height * 4);
+        } else {
+            fprintf(stderr, "Texture %s is %dx%d; resampling to %dx%d.\n", filenames[i], width, height, layerWidth, layerHeight);
+            for (int y = 0; y < layerHeight; y++) {
+                const unsigned char* sourceRow = data + (size_t)(y * height / layerHeight) * width * 4;
+                for (int x = 0; x < layerWidth; x++) {
+                    memcpy(layer + ((size_t)y * layerWidth + x) * 4, sourceRow + (size_t)(x * width / layerWidth) * 4, 4);
+                }
+            }
+        }
         stbi_image_free(data);
-        return 0;
     }
 
-    // Upload the texture data
-    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
+    GLuint textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
 
-    // Free the image memory
-    stbi_image_free(data);
+    // Set texture wrapping and filtering options
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    printf("Texture loaded successfully: %s (ID: %u)\n", filename, textureID);
+    // Upload every layer at once; mipmaps never blend across layers
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, layerWidth, layerHeight, count, 0, GL_RGBA, GL_UNSIGNED_BYTE, layers);
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    free(layers);
 
+    printf("Texture array loaded successfully: %d layers (ID: %u)\n", count, textureID);
     return textureID;
 }
 
+// Material thresholds of chooseMaterial, in world units for the fragment shader
+static void setMaterialUniforms(GLuint program) {
+    const float scale = MAX_HEIGHT * VOXEL_SIZE;
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "materials"), 0);
+    glUniform3fv(glGetUniformLocation(program, "lightDirection"), 1, lightDirection);
+    glUniform3f(glGetUniformLocation(program, "materialHeights"), 0.4f * scale, 0.6f * scale, 0.8f * scale);
+    glUniform1f(glGetUniformLocation(program, "blendHeight"), MATERIAL_BLEND_HEIGHT);
+    glUniform2f(glGetUniformLocation(program, "cliffSlopes"), STEEP_SLOPE, 2.0f * STEEP_SLOPE);
+    glUseProgram(0);
+}
+
 void initializeGraphics() {
     if (!glfwInit()) {
         fprintf(stderr, "Failed to initialize GLFW\n");
         exit(EXIT_FAILURE);
     }
     
-    // Request OpenGL version 3.3 Compatibility Profile
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 4);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_COMPAT_PROFILE); // Use Compatibility Profile
+    // Request an OpenGL 3.3 core profile; everything is drawn with shaders
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 
     // Create a windowed mode window and its OpenGL context
     window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "3D Terrain Generator", NULL, NULL);
@@ -139,257 +404,714 @@ void initializeGraphics() {
     // Set up the viewport
     glViewport(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
 
-    // Set up perspective projection
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    gluPerspective(45.0f, (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 1000.0f);
-
-    // Set up the camera position (eye position, look-at position, and up vector)
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-    gluLookAt(50.0f, 50.0f, 100.0f,  // Eye position (x, y, z)
-              0.0f, 0.0f, 0.0f,     // Look-at point (center)
-              0.0f, 1.0f, 0.0f);    // Up vector
+    // Camera matrices for the first frame
+    updateCameraView();
 
     // Enable depth testing for proper 3D rendering
     glEnable(GL_DEPTH_TEST);
-    glShadeModel(GL_SMOOTH);
-
-
-    // Set up basic lighting
-    setupLighting();
-    // Enable Color Material
-    glEnable(GL_COLOR_MATERIAL);
-    glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
 
     // Set a distinct clear color
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f);  // Dark gray background
 
-    // Enable texture mapping
-    glEnable(GL_TEXTURE_2D);
-
-    // Load textures
-    textureWater    = loadTexture("textures/water.jpeg"); // Currently commented out
-    textureSand     = loadTexture("textures/sand.png");
-    textureGrass    = loadTexture("textures/grass.png");
-    textureMountain = loadTexture("textures/mountain.png");
-    textureSnow     = loadTexture("textures/snow.png");
-
-    // Check if all textures loaded successfully
-    // Adjust the condition since textureWater is commented out
-    if (!textureWater || !textureSand || !textureGrass || !textureMountain || !textureSnow) {
+    // Load the material textures as one array
+    materialTextures = loadTextureArray(materialTextureFiles, MATERIAL_COUNT);
+    if (!materialTextures) {
         fprintf(stderr, "One or more textures failed to load. Exiting.\n");
         glfwTerminate();
         exit(EXIT_FAILURE);
     }
 
     printf("All textures loaded successfully.\n");
+
+    terrainProgram = createShaderProgram(terrainVertexShader, terrainFragmentShader);
+    if (!terrainProgram) {
+        fprintf(stderr, "Failed to build the terrain shader. Exiting.\n");
+        glfwTerminate();
+        exit(EXIT_FAILURE);
+    }
+    setMaterialUniforms(terrainProgram);
+    terrainViewProjectionLocation = glGetUniformLocation(terrainProgram, "viewProjection");
+
+    voxelProgram = createShaderProgram(voxelVertexShader, terrainFragmentShader);
+    if (!voxelProgram) {
+        fprintf(stderr, "Failed to build the voxel shader. Exiting.\n");
+        glfwTerminate();
+        exit(EXIT_FAILURE);
+    }
+    setMaterialUniforms(voxelProgram);
+    glUseProgram(voxelProgram);
+    glUniform1f(glGetUniformLocation(voxelProgram, "voxelSize"), VOXEL_SIZE);
+    voxelViewProjectionLocation = glGetUniformLocation(voxelProgram, "viewProjection");
+    chunkOriginLocation = glGetUniformLocation(voxelProgram, "chunkOrigin");
+
+    displacedProgram = createShaderProgram(displacedVertexShader, terrainFragmentShader);
+    if (!displacedProgram) {
+        fprintf(stderr, "Failed to build the displaced terrain shader. Exiting.\n");
+        glfwTerminate();
+        exit(EXIT_FAILURE);
+    }
+    setMaterialUniforms(displacedProgram);
+    glUseProgram(displacedProgram);
+    glUniform1i(glGetUniformLocation(displacedProgram, "heightmap"), 1);
+    glUniform1i(glGetUniformLocation(displacedProgram, "materialMap"), 2);
+    glUniform1f(glGetUniformLocation(displacedProgram, "heightScale"), MAX_HEIGHT * VOXEL_SIZE);
+    glUniform1f(glGetUniformLocation(displacedProgram, "voxelSize"), VOXEL_SIZE);
+    displacedViewProjectionLocation = glGetUniformLocation(displacedProgram, "viewProjection");
+    displacedTerrainOriginLocation = glGetUniformLocation(displacedProgram, "terrainOrigin");
+    glUseProgram(0);
+}
+
+void renderInvalidateTerrain() {
+    terrainMeshDirty = true;
+    smoothMeshDirty = true;
+    displacedDirty = true;
+}
+
+void renderSetSmoothTerrain(float maxError) {
+    if (maxError != smoothMaxError) smoothMeshDirty = true;
+    smoothMaxError = maxError;
+    if (maxError >= 0.0f) displacedMode = false;
+}
+
+void renderSetDisplacedTerrain(bool enabled) {
+    displacedMode = enabled;
+    if (enabled) smoothMaxError = -1.0f;
 }
 
-bool isVoxelOccupied(int x, int z, int y, Terrain* terrain) {
-    if (x < 0 || x >= terrain->width || z < 0 || z >= terrain->depth || y < 0) {
-        return false; // Out of bounds
+// Copy [x0, x1) x [z0, z1) of the height and material planes into their textures.
+// Both planes use the terrain's row stride.
+static void uploadHeightmapRect(const Terrain* terrain, int x0, int z0, int x1, int z1) {
+    if (x0 < 0) x0 = 0;
+    if (z0 < 0) z0 = 0;
+    if (x1 > terrain->width) x1 = terrain->width;
+    if (z1 > terrain->depth) z1 = terrain->depth;
+    if (x0 >= x1 || z0 >= z1) return;
+
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, terrain->stride);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_2D, heightmapTexture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x0, z0, x1 - x0, z1 - z0, GL_RED, GL_FLOAT, &TERRAIN_HEIGHT(terrain, x0, z0));
+    if (terrain->materials) {
+        glBindTexture(GL_TEXTURE_2D, materialMapTexture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x0, z0, x1 - x0, z1 - z0, GL_RED_INTEGER, GL_UNSIGNED_BYTE,
+                        &TERRAIN_MATERIAL(terrain, x0, z0));
     }
-    // Retrieve the height at (x, z)
-    float heightValue = terrain->heights[z * terrain->width + x];
-    return y <= (int)(heightValue * (MAX_HEIGHT)); // Define MAX_HEIGHT as the maximum possible Y value
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 }
 
-// Function to choose texture based on height value
-GLuint chooseTexture(float heightValue) {
-    if (heightValue < 0.2f) { // Water
-        return textureWater;
-    } else if (heightValue < 0.4f) { // Sand
-        return textureSand;
-    } else if (heightValue < 0.6f) { // Grassland
-        return textureGrass;
-    } else if (heightValue < 0.8f) { // Mountain
-        return textureMountain;
-    } else { // Snow/Mountain Peaks
-        return textureSnow;
+// Mark the chunks whose geometry depends on cells in [x0, x1) x [z0, z1); walls
+// follow the neighbouring columns, so the rectangle is grown by one cell
+static void invalidateTerrainRect(Terrain* terrain, int x0, int z0, int x1, int z1) {
+    if (terrainRtin) {
+        rtinUpdateRect(terrainRtin, terrain, x0, z0, x1, z1);
+        smoothMeshDirty = true;
+    }
+    if (heightmapTexture) uploadHeightmapRect(terrain, x0 - 1, z0 - 1, x1 + 1, z1 + 1);  // Materials follow the neighbours
+    if (!chunkGrid) return;
+
+    int size = chunkGrid->chunkSize;
+    int cx0 = (x0 - 1) / size, cz0 = (z0 - 1) / size;
+    int cx1 = x1 / size, cz1 = z1 / size;
+    if (cx0 < 0) cx0 = 0;
+    if (cz0 < 0) cz0 = 0;
+    if (cx1 >= chunkGrid->chunksX) cx1 = chunkGrid->chunksX - 1;
+    if (cz1 >= chunkGrid->chunksZ) cz1 = chunkGrid->chunksZ - 1;
+
+    for (int cz = cz0; cz <= cz1; cz++) {
+        for (int cx = cx0; cx <= cx1; cx++) {
+            chunkBuffers[cz * chunkGrid->chunksX + cx].dirty = true;
+        }
     }
 }
 
-// Implement the renderFace function with texture mapping
-void renderFace(float xpos, float ypos, float zpos, float cellWidth, float cellHeight, float depthStep, GLuint textureID, FaceType face) { 
-    glBindTexture(GL_TEXTURE_2D, textureID);  // Bind the texture before drawing
+void renderSetLodThreshold(float pixels) {
+    lodThreshold = pixels > 0.0f ? pixels : 0.0f;
+}
 
-    glBegin(GL_QUADS);
-        switch(face) {
-            case FRONT:
-                // Front face (towards negative Z)
-                glNormal3f(0.0f, 0.0f, -1.0f);  // Normal pointing outwards
+// Refresh a changed chunk's bounds, occluder and level errors, and drop its buffers
+static void refreshChunk(Terrain* terrain, int chunk) {
+    ChunkBuffers* buffers = &chunkBuffers[chunk];
+    int size = chunkGrid->chunkSize;
+    int x0 = (chunk % chunkGrid->chunksX) * size;
+    int z0 = (chunk / chunkGrid->chunksX) * size;
+    int x1 = x0 + size < terrain->width ? x0 + size : terrain->width;
+    int z1 = z0 + size < terrain->depth ? z0 + size : terrain->depth;
+
+    // The displaced grid's last row and column sample the next chunk, so they
+    // count towards the top of the box but not towards the occluder
+    int lowest = (int)MAX_HEIGHT, highest = -1;
+    for (int z = z0; z <= z1 && z < terrain->depth; z++) {
+        for (int x = x0; x <= x1 && x < terrain->width; x++) {
+            int top = (int)(TERRAIN_HEIGHT(terrain, x, z) * MAX_HEIGHT);
+            if (top > highest) highest = top;
+            if (top < lowest && x < x1 && z < z1) lowest = top;
+        }
+    }
 
-                // Specify texture coordinates and vertices
-                glTexCoord2f(0.0f, 0.0f);
-                glVertex3f(xpos, ypos, zpos);
+    // The chunk's footprint up to its highest column; coarser levels hang skirts
+    // down to the ground, so the box starts there
+    float min[3] = { TERRAIN_ORIGIN_X(terrain) + x0 * VOXEL_SIZE, 0.0f, TERRAIN_ORIGIN_Z(terrain) + z0 * VOXEL_SIZE };
+    float max[3] = { TERRAIN_ORIGIN_X(terrain) + x1 * VOXEL_SIZE, (highest + 1) * VOXEL_SIZE, TERRAIN_ORIGIN_Z(terrain) + z1 * VOXEL_SIZE };
+    if (highest < 0) max[1] = -1.0f;  // No columns: leave the chunk empty
+    chunkSetBounds(chunkGrid, chunk, min, max);
 
-                glTexCoord2f(1.0f, 0.0f);
-                glVertex3f(xpos + cellWidth, ypos, zpos);
+    // Everything below the lowest column top is solid at every level and can hide
+    // chunks behind it
+    chunkSetOccluder(chunkGrid, chunk, (lowest + 1) * VOXEL_SIZE);
 
-                glTexCoord2f(1.0f, 1.0f);
-                glVertex3f(xpos + cellWidth, ypos + cellHeight, zpos);
+    for (int lod = 0; lod <= MESH_MAX_LOD; lod++) {
+        buffers->lodError[lod] = terrainLodError(terrain, x0, z0, x1, z1, lod);
+    }
+    buffers->built = 0;
+    buffers->dirty = false;
+}
 
-                glTexCoord2f(0.0f, 1.0f);
-                glVertex3f(xpos, ypos + cellHeight, zpos);
-                break;
-            
-            case BACK:
-                // Back face (towards positive Z)
-                glNormal3f(0.0f, 0.0f, 1.0f);
+// Replace a buffer set's contents with 'mesh', creating the buffers on first use
+static void uploadMesh(MeshBuffers* level, const TerrainMesh* mesh) {
+    if (!level->vao) {
+        glGenVertexArrays(1, &level->vao);
+        glGenBuffers(1, &level->vbo);
+        glGenBuffers(1, &level->ibo);
+
+        // The vertex array records the attribute layout and the index buffer binding
+        glBindVertexArray(level->vao);
+        glBindBuffer(GL_ARRAY_BUFFER, level->vbo);
+        glEnableVertexAttribArray(0);
+        glEnableVertexAttribArray(1);
+        glEnableVertexAttribArray(2);
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (const void*)offsetof(MeshVertex, position));
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (const void*)offsetof(MeshVertex, normal));
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (const void*)offsetof(MeshVertex, uv));
+        glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(MeshVertex), (const void*)offsetof(MeshVertex, material));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, level->ibo);
+        glBindVertexArray(0);
+    }
 
-                glTexCoord2f(0.0f, 0.0f);
-                glVertex3f(xpos, ypos, zpos + depthStep);
+    glBindBuffer(GL_ARRAY_BUFFER, level->vbo);
+    glBufferData(GL_ARRAY_BUFFER, mesh->vertexCount * sizeof(MeshVertex), mesh->vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-                glTexCoord2f(1.0f, 0.0f);
-                glVertex3f(xpos + cellWidth, ypos, zpos + depthStep);
+    glBindVertexArray(level->vao);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh->indexCount * sizeof(unsigned int), mesh->indices, GL_STATIC_DRAW);
+    glBindVertexArray(0);
 
-                glTexCoord2f(1.0f, 1.0f);
-                glVertex3f(xpos + cellWidth, ypos + cellHeight, zpos + depthStep);
+    level->indexCount = (GLsizei)mesh->indexCount;
+}
 
-                glTexCoord2f(0.0f, 1.0f);
-                glVertex3f(xpos, ypos + cellHeight, zpos + depthStep);
-                break;
-            
-            case LEFT:
-                // Left face (towards negative X)
-                glNormal3f(-1.0f, 0.0f, 0.0f);
+static void refreshChunkJob(void* context, int index, int worker) {
+    (void)worker;
+    refreshChunk((Terrain*)context, dirtyChunks[index]);
+}
 
-                glTexCoord2f(0.0f, 0.0f);
-                glVertex3f(xpos, ypos, zpos);
+// Grow the shared quad index buffer to cover 'quads' quads. Vertex arrays keep
+// referring to the same buffer object, so they need no update.
+static int reserveQuadIndices(size_t quads) {
+    if (quads <= quadIndexQuads) return 1;
+    size_t capacity = quadIndexQuads ? quadIndexQuads * 2 : 4096;
+    while (capacity < quads) capacity *= 2;
+    if (capacity * 4 > 0xFFFFFFFFu) return 0;
+
+    unsigned int* indices = (unsigned int*)malloc(capacity * 6 * sizeof(unsigned int));
+    if (!indices) {
+        fprintf(stderr, "Failed to allocate quad indices.\n");
+        return 0;
+    }
+    for (size_t q = 0; q < capacity; q++) {
+        unsigned int base = (unsigned int)(q * 4);
+        unsigned int* index = indices + q * 6;
+        index[0] = base;
+        index[1] = base + 1;
+        index[2] = base + 2;
+        index[3] = base;
+        index[4] = base + 2;
+        index[5] = base + 3;
+    }
 
-                glTexCoord2f(1.0f, 0.0f);
-                glVertex3f(xpos, ypos + cellHeight, zpos);
+    // Upload through a non-VAO target so no vertex array's element binding changes
+    if (!quadIndexBuffer) glGenBuffers(1, &quadIndexBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, quadIndexBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, capacity * 6 * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    free(indices);
+    quadIndexQuads = capacity;
+    return 1;
+}
 
-                glTexCoord2f(1.0f, 1.0f);
-                glVertex3f(xpos, ypos + cellHeight, zpos + depthStep);
+// Point the pool's vertex array at a (new) pool buffer
+static void bindVertexPool(GLuint buffer) {
+    if (vertexPoolBuffer) glDeleteBuffers(1, &vertexPoolBuffer);
+    vertexPoolBuffer = buffer;
+    glBindVertexArray(vertexPoolVao);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexPoolBuffer);
+    glEnableVertexAttribArray(0);
+    glVertexAttribIPointer(0, 1, GL_UNSIGNED_INT, sizeof(PackedVertex), NULL);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadIndexBuffer);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
 
-                glTexCoord2f(0.0f, 1.0f);
-                glVertex3f(xpos, ypos, zpos + depthStep);
-                break;
-            
-            case RIGHT:
-                // Right face (towards positive X)
-                glNormal3f(1.0f, 0.0f, 0.0f);
+static GLuint createPoolBuffer(size_t vertices) {
+    GLuint buffer = 0;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, vertices * sizeof(PackedVertex), NULL, GL_DYNAMIC_DRAW);
+    return buffer;
+}
 
-                glTexCoord2f(0.0f, 0.0f);
-                glVertex3f(xpos + cellWidth, ypos, zpos);
+static void copyVertexRun(void* context, size_t from, size_t to, size_t size) {
+    (void)context;
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, from * sizeof(PackedVertex),
+                        to * sizeof(PackedVertex), size * sizeof(PackedVertex));
+}
 
-                glTexCoord2f(1.0f, 0.0f);
-                glVertex3f(xpos + cellWidth, ypos + cellHeight, zpos);
+// Copy the pool into a new buffer, either grown to 'capacity' vertices with every
+// offset kept, or at its current size with the live ranges packed to the front
+static int reallocateVertexPool(size_t capacity, bool compact) {
+    size_t oldCapacity = vertexPool->capacity;
+    if (!compact && !suballocGrow(vertexPool, capacity)) return 0;
+
+    GLuint buffer = createPoolBuffer(compact ? oldCapacity : capacity);
+    glBindBuffer(GL_COPY_READ_BUFFER, vertexPoolBuffer);
+    if (compact) suballocCompact(vertexPool, copyVertexRun, NULL);
+    else copyVertexRun(NULL, 0, 0, oldCapacity);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    bindVertexPool(buffer);
+    return 1;
+}
 
-                glTexCoord2f(1.0f, 1.0f);
-                glVertex3f(xpos + cellWidth, ypos + cellHeight, zpos + depthStep);
+// Reserve 'count' vertices, compacting the pool when the space exists but is
+// fragmented and growing it otherwise. Returns a pool handle, or -1.
+static int allocateVertices(size_t count) {
+    if (!vertexPool) {
+        vertexPool = createSuballocator(VERTEX_POOL_INITIAL_VERTICES);
+        if (!vertexPool) {
+            fprintf(stderr, "Failed to create the chunk vertex pool.\n");
+            return -1;
+        }
+        glGenVertexArrays(1, &vertexPoolVao);
+        bindVertexPool(createPoolBuffer(VERTEX_POOL_INITIAL_VERTICES));
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
 
-                glTexCoord2f(0.0f, 1.0f);
-                glVertex3f(xpos + cellWidth, ypos, zpos + depthStep);
-                break;
-            
-            case TOP:
-                // Top face (towards positive Y)
-                glNormal3f(0.0f, 1.0f, 0.0f);
+    int block = suballocAlloc(vertexPool, count);
+    if (block >= 0) return block;
+
+    SuballocStats stats;
+    suballocGetStats(vertexPool, &stats);
+    if (stats.capacity - stats.used >= count && stats.fragmentation > VERTEX_POOL_COMPACT_FRAGMENTATION) {
+        reallocateVertexPool(stats.capacity, true);
+    } else {
+        size_t capacity = stats.capacity * 2;
+        while (capacity < stats.capacity + count) capacity *= 2;
+        if (!reallocateVertexPool(capacity, false)) return -1;
+    }
+    return suballocAlloc(vertexPool, count);
+}
 
-                glTexCoord2f(0.0f, 0.0f);
-                glVertex3f(xpos, ypos + cellHeight, zpos);
+// Compact between frames once free space is both plentiful and scattered, so
+// later uploads find contiguous ranges without growing the pool
+static void maintainVertexPool() {
+    if (!vertexPool) return;
+    SuballocStats stats;
+    suballocGetStats(vertexPool, &stats);
+    if (stats.fragmentation > VERTEX_POOL_COMPACT_FRAGMENTATION && stats.capacity - stats.used >= stats.capacity / 4) {
+        reallocateVertexPool(stats.capacity, true);
+    }
+}
 
-                glTexCoord2f(1.0f, 0.0f);
-                glVertex3f(xpos + cellWidth, ypos + cellHeight, zpos);
-
-                glTexCoord2f(1.0f, 1.0f);
-                glVertex3f(xpos + cellWidth, ypos + cellHeight, zpos + depthStep);
-
-                glTexCoord2f(0.0f, 1.0f);
-                glVertex3f(xpos, ypos + cellHeight, zpos + depthStep);
-                break;   
+static void releaseChunkLevel(ChunkLevel* level) {
+    if (level->block >= 0) suballocFree(vertexPool, level->block);
+    level->block = -1;
+    level->indexCount = 0;
+}
 
-            case BOTTOM:
-                // Bottom face (towards negative Y)
-                glNormal3f(0.0f, -1.0f, 0.0f);
+// Replace a chunk level's contents with a packed mesh
+static void uploadPackedMesh(ChunkLevel* level, const PackedMesh* mesh) {
+    releaseChunkLevel(level);
+    if (mesh->vertexCount == 0 || !reserveQuadIndices(mesh->vertexCount / 4)) return;
+    int block = allocateVertices(mesh->vertexCount);
+    if (block < 0) return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, vertexPoolBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, suballocOffset(vertexPool, block) * sizeof(PackedVertex),
+                    mesh->vertexCount * sizeof(PackedVertex), mesh->vertices);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    level->block = block;
+    level->indexCount = (GLsizei)(mesh->vertexCount / 4 * 6);
+}
 
-                glTexCoord2f(0.0f, 0.0f);
-                glVertex3f(xpos, ypos + cellHeight, zpos);
+// Worker side: mesh one queued chunk level into its batch slot
+static void buildChunkJob(void* context, int index, int worker) {
+    const Terrain* terrain = (const Terrain*)context;
+    ChunkBuild* build = &chunkBuilds[index];
+    int size = chunkGrid->chunkSize;
+    int x0 = (build->chunk % chunkGrid->chunksX) * size;
+    int z0 = (build->chunk / chunkGrid->chunksX) * size;
+    build->ok = buildPackedMeshLodRect(meshScratch[worker], terrain, x0, z0, x0 + size, z0 + size, build->lod,
+                                       &builtMeshes[index], &build->stats);
+}
 
-                glTexCoord2f(1.0f, 0.0f);
-                glVertex3f(xpos + cellWidth, ypos + cellHeight, zpos);
+// Mesh a batch of queued levels in parallel, then upload them on this thread
+static void flushChunkBuilds(Terrain* terrain, int count, MeshStats* totals) {
+    jobsParallelFor(count, buildChunkJob, terrain);
+    for (int i = 0; i < count; i++) {
+        const ChunkBuild* build = &chunkBuilds[i];
+        if (!build->ok) continue;
+        ChunkBuffers* buffers = &chunkBuffers[build->chunk];
+        uploadPackedMesh(&buffers->levels[build->lod], &builtMeshes[i]);
+        buffers->built |= 1u << build->lod;
+        totals->columnQuads += build->stats.columnQuads;
+        totals->greedyQuads += build->stats.greedyQuads;
+    }
+}
 
-                glTexCoord2f(1.0f, 1.0f);
-                glVertex3f(xpos + cellWidth, ypos + cellHeight, zpos + depthStep);
-
-                glTexCoord2f(0.0f, 1.0f);
-                glVertex3f(xpos, ypos + cellHeight, zpos + depthStep);
-                break;
+// Build every level the visible chunks need that is not current yet
+static void buildVisibleLevels(Terrain* terrain, MeshStats* totals) {
+    if (!meshScratch) {
+        int workers = jobsWorkerCount();
+        meshScratch = (MeshScratch**)calloc((size_t)workers, sizeof(MeshScratch*));
+        for (int i = 0; meshScratch && i < workers; i++) {
+            meshScratch[i] = createMeshScratch();
+            if (!meshScratch[i]) break;
+            meshScratchCount = i + 1;
         }
-      glEnd();
+        if (meshScratchCount < workers) {
+            fprintf(stderr, "Failed to allocate chunk meshing scratch.\n");
+            return;
+        }
+    }
+    if (meshScratchCount < jobsWorkerCount()) return;
+
+    int queued = 0;
+    for (int i = 0; i < chunkGrid->visibleCount; i++) {
+        int chunk = chunkGrid->order[i];
+        const ChunkBuffers* buffers = &chunkBuffers[chunk];
+        if (buffers->built & (1u << buffers->lod)) continue;
+
+        chunkBuilds[queued].chunk = chunk;
+        chunkBuilds[queued].lod = buffers->lod;
+        if (++queued == MESH_BUILD_BATCH) {
+            flushChunkBuilds(terrain, queued, totals);
+            queued = 0;
+        }
+    }
+    if (queued > 0) flushChunkBuilds(terrain, queued, totals);
 }
 
-// Implement the renderTerrain function
-void renderTerrain(Terrain* terrain) {
-    if (!terrain || !terrain->heights) return;  // Ensure valid data exists before rendering
+// Pick the coarsest level of each visible chunk whose height error projects to at
+// most lodThreshold pixels from the nearest point of the chunk's box
+static void selectChunkLods(void) {
+    float pixelsPerUnit = WINDOW_HEIGHT / (2.0f * tanf(fov * (float)M_PI / 360.0f));
+    for (int i = 0; i < chunkGrid->visibleCount; i++) {
+        int chunk = chunkGrid->order[i];
+        float dx = fabsf(cameraEye[0] - chunkGrid->centerX[chunk]) - chunkGrid->extentX[chunk];
+        float dy = fabsf(cameraEye[1] - chunkGrid->centerY[chunk]) - chunkGrid->extentY[chunk];
+        float dz = fabsf(cameraEye[2] - chunkGrid->centerZ[chunk]) - chunkGrid->extentZ[chunk];
+        dx = dx > 0.0f ? dx : 0.0f;
+        dy = dy > 0.0f ? dy : 0.0f;
+        dz = dz > 0.0f ? dz : 0.0f;
+        float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+
+        ChunkBuffers* buffers = &chunkBuffers[chunk];
+        int lod = 0;
+        while (lod < MESH_MAX_LOD && buffers->lodError[lod + 1] * pixelsPerUnit <= lodThreshold * distance) lod++;
+        buffers->lod = lod;
+    }
+}
 
-    // Calculate voxel dimensions based on VOXEL_SIZE
-    float cellWidth = VOXEL_SIZE;
-    float cellHeight = VOXEL_SIZE;
-    float depthStep = VOXEL_SIZE;
-
-    // Calculate the starting position to center the terrain
-    float startX = -(terrain->width / 2.0f) * cellWidth;
-    float startZ = -(terrain->depth / 2.0f) * depthStep;
-
-    // Loop through 2D terrain grid, rendering only the visible voxel faces
-    for (int z = 0; z < terrain->depth; z++) {
-        for (int x = 0; x < terrain->width; x++) {
-            // Determine the maximum y for this (x, z) based on heightmap
-            int maxY = (int)(terrain->heights[z * terrain->width + x] * MAX_HEIGHT);
-
-            for (int y = 0; y <= maxY; y++) {
-                // Calculate position of the voxel in 3D space
-                float xpos = startX + (x * cellWidth);
-                float ypos = y * cellHeight; // Y position is based on voxel height
-                float zpos = startZ + (z * depthStep);
-
-                // Current voxel height
-                float heightValue = terrain->heights[z * terrain->width + x];
-                if (!isVoxelOccupied(x, z, y, terrain)) continue;  // Skip rendering if voxel is not occupied
-
-                // Choose the appropriate texture based on height
-                GLuint textureID = chooseTexture(heightValue);
-                if (textureID == 0) continue; // Skip if texture not found
-
-                // Check neighboring voxels for face culling
-                bool frontNeighborExists = (z > 0) && isVoxelOccupied(x, z - 1, y, terrain);
-                bool backNeighborExists = (z < terrain->depth - 1) && isVoxelOccupied(x, z + 1, y, terrain);
-                bool leftNeighborExists = (x > 0) && isVoxelOccupied(x - 1, z, y, terrain);
-                bool rightNeighborExists = (x < terrain->width - 1) && isVoxelOccupied(x + 1, z, y, terrain);
-                bool topNeighborExists = (y < maxY) && isVoxelOccupied(x, z, y + 1, terrain);
-                bool bottomNeighborExists = (y > 0) && isVoxelOccupied(x, z, y - 1, terrain);
-
-                // Render faces based on neighbor occupancy
-                if (!frontNeighborExists) {
-                    renderFace(xpos, ypos, zpos, cellWidth, cellHeight, depthStep, textureID, FRONT);
-                }
+// Create the chunk grid on first use and refresh the bounds of dirty chunks.
+// Returns the number of chunks refreshed, or -1 without a grid.
+static int refreshChunkGrid(Terrain* terrain) {
+    if (!chunkGrid) {
+        chunkGrid = createChunkGrid(terrain->width, terrain->depth, MESH_CHUNK_SIZE);
+        chunkBuffers = chunkGrid ? (ChunkBuffers*)calloc((size_t)chunkGrid->count, sizeof(ChunkBuffers)) : NULL;
+        dirtyChunks = chunkGrid ? (int*)malloc((size_t)chunkGrid->count * sizeof(int)) : NULL;
+        if (!chunkBuffers || !dirtyChunks) {
+            fprintf(stderr, "Failed to allocate terrain chunks.\n");
+            free(chunkBuffers);
+            free(dirtyChunks);
+            chunkBuffers = NULL;
+            dirtyChunks = NULL;
+            destroyChunkGrid(chunkGrid);
+            chunkGrid = NULL;
+            return -1;
+        }
+        for (int i = 0; i < chunkGrid->count; i++) {
+            for (int lod = 0; lod <= MESH_MAX_LOD; lod++) chunkBuffers[i].levels[lod].block = -1;
+        }
+        terrainMeshDirty = true;
+    }
 
-                if (!backNeighborExists) {
-                    renderFace(xpos, ypos, zpos + depthStep, cellWidth, cellHeight, depthStep, textureID, BACK);
-                }
+    if (terrainMeshDirty) {
+        for (int i = 0; i < chunkGrid->count; i++) chunkBuffers[i].dirty = true;
+        terrainMeshDirty = false;
+    }
 
-                if (!leftNeighborExists) {
-                    renderFace(xpos, ypos, zpos, cellWidth, cellHeight, depthStep, textureID, LEFT);
-                }
+    int refreshed = 0;
+    for (int i = 0; i < chunkGrid->count; i++) {
+        if (chunkBuffers[i].dirty) dirtyChunks[refreshed++] = i;
+    }
+    jobsParallelFor(refreshed, refreshChunkJob, terrain);
 
-                if (!rightNeighborExists) {
-                    renderFace(xpos + cellWidth, ypos, zpos, cellWidth, cellHeight, depthStep, textureID, RIGHT);
-                }
+    // Stale levels go back to the pool now rather than when they are next drawn
+    for (int i = 0; i < refreshed; i++) {
+        for (int lod = 0; lod <= MESH_MAX_LOD; lod++) releaseChunkLevel(&chunkBuffers[dirtyChunks[i]].levels[lod]);
+    }
 
-                if (!topNeighborExists) {
-                    renderFace(xpos, ypos + cellHeight, zpos, cellWidth, cellHeight, depthStep, textureID, TOP);
-                }
+    return refreshed;
+}
 
-                if (!bottomNeighborExists) {
-                    renderFace(xpos, ypos, zpos, cellWidth, cellHeight, depthStep, textureID, BOTTOM);
-                }
-            }
+// Draw the whole map as one RTIN surface, rebuilt only after edits, material
+// changes or a new error limit
+static void renderSmoothTerrain(Terrain* terrain, const float viewProjection[16]) {
+    if (!terrainRtin) {
+        terrainRtin = createTerrainRtin(terrain, RTIN_DEFAULT_TILE_SIZE);
+        if (!terrainRtin) return;
+        smoothMeshDirty = true;
+    }
+
+    if (smoothMeshDirty) {
+        RtinStats stats;
+        if (!buildTerrainMeshRtin(terrainRtin, terrain, smoothMaxError, &smoothMesh, &stats)) return;
+        uploadMesh(&smoothBuffers, &smoothMesh);
+        smoothMeshDirty = false;
+
+        // Edits rebuild every frame while sculpting; report only a new error limit
+        if (smoothMaxError != smoothLoggedError) {
+            printf("Smooth terrain rebuilt: %zu triangles at %.2f max error (%zu for the full grid, %.1fx fewer).\n",
+                   stats.triangles, smoothMaxError, stats.gridTriangles,
+                   stats.triangles ? (double)stats.gridTriangles / stats.triangles : 0.0);
+            smoothLoggedError = smoothMaxError;
         }
     }
+
+    glUseProgram(terrainProgram);
+    glUniformMatrix4fv(terrainViewProjectionLocation, 1, GL_FALSE, viewProjection);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, materialTextures);
+    if (smoothBuffers.indexCount > 0) {
+        glBindVertexArray(smoothBuffers.vao);
+        glDrawElements(GL_TRIANGLES, smoothBuffers.indexCount, GL_UNSIGNED_INT, NULL);
+        glBindVertexArray(0);
+    }
+    glUseProgram(0);
+}
+
+// Height and material textures for the whole map plus the shared chunk grid.
+// Returns 0 on failure, leaving nothing allocated.
+static int createDisplacedTerrain(const Terrain* terrain) {
+    const int size = chunkGrid->chunkSize;
+    const int side = size + 1;
+    size_t vertexCount = (size_t)side * side;
+    size_t indexCount = (size_t)size * size * 6;
+    unsigned short* vertices = (unsigned short*)malloc(vertexCount * 2 * sizeof(unsigned short));
+    unsigned short* indices = (unsigned short*)malloc(indexCount * sizeof(unsigned short));
+    unsigned char* ones = terrain->materials ? NULL : (unsigned char*)malloc((size_t)terrain->width * terrain->depth);
+    instanceColumns = (int*)malloc((size_t)chunkGrid->count * 2 * sizeof(int));
+    if (!vertices || !indices || (!terrain->materials && !ones) || !instanceColumns || vertexCount > 65536) {
+        fprintf(stderr, "Failed to allocate the displaced terrain grid.\n");
+        free(vertices);
+        free(indices);
+        free(ones);
+        free(instanceColumns);
+        instanceColumns = NULL;
+        return 0;
+    }
+
+    // Same winding as the voxel top faces, so the surface faces up
+    size_t v = 0, n = 0;
+    for (int z = 0; z < side; z++) {
+        for (int x = 0; x < side; x++) {
+            vertices[v++] = (unsigned short)x;
+            vertices[v++] = (unsigned short)z;
+        }
+    }
+    for (int z = 0; z < size; z++) {
+        for (int x = 0; x < size; x++) {
+            unsigned short corner = (unsigned short)(z * side + x);
+            indices[n++] = corner;
+            indices[n++] = (unsigned short)(corner + side);
+            indices[n++] = (unsigned short)(corner + 1);
+            indices[n++] = (unsigned short)(corner + 1);
+            indices[n++] = (unsigned short)(corner + side);
+            indices[n++] = (unsigned short)(corner + side + 1);
+        }
+    }
+    gridIndexCount = (GLsizei)indexCount;
+
+    glGenVertexArrays(1, &gridVao);
+    glGenBuffers(1, &gridVbo);
+    glGenBuffers(1, &gridIbo);
+    glGenBuffers(1, &instanceVbo);
+    glBindVertexArray(gridVao);
+    glBindBuffer(GL_ARRAY_BUFFER, gridVbo);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * 2 * sizeof(unsigned short), vertices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribIPointer(0, 2, GL_UNSIGNED_SHORT, 2 * sizeof(unsigned short), (void*)0);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+    glBufferData(GL_ARRAY_BUFFER, (size_t)chunkGrid->count * 2 * sizeof(int), NULL, GL_STREAM_DRAW);
+    glEnableVertexAttribArray(1);
+    glVertexAttribIPointer(1, 2, GL_INT, 2 * sizeof(int), (void*)0);
+    glVertexAttribDivisor(1, 1);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gridIbo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned short), indices, GL_STATIC_DRAW);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    free(vertices);
+    free(indices);
+
+    // Integer and float textures are only complete without filtering
+    glGenTextures(1, &heightmapTexture);
+    glBindTexture(GL_TEXTURE_2D, heightmapTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, terrain->width, terrain->depth, 0, GL_RED, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    // Without a material plane every column shades by height, as layer 1 does
+    if (ones) memset(ones, 1, (size_t)terrain->width * terrain->depth);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glGenTextures(1, &materialMapTexture);
+    glBindTexture(GL_TEXTURE_2D, materialMapTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, terrain->width, terrain->depth, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, ones);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    free(ones);
+
+    displacedDirty = true;
+    printf("Displaced terrain: %.1f MB of height and material textures, %zu KB of shared grid.\n",
+           (double)terrain->width * terrain->depth * (sizeof(float) + 1) / (1024.0 * 1024.0),
+           (vertexCount * 2 * sizeof(unsigned short) + indexCount * sizeof(unsigned short)) / 1024);
+    return 1;
+}
+
+// Draw every chunk in the view frustum as an instance of one grid displaced by the
+// heightmap texture. Edits only touch the texels they change; chunk bounds still
+// refresh so culling follows the surface. Occlusion culling is skipped because the
+// occluder boxes assume voxel columns, which the smooth surface can dip below.
+static void renderDisplacedTerrain(Terrain* terrain, const float viewProjection[16]) {
+    if (refreshChunkGrid(terrain) < 0) return;
+    if (!heightmapTexture && !createDisplacedTerrain(terrain)) return;
+    if (displacedDirty) {
+        uploadHeightmapRect(terrain, 0, 0, terrain->width, terrain->depth);
+        displacedDirty = false;
+    }
+
+    float planes[6][4];
+    extractFrustumPlanes(viewProjection, planes);
+    chunkCullAndSort(chunkGrid, planes, cameraEye, &cullStats);
+    int count = chunkGrid->visibleCount;
+    for (int i = 0; i < count; i++) {
+        int chunk = chunkGrid->order[i];
+        instanceColumns[2 * i] = (chunk % chunkGrid->chunksX) * chunkGrid->chunkSize;
+        instanceColumns[2 * i + 1] = (chunk / chunkGrid->chunksX) * chunkGrid->chunkSize;
+    }
+    if (count == 0) return;
+
+    // Orphan last frame's instances rather than waiting on them
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+    glBufferData(GL_ARRAY_BUFFER, (size_t)chunkGrid->count * 2 * sizeof(int), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, (size_t)count * 2 * sizeof(int), instanceColumns);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glUseProgram(displacedProgram);
+    glUniformMatrix4fv(displacedViewProjectionLocation, 1, GL_FALSE, viewProjection);
+    glUniform2f(displacedTerrainOriginLocation, TERRAIN_ORIGIN_X(terrain), TERRAIN_ORIGIN_Z(terrain));
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, materialTextures);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, heightmapTexture);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, materialMapTexture);
+    glBindVertexArray(gridVao);
+    glDrawElementsInstanced(GL_TRIANGLES, gridIndexCount, GL_UNSIGNED_SHORT, NULL, count);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glUseProgram(0);
+}
+
+// Refresh dirty chunks, cull the chunk boxes against the view frustum and the
+// occlusion buffer, and draw the visible chunks front to back at their selected
+// level of detail with one texture binding
+void renderTerrain(Terrain* terrain) {
+    if (!terrain || !terrain->heights) return;  // Ensure valid data exists before rendering
+
+    float viewProjection[16];
+    matrixMultiply(projectionMatrix, viewMatrix, viewProjection);
+    if (smoothMaxError >= 0.0f) {
+        renderSmoothTerrain(terrain, viewProjection);
+        return;
+    }
+    if (displacedMode) {
+        renderDisplacedTerrain(terrain, viewProjection);
+        return;
+    }
+
+    int refreshed = refreshChunkGrid(terrain);
+    if (refreshed < 0) return;
+
+    // Frustum of the camera
+    float planes[6][4];
+    extractFrustumPlanes(viewProjection, planes);
+    chunkCullAndSort(chunkGrid, planes, cameraEye, &cullStats);
+
+    // Then drop chunks hidden behind nearer terrain
+    if (!occlusionBuffer) occlusionBuffer = createOcclusionBuffer(OCCLUSION_RESOLUTION, OCCLUSION_RESOLUTION);
+    occlusionCullChunks(occlusionBuffer, chunkGrid, viewProjection, &cullStats);
+
+    // Build any level the survivors need that is not current yet
+    selectChunkLods();
+    MeshStats totals = { 0, 0 };
+    buildVisibleLevels(terrain, &totals);
+    maintainVertexPool();
+    if (refreshed == chunkGrid->count) {
+        printf("Terrain mesh rebuilt: %zu quads for %d visible chunks (%zu before greedy merging, %.2fx fewer).\n",
+               totals.greedyQuads, chunkGrid->visibleCount, totals.columnQuads,
+               totals.greedyQuads ? (double)totals.columnQuads / totals.greedyQuads : 0.0);
+        SuballocStats pool;
+        renderGetChunkMemoryStats(&pool);
+        printf("Chunk vertex pool: %.1f of %.1f MB in %d ranges, %d free ranges (%.0f%% fragmented), %d grows, %d compactions.\n",
+               pool.used * sizeof(PackedVertex) / (1024.0 * 1024.0), pool.capacity * sizeof(PackedVertex) / (1024.0 * 1024.0),
+               pool.allocations, pool.freeRanges, pool.fragmentation * 100.0f, pool.grows, pool.compactions);
+    }
+
+    // Materials come from the vertex data and every level lives in the pool, so
+    // chunks share one texture and vertex array binding; only the origin and base
+    // vertex change between draws
+    glUseProgram(voxelProgram);
+    glUniformMatrix4fv(voxelViewProjectionLocation, 1, GL_FALSE, viewProjection);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, materialTextures);
+    glBindVertexArray(vertexPoolVao);
+    for (int i = 0; i < chunkGrid->visibleCount; i++) {
+        int chunk = chunkGrid->order[i];
+        const ChunkBuffers* buffers = &chunkBuffers[chunk];
+        const ChunkLevel* level = &buffers->levels[buffers->lod];
+        if (level->indexCount == 0) continue;
+        float originX = TERRAIN_ORIGIN_X(terrain) + (chunk % chunkGrid->chunksX) * chunkGrid->chunkSize * VOXEL_SIZE;
+        float originZ = TERRAIN_ORIGIN_Z(terrain) + (chunk / chunkGrid->chunksX) * chunkGrid->chunkSize * VOXEL_SIZE;
+        glUniform3f(chunkOriginLocation, originX, 0.0f, originZ);
+        glDrawElementsBaseVertex(GL_TRIANGLES, level->indexCount, GL_UNSIGNED_INT, NULL,
+                                 (GLint)suballocOffset(vertexPool, level->block));
+    }
+    glBindVertexArray(0);
+    glUseProgram(0);
+}
+
+void renderGetCullStats(CullStats* stats) {
+    if (stats) *stats = cullStats;
+}
+
+void renderGetChunkMemoryStats(SuballocStats* stats) {
+    if (!stats) return;
+    if (vertexPool) suballocGetStats(vertexPool, stats);
+    else memset(stats, 0, sizeof(*stats));
 }
 
 // Callback function for mouse movement
@@ -433,10 +1155,7 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
         fov = 90.0f;
 
     // Update the projection matrix with the new fov
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    gluPerspective(fov, (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 1000.0f);
-    glMatrixMode(GL_MODELVIEW);
+    matrixPerspective(fov, (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT, CAMERA_NEAR, CAMERA_FAR, projectionMatrix);
 }
 
 // Function to update the camera's view based on yaw and pitch
@@ -455,14 +1174,65 @@ void updateCameraView() {
     frontY /= length;
     frontZ /= length;
 
-    // Update the view matrix
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-    gluLookAt(
-        frontX * 150.0f, frontY * 150.0f, frontZ * 150.0f,   // Eye position based on front vector
-        0.0f, 0.0f, 0.0f,                                 // Look-at point (center)
-        0.0f, 1.0f, 0.0f                                  // Up vector
-    );
+    // The eye orbits the origin and always looks at it
+    cameraEye[0] = frontX * 150.0f;
+    cameraEye[1] = frontY * 150.0f;
+    cameraEye[2] = frontZ * 150.0f;
+    cameraForward[0] = -frontX;
+    cameraForward[1] = -frontY;
+    cameraForward[2] = -frontZ;
+
+    // Update the view and projection matrices
+    static const float center[3] = { 0.0f, 0.0f, 0.0f };
+    static const float up[3] = { 0.0f, 1.0f, 0.0f };
+    matrixLookAt(cameraEye, center, up, viewMatrix);
+    matrixPerspective(fov, (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT, CAMERA_NEAR, CAMERA_FAR, projectionMatrix);
+}
+
+// Ctrl+Z undoes the last stroke and Ctrl+Y (or Ctrl+Shift+Z) redoes it, once per key press
+static void applyUndoKeys() {
+    static bool undoHeld = false, redoHeld = false;
+    if (!terrainEditor) return;
+
+    bool control = glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS ||
+                   glfwGetKey(window, GLFW_KEY_RIGHT_CONTROL) == GLFW_PRESS;
+    bool shift = glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS ||
+                 glfwGetKey(window, GLFW_KEY_RIGHT_SHIFT) == GLFW_PRESS;
+    bool z = glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS;
+    bool undo = control && z && !shift;
+    bool redo = control && (glfwGetKey(window, GLFW_KEY_Y) == GLFW_PRESS || (z && shift));
+
+    if (undo && !undoHeld) editorUndo(terrainEditor);
+    if (redo && !redoHeld) editorRedo(terrainEditor);
+    undoHeld = undo;
+    redoHeld = redo;
+}
+
+// Sculpt at the point under the screen centre while a mouse button is held:
+// left raises, right lowers, middle smooths
+static void applySculpting(Terrain* terrain, float deltaTime) {
+    if (!terrainEditor || !terrainEditor->pyramid) return;
+
+    Brush brush;
+    brush.radius = SCULPT_RADIUS;
+    brush.strength = SCULPT_RATE * deltaTime;
+    brush.target = 0.0f;
+    if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
+        brush.mode = BRUSH_RAISE;
+    } else if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS) {
+        brush.mode = BRUSH_LOWER;
+    } else if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_MIDDLE) == GLFW_PRESS) {
+        brush.mode = BRUSH_SMOOTH;
+        brush.strength = deltaTime * 4.0f > 1.0f ? 1.0f : deltaTime * 4.0f;
+    } else {
+        editorEndStroke(terrainEditor);
+        return;
+    }
+
+    TerrainHit hit;
+    if (pyramidRaycast(terrainEditor->pyramid, terrain, cameraEye, cameraForward, 1000.0f, &hit)) {
+        editorApplyBrush(terrainEditor, &brush, hit.position[0], hit.position[2]);
+    }
 }
 
 // Function to start the rendering loop
@@ -474,8 +1244,38 @@ void startRenderLoop(Terrain* terrain) {
     // Capture the mouse cursor
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
+    double lastTime = glfwGetTime();
+    double waterTime = 0.0;
+
     // Main rendering loop
     while (!glfwWindowShouldClose(window)) {
+        // Advance the water simulation in fixed steps for the elapsed time
+        double now = glfwGetTime();
+        if (waterSim) {
+            waterTime += now - lastTime;
+            int steps = (int)(waterTime / waterSim->timeStep);
+            if (steps > WATER_MAX_STEPS_PER_FRAME) steps = WATER_MAX_STEPS_PER_FRAME;
+            // Only cells whose water crossed the render depth can change material
+            int changed[4];
+            waterSimulate(waterSim, steps, changed);
+            if (changed[0] < changed[2] &&
+                terrainUpdateMaterials(terrain, waterSim, changed[0], changed[1], changed[2], changed[3]) > 0) {
+                invalidateTerrainRect(terrain, changed[0], changed[1], changed[2], changed[3]);
+            }
+            waterTime -= steps * waterSim->timeStep;
+            if (waterTime > waterSim->timeStep) waterTime = waterSim->timeStep;
+        }
+
+        // Apply this frame's edits and rebuild only what they touched
+        applySculpting(terrain, (float)(now - lastTime));
+        applyUndoKeys();
+        int flushed = editorFlush(terrainEditor);
+        for (int i = 0; i < flushed; i++) {
+            const DirtyRect* rect = &terrainEditor->flushed[i];
+            invalidateTerrainRect(terrain, rect->x0, rect->z0, rect->x1, rect->z1);
+        }
+        lastTime = now;
+
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);  // Clear color and depth buffers
 
         // Update the camera's view based on input
@@ -490,6 +1290,74 @@ void startRenderLoop(Terrain* terrain) {
 
 // Function to clean up graphics resources
 void cleanupGraphics() {
+    if (chunkGrid) {
+        free(chunkBuffers);
+        free(dirtyChunks);
+        chunkBuffers = NULL;
+        dirtyChunks = NULL;
+        destroyChunkGrid(chunkGrid);
+        chunkGrid = NULL;
+    }
+    if (smoothBuffers.vao) {
+        glDeleteVertexArrays(1, &smoothBuffers.vao);
+        glDeleteBuffers(1, &smoothBuffers.vbo);
+        glDeleteBuffers(1, &smoothBuffers.ibo);
+        memset(&smoothBuffers, 0, sizeof(smoothBuffers));
+    }
+    destroyTerrainRtin(terrainRtin);
+    terrainRtin = NULL;
+    freeTerrainMesh(&smoothMesh);
+    for (int i = 0; i < MESH_BUILD_BATCH; i++) freePackedMesh(&builtMeshes[i]);
+    for (int i = 0; i < meshScratchCount; i++) destroyMeshScratch(meshScratch[i]);
+    free(meshScratch);
+    meshScratch = NULL;
+    meshScratchCount = 0;
+    destroyOcclusionBuffer(occlusionBuffer);
+    occlusionBuffer = NULL;
+    if (vertexPool) {
+        glDeleteVertexArrays(1, &vertexPoolVao);
+        glDeleteBuffers(1, &vertexPoolBuffer);
+        vertexPoolVao = vertexPoolBuffer = 0;
+        destroySuballocator(vertexPool);
+        vertexPool = NULL;
+    }
+    if (quadIndexBuffer) {
+        glDeleteBuffers(1, &quadIndexBuffer);
+        quadIndexBuffer = 0;
+        quadIndexQuads = 0;
+    }
+    if (terrainProgram) {
+        glDeleteProgram(terrainProgram);
+        terrainProgram = 0;
+    }
+    if (voxelProgram) {
+        glDeleteProgram(voxelProgram);
+        voxelProgram = 0;
+    }
+    if (displacedProgram) {
+        glDeleteProgram(displacedProgram);
+        displacedProgram = 0;
+    }
+    if (gridVao) {
+        glDeleteVertexArrays(1, &gridVao);
+        glDeleteBuffers(1, &gridVbo);
+        glDeleteBuffers(1, &gridIbo);
+        glDeleteBuffers(1, &instanceVbo);
+        gridVao = gridVbo = gridIbo = instanceVbo = 0;
+        gridIndexCount = 0;
+    }
+    if (heightmapTexture) {
+        glDeleteTextures(1, &heightmapTexture);
+        glDeleteTextures(1, &materialMapTexture);
+        heightmapTexture = materialMapTexture = 0;
+    }
+    free(instanceColumns);
+    instanceColumns = NULL;
+    if (materialTextures) {
+        glDeleteTextures(1, &materialTextures);
+        materialTextures = 0;
+    }
+
     if (window) {
         glfwDestroyWindow(window);
         window = NULL;  // Reset the pointer to avoid dangling references
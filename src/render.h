@@ -4,6 +4,11 @@
 #define RENDER_H
 
 #include "terrain.h"  // Include to recognize Terrain type
+#include "water.h"
+#include "edit.h"
+#include "chunks.h"
+#include "suballoc.h"
+#include <stdbool.h>
 #include <GLFW/glfw3.h>
 
 // Define colors struct
@@ -13,29 +18,22 @@ typedef struct {
     float b;
 } RGB;
 
-// Define face types for clarity
-typedef enum {
-    FRONT,
-    BACK,
-    LEFT,
-    RIGHT,
-    TOP,
-    BOTTOM
-} FaceType;
-
-#define MAX_HEIGHT 50.0f
-
-void setupLighting();
 void initializeGraphics();
 void renderTerrain(Terrain* terrain);
+void renderInvalidateTerrain();   // Rebuild the terrain mesh before the next frame
+void renderGetCullStats(CullStats* stats);  // Chunk counts from the last frame's frustum and occlusion culls
+void renderGetChunkMemoryStats(SuballocStats* stats);  // Usage of the chunk vertex pool, in vertices
+void renderSetLodThreshold(float pixels);   // Screen-space error allowed for distant chunk levels of detail
+void renderSetSmoothTerrain(float maxError); // Draw a smooth RTIN surface within maxError world units; negative for voxels
+void renderSetDisplacedTerrain(bool enabled); // Draw one heightmap-displaced grid per visible chunk instead of voxel meshes
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void updateCamera();
+void updateCameraView();   // Rebuild the view and projection matrices from yaw, pitch and fov
 void startRenderLoop(Terrain* terrain);
+void renderSetWater(WaterSim* water);
+void renderSetEditor(TerrainEditor* editor);
 void cleanupGraphics();
 
-// Declaration of the renderFace function
-void renderFace(float xpos, float ypos, float zpos, float cellWidth, float cellHeight, float depthStep, GLuint textureID, FaceType face);
-
 #endif
 
@@ -0,0 +1,395 @@
+// rtin.c
+#include "rtin.h"
+#include "materials.h"
+#include "normals.h"
+#include "jobs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// Triangle ids follow the bisection tree: 2 and 3 are the two halves of the tile
+// split along its (0, 0)-(size, size) diagonal, and the children of id k are 2k
+// and 2k + 1. A tile has size * size * 2 - 2 triangles below the root halves, of
+// which the last size * size are the unsplittable leaves.
+
+// World height of the vertex at column (x, z); vertices past the map repeat its
+// last row and column
+static inline float vertexHeight(const Terrain* terrain, int x, int z) {
+    if (x >= terrain->width) x = terrain->width - 1;
+    if (z >= terrain->depth) z = terrain->depth - 1;
+    return TERRAIN_HEIGHT(terrain, x, z) * MAX_HEIGHT * VOXEL_SIZE;
+}
+
+static inline float* tileErrors(const TerrainRtin* rtin, int tile) {
+    size_t grid = (size_t)rtin->tileSize + 1;
+    return rtin->errors + (size_t)tile * grid * grid;
+}
+
+// Corners of triangle 'id': (a, b) is the hypotenuse and c the right angle
+static void triangleCorners(int id, int size, int corners[6]) {
+    int ax = 0, az = 0, bx = 0, bz = 0, cx = 0, cz = 0;
+    if (id & 1) {
+        bx = bz = cx = size;
+    } else {
+        ax = az = cz = size;
+    }
+    while ((id >>= 1) > 1) {
+        int mx = (ax + bx) >> 1;
+        int mz = (az + bz) >> 1;
+        if (id & 1) {
+            bx = ax;
+            bz = az;
+            ax = cx;
+            az = cz;
+        } else {
+            ax = bx;
+            az = bz;
+            bx = cx;
+            bz = cz;
+        }
+        cx = mx;
+        cz = mz;
+    }
+    corners[0] = ax;
+    corners[1] = az;
+    corners[2] = bx;
+    corners[3] = bz;
+    corners[4] = cx;
+    corners[5] = cz;
+}
+
+// Finest triangles first: each hypotenuse midpoint takes the interpolation error
+// there (when 'heights' is set) and the errors of its two children's midpoints
+static void computeTile(TerrainRtin* rtin, const Terrain* terrain, int tile, int heights) {
+    int size = rtin->tileSize;
+    int grid = size + 1;
+    int ox = (tile % rtin->tilesX) * size;
+    int oz = (tile / rtin->tilesX) * size;
+    float* errors = tileErrors(rtin, tile);
+    int count = size * size * 2 - 2;
+    int parents = count - size * size;
+
+    if (heights) memset(errors, 0, (size_t)grid * grid * sizeof(float));
+    for (int i = count - 1; i >= 0; i--) {
+        int c[6];
+        triangleCorners(i + 2, size, c);
+        int mx = (c[0] + c[2]) >> 1;
+        int mz = (c[1] + c[3]) >> 1;
+        float* middle = &errors[mz * grid + mx];
+
+        if (heights) {
+            float interpolated = 0.5f * (vertexHeight(terrain, ox + c[0], oz + c[1]) + vertexHeight(terrain, ox + c[2], oz + c[3]));
+            float error = fabsf(interpolated - vertexHeight(terrain, ox + mx, oz + mz));
+            if (error > *middle) *middle = error;
+        }
+        if (i < parents) {
+            float left = errors[((c[1] + c[5]) >> 1) * grid + ((c[0] + c[4]) >> 1)];
+            float right = errors[((c[3] + c[5]) >> 1) * grid + ((c[2] + c[4]) >> 1)];
+            if (left > *middle) *middle = left;
+            if (right > *middle) *middle = right;
+        }
+    }
+}
+
+typedef struct {
+    TerrainRtin* rtin;
+    const Terrain* terrain;
+    unsigned char* pending;     // Tiles to process in this pass
+    int heights;
+} RtinPass;
+
+static void tileJob(void* context, int tile, int worker) {
+    (void)worker;
+    RtinPass* pass = (RtinPass*)context;
+    if (!pass->pending[tile]) return;
+    computeTile(pass->rtin, pass->terrain, tile, pass->heights);
+    pass->pending[tile] = 0;
+}
+
+// Raise both copies of every shared edge vertex to the larger error and flag the
+// tiles that changed, since their ancestors must be propagated again
+static int stitchEdges(TerrainRtin* rtin, unsigned char* pending) {
+    int size = rtin->tileSize;
+    int grid = size + 1;
+    int changed = 0;
+
+    for (int tz = 0; tz < rtin->tilesZ; tz++) {
+        for (int tx = 0; tx < rtin->tilesX; tx++) {
+            int tile = tz * rtin->tilesX + tx;
+            float* errors = tileErrors(rtin, tile);
+            for (int side = 0; side < 2; side++) {
+                int neighbour = side == 0 ? tile + 1 : tile + rtin->tilesX;
+                if (side == 0 ? tx + 1 >= rtin->tilesX : tz + 1 >= rtin->tilesZ) continue;
+                float* other = tileErrors(rtin, neighbour);
+
+                // Right column against the neighbour's left, or bottom row against its top
+                for (int k = 0; k <= size; k++) {
+                    float* a = side == 0 ? &errors[k * grid + size] : &errors[size * grid + k];
+                    float* b = side == 0 ? &other[k * grid] : &other[k];
+                    if (*a == *b) continue;
+                    if (*a > *b) {
+                        *b = *a;
+                        pending[neighbour] = 1;
+                    } else {
+                        *a = *b;
+                        pending[tile] = 1;
+                    }
+                    changed = 1;
+                }
+            }
+        }
+    }
+    return changed;
+}
+
+// Compute the flagged tiles from the heights, then alternate stitching and
+// propagation until shared edges agree. Errors only grow, so this converges.
+static void computeTiles(TerrainRtin* rtin, const Terrain* terrain, unsigned char* pending) {
+    int tiles = rtin->tilesX * rtin->tilesZ;
+    RtinPass pass = { rtin, terrain, pending, 1 };
+    jobsParallelFor(tiles, tileJob, &pass);
+
+    pass.heights = 0;
+    while (stitchEdges(rtin, pending)) {
+        jobsParallelFor(tiles, tileJob, &pass);
+    }
+}
+
+TerrainRtin* createTerrainRtin(const Terrain* terrain, int tileSize) {
+    if (!terrain || !terrain->heights || terrain->width < 2 || terrain->depth < 2) return NULL;
+
+    // Power of two no larger than needed to cover the map with one tile
+    int size = 2;
+    while (size * 2 <= tileSize) size *= 2;
+    int span = terrain->width > terrain->depth ? terrain->width - 1 : terrain->depth - 1;
+    while (size > 2 && size / 2 >= span) size /= 2;
+
+    TerrainRtin* rtin = (TerrainRtin*)calloc(1, sizeof(TerrainRtin));
+    if (!rtin) return NULL;
+    rtin->tileSize = size;
+    rtin->tilesX = (terrain->width - 1 + size - 1) / size;
+    rtin->tilesZ = (terrain->depth - 1 + size - 1) / size;
+
+    size_t grid = (size_t)size + 1;
+    int tiles = rtin->tilesX * rtin->tilesZ;
+    rtin->errors = (float*)malloc((size_t)tiles * grid * grid * sizeof(float));
+    unsigned char* pending = (unsigned char*)malloc((size_t)tiles);
+    if (!rtin->errors || !pending) {
+        fprintf(stderr, "Failed to allocate RTIN error hierarchy.\n");
+        free(pending);
+        destroyTerrainRtin(rtin);
+        return NULL;
+    }
+
+    memset(pending, 1, (size_t)tiles);
+    computeTiles(rtin, terrain, pending);
+    free(pending);
+    return rtin;
+}
+
+void destroyTerrainRtin(TerrainRtin* rtin) {
+    if (!rtin) return;
+    free(rtin->errors);
+    free(rtin);
+}
+
+// Shared edges keep the larger of two errors, so values left over from earlier
+// heights next to the rectangle can only over-refine until the hierarchy is rebuilt
+void rtinUpdateRect(TerrainRtin* rtin, const Terrain* terrain, int x0, int z0, int x1, int z1) {
+    if (!rtin || !terrain || !terrain->heights) return;
+
+    if (x0 < 0) x0 = 0;
+    if (z0 < 0) z0 = 0;
+    if (x1 > terrain->width) x1 = terrain->width;
+    if (z1 > terrain->depth) z1 = terrain->depth;
+    if (x0 >= x1 || z0 >= z1) return;
+
+    int tiles = rtin->tilesX * rtin->tilesZ;
+    unsigned char* pending = (unsigned char*)calloc((size_t)tiles, 1);
+    if (!pending) return;
+
+    // Vertices on a tile edge belong to both tiles
+    int size = rtin->tileSize;
+    int tx0 = x0 > 0 ? (x0 - 1) / size : 0, tz0 = z0 > 0 ? (z0 - 1) / size : 0;
+    int tx1 = (x1 - 1) / size, tz1 = (z1 - 1) / size;
+    if (tx1 >= rtin->tilesX) tx1 = rtin->tilesX - 1;
+    if (tz1 >= rtin->tilesZ) tz1 = rtin->tilesZ - 1;
+    for (int tz = tz0; tz <= tz1; tz++) {
+        for (int tx = tx0; tx <= tx1; tx++) {
+            pending[tz * rtin->tilesX + tx] = 1;
+        }
+    }
+
+    computeTiles(rtin, terrain, pending);
+    free(pending);
+}
+
+// Extraction -------------------------------------------------------------
+
+typedef struct {
+    const Terrain* terrain;
+    const float* errors;
+    int grid;
+    int ox, oz;
+    int stamp;                  // Current tile + 1; vertexIndex is valid where vertexStamp matches
+    float maxError;
+    TerrainMesh* mesh;
+    unsigned int* vertexIndex;
+    int* vertexStamp;
+    unsigned int* triangles;    // Three vertex indices per triangle, before grouping by material
+    size_t triangleCount;
+    size_t triangleCapacity;
+    int failed;
+} RtinBuild;
+
+static int growBuffer(void** buffer, size_t* capacity, size_t needed, size_t element) {
+    if (needed <= *capacity) return 1;
+    size_t grown = *capacity ? *capacity * 2 : 4096;
+    while (grown < needed) grown *= 2;
+    void* resized = realloc(*buffer, grown * element);
+    if (!resized) return 0;
+    *buffer = resized;
+    *capacity = grown;
+    return 1;
+}
+
+static float sampleHeight(const Terrain* terrain, int x, int z) {
+    if (x < 0) x = 0;
+    if (z < 0) z = 0;
+    return vertexHeight(terrain, x, z);
+}
+
+// Index of the mesh vertex at tile vertex (x, z), adding it on first use
+static unsigned int tileVertex(RtinBuild* build, int x, int z) {
+    size_t cell = (size_t)z * build->grid + x;
+    if (build->vertexStamp[cell] == build->stamp) return build->vertexIndex[cell];
+
+    TerrainMesh* mesh = build->mesh;
+    if (!growBuffer((void**)&mesh->vertices, &mesh->vertexCapacity, mesh->vertexCount + 1, sizeof(MeshVertex))) {
+        build->failed = 1;
+        return 0;
+    }
+
+    const Terrain* terrain = build->terrain;
+    int cx = build->ox + x < terrain->width ? build->ox + x : terrain->width - 1;
+    int cz = build->oz + z < terrain->depth ? build->oz + z : terrain->depth - 1;
+
+    MeshVertex* vertex = &mesh->vertices[mesh->vertexCount];
+    vertex->position[0] = TERRAIN_ORIGIN_X(terrain) + (cx + 0.5f) * VOXEL_SIZE;
+    vertex->position[1] = vertexHeight(terrain, cx, cz);
+    vertex->position[2] = TERRAIN_ORIGIN_Z(terrain) + (cz + 0.5f) * VOXEL_SIZE;
+    if (terrain->normals) {
+        // Shared with the other meshers and kept current by the editor
+        unpackNormal(TERRAIN_NORMAL(terrain, cx, cz), vertex->normal);
+    } else {
+        float dx = sampleHeight(terrain, cx + 1, cz) - sampleHeight(terrain, cx - 1, cz);
+        float dz = sampleHeight(terrain, cx, cz + 1) - sampleHeight(terrain, cx, cz - 1);
+        float nx = -dx, ny = 2.0f * VOXEL_SIZE, nz = -dz;
+        float length = sqrtf(nx * nx + ny * ny + nz * nz);
+        vertex->normal[0] = nx / length;
+        vertex->normal[1] = ny / length;
+        vertex->normal[2] = nz / length;
+    }
+    vertex->uv[0] = (float)cx;
+    vertex->uv[1] = (float)cz;
+    vertex->material = terrain->materials ? TERRAIN_MATERIAL(terrain, cx, cz)
+                                          : chooseMaterial(TERRAIN_HEIGHT(terrain, cx, cz), -1.0f, 0.0f);
+
+    build->vertexStamp[cell] = build->stamp;
+    build->vertexIndex[cell] = (unsigned int)mesh->vertexCount;
+    return (unsigned int)mesh->vertexCount++;
+}
+
+// Split while the hypotenuse midpoint's error exceeds the limit, else emit. Parent
+// midpoints carry their children's errors, so every split a neighbour needs is
+// reached from here.
+static void extractTriangle(RtinBuild* build, int ax, int az, int bx, int bz, int cx, int cz) {
+    int mx = (ax + bx) >> 1;
+    int mz = (az + bz) >> 1;
+    if (abs(ax - cx) + abs(az - cz) > 1 && build->errors[mz * build->grid + mx] > build->maxError) {
+        extractTriangle(build, cx, cz, ax, az, mx, mz);
+        extractTriangle(build, bx, bz, cx, cz, mx, mz);
+        return;
+    }
+
+    // Triangles past the map's last row or column collapse onto it; skip them
+    const Terrain* terrain = build->terrain;
+    int lastX = terrain->width - 1 - build->ox, lastZ = terrain->depth - 1 - build->oz;
+    int px[3] = { ax < lastX ? ax : lastX, bx < lastX ? bx : lastX, cx < lastX ? cx : lastX };
+    int pz[3] = { az < lastZ ? az : lastZ, bz < lastZ ? bz : lastZ, cz < lastZ ? cz : lastZ };
+    if ((px[1] - px[0]) * (pz[2] - pz[0]) == (pz[1] - pz[0]) * (px[2] - px[0])) return;
+
+    if (!growBuffer((void**)&build->triangles, &build->triangleCapacity, (build->triangleCount + 1) * 3, sizeof(unsigned int))) {
+        build->failed = 1;
+        return;
+    }
+    unsigned int* triangle = build->triangles + build->triangleCount * 3;
+    triangle[0] = tileVertex(build, ax, az);
+    triangle[1] = tileVertex(build, bx, bz);
+    triangle[2] = tileVertex(build, cx, cz);
+    build->triangleCount++;
+}
+
+int buildTerrainMeshRtin(const TerrainRtin* rtin, const Terrain* terrain, float maxError, TerrainMesh* mesh, RtinStats* stats) {
+    if (!rtin || !terrain || !terrain->heights || !mesh) return 0;
+
+    int size = rtin->tileSize;
+    size_t cells = (size_t)(size + 1) * (size + 1);
+    RtinBuild build;
+    memset(&build, 0, sizeof(build));
+    build.terrain = terrain;
+    build.grid = size + 1;
+    build.maxError = maxError;
+    build.mesh = mesh;
+    build.vertexIndex = (unsigned int*)malloc(cells * sizeof(unsigned int));
+    build.vertexStamp = (int*)calloc(cells, sizeof(int));
+    mesh->vertexCount = 0;
+    mesh->indexCount = 0;
+    memset(mesh->ranges, 0, sizeof(mesh->ranges));
+
+    for (int tile = 0; tile < rtin->tilesX * rtin->tilesZ && build.vertexIndex && build.vertexStamp && !build.failed; tile++) {
+        build.errors = tileErrors(rtin, tile);
+        build.ox = (tile % rtin->tilesX) * size;
+        build.oz = (tile / rtin->tilesX) * size;
+        build.stamp = tile + 1;
+        extractTriangle(&build, 0, 0, size, size, size, 0);
+        extractTriangle(&build, size, size, 0, 0, 0, size);
+    }
+
+    // Group triangles by the material of their last (provoking) vertex
+    size_t cursor[MATERIAL_COUNT] = { 0 };
+    int ok = build.vertexIndex && build.vertexStamp && !build.failed && mesh->vertexCount <= 0xFFFFFFFFu &&
+             growBuffer((void**)&mesh->indices, &mesh->indexCapacity, build.triangleCount * 3, sizeof(unsigned int));
+    if (ok) {
+        for (size_t i = 0; i < build.triangleCount; i++) {
+            mesh->ranges[mesh->vertices[build.triangles[i * 3 + 2]].material].indexCount += 3;
+        }
+        size_t first = 0;
+        for (int m = 0; m < MATERIAL_COUNT; m++) {
+            mesh->ranges[m].firstIndex = first;
+            cursor[m] = first;
+            first += mesh->ranges[m].indexCount;
+        }
+        for (size_t i = 0; i < build.triangleCount; i++) {
+            const unsigned int* triangle = build.triangles + i * 3;
+            memcpy(mesh->indices + cursor[mesh->vertices[triangle[2]].material], triangle, 3 * sizeof(unsigned int));
+            cursor[mesh->vertices[triangle[2]].material] += 3;
+        }
+        mesh->indexCount = build.triangleCount * 3;
+    } else {
+        fprintf(stderr, "Failed to allocate RTIN mesh (%zu triangles).\n", build.triangleCount);
+        mesh->vertexCount = 0;
+        memset(mesh->ranges, 0, sizeof(mesh->ranges));
+    }
+
+    if (stats) {
+        stats->vertices = mesh->vertexCount;
+        stats->triangles = mesh->indexCount / 3;
+        stats->gridTriangles = (size_t)(terrain->width - 1) * (terrain->depth - 1) * 2;
+    }
+    free(build.triangles);
+    free(build.vertexIndex);
+    free(build.vertexStamp);
+    return ok;
+}
@@ -0,0 +1,49 @@
+// rtin.h
+#ifndef RTIN_H
+#define RTIN_H
+
+#include "terrain.h"
+#include "mesh.h"
+
+#define RTIN_DEFAULT_TILE_SIZE 256  // Cells per tile side; must be a power of two
+
+// Right-triangulated irregular network over Terrain.heights, for smooth renders
+// that do not need voxel columns. The vertex grid (one vertex per column) is split
+// into tiles of tileSize x tileSize cells whose (tileSize + 1)^2 vertices overlap
+// their neighbours' along shared edges. Every vertex that is the hypotenuse
+// midpoint of a triangle in the longest-edge bisection hierarchy stores the
+// largest height error (world units) left by not splitting there, including every
+// split beneath it, so a mesh for any maximum error is one top-down pass over the
+// triangles it emits. Errors on shared edges are kept equal, so tiles meet without
+// cracks.
+typedef struct {
+    int tileSize;
+    int tilesX, tilesZ;
+    float* errors;   // tilesX * tilesZ blocks of (tileSize + 1)^2 errors, row-major per tile
+} TerrainRtin;
+
+// Triangle counts of the last extraction against a full-resolution grid mesh
+typedef struct {
+    size_t vertices;
+    size_t triangles;
+    size_t gridTriangles;
+} RtinStats;
+
+// Build the error hierarchy. tileSize is rounded down to a power of two and shrunk
+// to fit small maps.
+TerrainRtin* createTerrainRtin(const Terrain* terrain, int tileSize);
+void destroyTerrainRtin(TerrainRtin* rtin);
+
+// Recompute the tiles whose vertices lie in [x0, x1) x [z0, z1) after an edit
+void rtinUpdateRect(TerrainRtin* rtin, const Terrain* terrain, int x0, int z0, int x1, int z1);
+
+// Smooth surface split wherever a hypotenuse midpoint is more than maxError world
+// units from the heightmap. Errors are only measured at midpoints, so columns
+// inside a triangle can deviate somewhat further (under twice maxError on
+// generated maps). Vertices sit at column centres at height * MAX_HEIGHT *
+// VOXEL_SIZE and triangles are grouped by the material of their last vertex.
+// Buffers in 'mesh' are reused across rebuilds; 'stats' is optional. Returns 0 on
+// allocation failure.
+int buildTerrainMeshRtin(const TerrainRtin* rtin, const Terrain* terrain, float maxError, TerrainMesh* mesh, RtinStats* stats);
+
+#endif // RTIN_H
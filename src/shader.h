@@ -0,0 +1,11 @@
+// shader.h
+#ifndef SHADER_H
+#define SHADER_H
+
+#include <GL/glew.h>
+
+// Compile and link a program from GLSL sources. Prints the info log and returns 0
+// on failure.
+GLuint createShaderProgram(const char* vertexSource, const char* fragmentSource);
+
+#endif // SHADER_H
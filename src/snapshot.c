@@ -0,0 +1,451 @@
+// snapshot.c
+#include "snapshot.h"
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define READER_IDLE ULONG_MAX
+
+static TerrainSnapshot* allocateSnapshot(int width, int depth) {
+    int tilesX = (width + SNAPSHOT_TILE_EDGE - 1) >> SNAPSHOT_TILE_SHIFT;
+    int tilesZ = (depth + SNAPSHOT_TILE_EDGE - 1) >> SNAPSHOT_TILE_SHIFT;
+
+    // Header and tile table share one allocation
+    size_t bytes = sizeof(TerrainSnapshot) + (size_t)tilesX * tilesZ * sizeof(HeightTile*);
+    TerrainSnapshot* snapshot = (TerrainSnapshot*)calloc(1, bytes);
+    if (!snapshot) return NULL;
+
+    snapshot->width = width;
+    snapshot->depth = depth;
+    snapshot->tilesX = tilesX;
+    snapshot->tilesZ = tilesZ;
+    snapshot->tiles = (HeightTile**)(snapshot + 1);
+    return snapshot;
+}
+
+static void releaseTile(HeightTile* tile) {
+    if (tile && --tile->references == 0) {
+        free(tile);
+    }
+}
+
+static void freeSnapshot(TerrainSnapshot* snapshot) {
+    int tiles = snapshot->tilesX * snapshot->tilesZ;
+    for (int i = 0; i < tiles; i++) {
+        releaseTile(snapshot->tiles[i]);
+    }
+    free(snapshot);
+}
+
+static void freeUndoStep(UndoStep* step) {
+    for (int i = 0; i < step->count; i++) {
+        releaseTile(step->before[i]);
+        releaseTile(step->after[i]);
+    }
+    free(step->indices);
+    free(step->before);
+    free(step->after);
+    memset(step, 0, sizeof(UndoStep));
+}
+
+TerrainStore* createTerrainStore(const Terrain* terrain) {
+    if (!terrain || !terrain->heights) return NULL;
+
+    TerrainStore* store = (TerrainStore*)calloc(1, sizeof(TerrainStore));
+    TerrainSnapshot* snapshot = allocateSnapshot(terrain->width, terrain->depth);
+    if (!store || !snapshot) {
+        free(store);
+        free(snapshot);
+        return NULL;
+    }
+
+    // Split the heightmap into tiles; cells past the map edge repeat the edge value
+    for (int tz = 0; tz < snapshot->tilesZ; tz++) {
+        for (int tx = 0; tx < snapshot->tilesX; tx++) {
+            HeightTile* tile = (HeightTile*)malloc(sizeof(HeightTile));
+            if (!tile) {
+                fprintf(stderr, "Failed to allocate terrain snapshot tile.\n");
+                freeSnapshot(snapshot);
+                free(store);
+                return NULL;
+            }
+            tile->references = 1;
+            for (int lz = 0; lz < SNAPSHOT_TILE_EDGE; lz++) {
+                int z = (tz << SNAPSHOT_TILE_SHIFT) + lz;
+                if (z >= terrain->depth) z = terrain->depth - 1;
+                const float* row = TERRAIN_ROW(terrain, z);
+                for (int lx = 0; lx < SNAPSHOT_TILE_EDGE; lx++) {
+                    int x = (tx << SNAPSHOT_TILE_SHIFT) + lx;
+                    if (x >= terrain->width) x = terrain->width - 1;
+                    tile->heights[lz * SNAPSHOT_TILE_EDGE + lx] = row[x];
+                }
+            }
+            snapshot->tiles[tz * snapshot->tilesX + tx] = tile;
+        }
+    }
+
+    snapshot->references = 1;
+    atomic_init(&store->current, snapshot);
+    atomic_init(&store->epoch, 1);
+    atomic_init(&store->readerCount, 0);
+    for (int i = 0; i < SNAPSHOT_MAX_READERS; i++) {
+        atomic_init(&store->readerEpochs[i], READER_IDLE);
+    }
+    pthread_mutex_init(&store->writerLock, NULL);
+    return store;
+}
+
+void destroyTerrainStore(TerrainStore* store) {
+    if (!store) return;
+
+    // No readers may be active at this point
+    for (int i = 0; i < store->undoCount; i++) freeUndoStep(&store->undo[i]);
+    for (int i = 0; i < store->redoCount; i++) freeUndoStep(&store->redo[i]);
+    while (store->retired) {
+        TerrainSnapshot* next = store->retired->retiredNext;
+        freeSnapshot(store->retired);
+        store->retired = next;
+    }
+    freeSnapshot(atomic_load(&store->current));
+    pthread_mutex_destroy(&store->writerLock);
+    free(store);
+}
+
+int storeRegisterReader(TerrainStore* store) {
+    if (!store) return -1;
+    int reader = atomic_fetch_add(&store->readerCount, 1);
+    if (reader >= SNAPSHOT_MAX_READERS) {
+        fprintf(stderr, "Too many terrain snapshot readers (max %d).\n", SNAPSHOT_MAX_READERS);
+        return -1;
+    }
+    return reader;
+}
+
+const TerrainSnapshot* storePin(TerrainStore* store, int reader) {
+    // Announce the epoch before loading the pointer: a writer that retires the
+    // snapshot afterwards sees this slot and keeps the snapshot alive
+    atomic_store(&store->readerEpochs[reader], atomic_load(&store->epoch));
+    atomic_thread_fence(memory_order_seq_cst);
+    return atomic_load(&store->current);
+}
+
+void storeUnpin(TerrainStore* store, int reader) {
+    atomic_store_explicit(&store->readerEpochs[reader], READER_IDLE, memory_order_release);
+}
+
+void snapshotCopyToTerrain(const TerrainSnapshot* snapshot, Terrain* terrain, int x0, int z0, int x1, int z1) {
+    if (!snapshot || !terrain || snapshot->width != terrain->width || snapshot->depth != terrain->depth) return;
+
+    if (x0 < 0) x0 = 0;
+    if (z0 < 0) z0 = 0;
+    if (x1 > terrain->width) x1 = terrain->width;
+    if (z1 > terrain->depth) z1 = terrain->depth;
+
+    for (int z = z0; z < z1; z++) {
+        float* row = TERRAIN_ROW(terrain, z);
+        const HeightTile* const* tiles = (const HeightTile* const*)snapshot->tiles + (size_t)(z >> SNAPSHOT_TILE_SHIFT) * snapshot->tilesX;
+        int lz = z & (SNAPSHOT_TILE_EDGE - 1);
+
+        // Copy whole tile spans at a time
+        for (int x = x0; x < x1;) {
+            int lx = x & (SNAPSHOT_TILE_EDGE - 1);
+            int span = SNAPSHOT_TILE_EDGE - lx;
+            if (span > x1 - x) span = x1 - x;
+            memcpy(row + x, tiles[x >> SNAPSHOT_TILE_SHIFT]->heights + lz * SNAPSHOT_TILE_EDGE + lx, (size_t)span * sizeof(float));
+            x += span;
+        }
+    }
+
+    if (x0 == 0 || z0 == 0 || x1 == terrain->width || z1 == terrain->depth) terrainFillApron(terrain);
+}
+
+// Writer side ---------------------------------------------------------------
+
+// Drop the store's reference to a snapshot that is no longer current; it is freed
+// once every reader has moved past the epoch in which it was replaced
+static void retireSnapshot(TerrainStore* store, TerrainSnapshot* snapshot, unsigned long epoch) {
+    if (--snapshot->references > 0) return;
+    snapshot->retireEpoch = epoch;
+    snapshot->retiredNext = store->retired;
+    store->retired = snapshot;
+}
+
+// Free retired snapshots no reader can still see. Called with writerLock held, as
+// it unlinks from 'retired' and drops non-atomic tile references.
+static void collectRetired(TerrainStore* store) {
+    // Oldest epoch any reader is still inside
+    unsigned long oldest = READER_IDLE;
+    int readers = atomic_load(&store->readerCount);
+    if (readers > SNAPSHOT_MAX_READERS) readers = SNAPSHOT_MAX_READERS;
+    for (int i = 0; i < readers; i++) {
+        unsigned long pinned = atomic_load(&store->readerEpochs[i]);
+        if (pinned < oldest) oldest = pinned;
+    }
+
+    TerrainSnapshot** link = &store->retired;
+    while (*link) {
+        TerrainSnapshot* snapshot = *link;
+        if (snapshot->retireEpoch < oldest) {
+            *link = snapshot->retiredNext;
+            freeSnapshot(snapshot);
+        } else {
+            link = &snapshot->retiredNext;
+        }
+    }
+}
+
+// Swap in a new snapshot and advance the epoch
+static void publishSnapshot(TerrainStore* store, TerrainSnapshot* snapshot) {
+    TerrainSnapshot* previous = atomic_exchange(&store->current, snapshot);
+    snapshot->version = previous->version + 1;
+    unsigned long epoch = atomic_fetch_add(&store->epoch, 1);
+    retireSnapshot(store, previous, epoch);
+    collectRetired(store);
+}
+
+TerrainTransaction* storeBeginEdit(TerrainStore* store) {
+    if (!store) return NULL;
+    pthread_mutex_lock(&store->writerLock);
+
+    TerrainSnapshot* current = atomic_load(&store->current);
+    int tiles = current->tilesX * current->tilesZ;
+
+    TerrainTransaction* transaction = (TerrainTransaction*)calloc(1, sizeof(TerrainTransaction));
+    if (transaction) {
+        transaction->draft = allocateSnapshot(current->width, current->depth);
+        transaction->cloned = (unsigned char*)calloc((size_t)tiles, 1);
+        transaction->changed = (int*)malloc((size_t)tiles * sizeof(int));
+    }
+    if (!transaction || !transaction->draft || !transaction->cloned || !transaction->changed) {
+        fprintf(stderr, "Failed to begin terrain edit.\n");
+        if (transaction) {
+            free(transaction->draft);
+            free(transaction->cloned);
+            free(transaction->changed);
+            free(transaction);
+        }
+        pthread_mutex_unlock(&store->writerLock);
+        return NULL;
+    }
+
+    // The draft starts out sharing every tile with the current snapshot
+    for (int i = 0; i < tiles; i++) {
+        transaction->draft->tiles[i] = current->tiles[i];
+        current->tiles[i]->references++;
+    }
+    return transaction;
+}
+
+float* transactionWriteTile(TerrainTransaction* transaction, int tileX, int tileZ) {
+    TerrainSnapshot* draft = transaction->draft;
+    int index = tileZ * draft->tilesX + tileX;
+
+    if (!transaction->cloned[index]) {
+        HeightTile* copy = (HeightTile*)malloc(sizeof(HeightTile));
+        if (!copy) {
+            fprintf(stderr, "Failed to clone terrain tile.\n");
+            return NULL;
+        }
+        memcpy(copy->heights, draft->tiles[index]->heights, sizeof(copy->heights));
+        copy->references = 1;
+        releaseTile(draft->tiles[index]);
+        draft->tiles[index] = copy;
+        transaction->cloned[index] = 1;
+        transaction->changed[transaction->changedCount++] = index;
+    }
+    return draft->tiles[index]->heights;
+}
+
+void transactionSetHeight(TerrainTransaction* transaction, int x, int z, float value) {
+    if (!transaction || x < 0 || z < 0 || x >= transaction->draft->width || z >= transaction->draft->depth) return;
+    float* heights = transactionWriteTile(transaction, x >> SNAPSHOT_TILE_SHIFT, z >> SNAPSHOT_TILE_SHIFT);
+    if (heights) {
+        heights[(z & (SNAPSHOT_TILE_EDGE - 1)) * SNAPSHOT_TILE_EDGE + (x & (SNAPSHOT_TILE_EDGE - 1))] = value;
+    }
+}
+
+static void freeTransaction(TerrainTransaction* transaction) {
+    free(transaction->cloned);
+    free(transaction->changed);
+    free(transaction);
+}
+
+static void clearRedo(TerrainStore* store) {
+    for (int i = 0; i < store->redoCount; i++) freeUndoStep(&store->redo[i]);
+    store->redoCount = 0;
+}
+
+static void pushStep(UndoStep* stack, int* count, UndoStep* step) {
+    if (*count == SNAPSHOT_MAX_UNDO) {
+        freeUndoStep(&stack[0]);
+        memmove(stack, stack + 1, (SNAPSHOT_MAX_UNDO - 1) * sizeof(UndoStep));
+        (*count)--;
+    }
+    stack[(*count)++] = *step;
+}
+
+// Fold a transaction's tiles into the newest undo step: tiles it already holds
+// get their 'after' version replaced, others are appended. Returns 0 on failure.
+static int mergeIntoLastStep(TerrainStore* store, const TerrainSnapshot* current, const TerrainTransaction* transaction) {
+    UndoStep* step = &store->undo[store->undoCount - 1];
+    const TerrainSnapshot* draft = transaction->draft;
+
+    int capacity = step->count + transaction->changedCount;
+    int* indices = (int*)realloc(step->indices, (size_t)capacity * sizeof(int));
+    if (indices) step->indices = indices;
+    HeightTile** before = (HeightTile**)realloc(step->before, (size_t)capacity * sizeof(HeightTile*));
+    if (before) step->before = before;
+    HeightTile** after = (HeightTile**)realloc(step->after, (size_t)capacity * sizeof(HeightTile*));
+    if (after) step->after = after;
+    if (!indices || !before || !after) return 0;
+
+    int count = step->count;
+    for (int i = 0; i < transaction->changedCount; i++) {
+        int index = transaction->changed[i];
+        HeightTile* tile = draft->tiles[index];
+        tile->references++;
+
+        int j = 0;
+        while (j < step->count && step->indices[j] != index) j++;
+        if (j < step->count) {
+            releaseTile(step->after[j]);
+            step->after[j] = tile;
+        } else {
+            step->indices[count] = index;
+            step->before[count] = current->tiles[index];
+            step->before[count]->references++;
+            step->after[count] = tile;
+            count++;
+        }
+    }
+    step->count = count;
+    return 1;
+}
+
+const TerrainSnapshot* storeCommit(TerrainStore* store, TerrainTransaction* transaction) {
+    if (!store || !transaction) return NULL;
+
+    TerrainSnapshot* current = atomic_load(&store->current);
+    TerrainSnapshot* draft = transaction->draft;
+
+    if (transaction->changedCount > 0 && transaction->mergeUndo && store->undoCount > 0 &&
+        mergeIntoLastStep(store, current, transaction)) {
+        clearRedo(store);
+        draft->references = 1;
+        publishSnapshot(store, draft);
+    } else if (transaction->changedCount > 0) {
+        // Record only the replaced tiles, holding a reference to each version
+        UndoStep step;
+        step.count = transaction->changedCount;
+        step.indices = (int*)malloc((size_t)step.count * sizeof(int));
+        step.before = (HeightTile**)malloc((size_t)step.count * sizeof(HeightTile*));
+        step.after = (HeightTile**)malloc((size_t)step.count * sizeof(HeightTile*));
+        if (step.indices && step.before && step.after) {
+            for (int i = 0; i < step.count; i++) {
+                int index = transaction->changed[i];
+                step.indices[i] = index;
+                step.before[i] = current->tiles[index];
+                step.after[i] = draft->tiles[index];
+                step.before[i]->references++;
+                step.after[i]->references++;
+            }
+            clearRedo(store);
+            pushStep(store->undo, &store->undoCount, &step);
+        } else {
+            fprintf(stderr, "Failed to record undo step; edit kept without undo.\n");
+            free(step.indices);
+            free(step.before);
+            free(step.after);
+        }
+
+        draft->references = 1;
+        publishSnapshot(store, draft);
+    } else {
+        freeSnapshot(draft);
+        draft = current;
+    }
+
+    freeTransaction(transaction);
+    pthread_mutex_unlock(&store->writerLock);
+    return draft;
+}
+
+void storeAbort(TerrainStore* store, TerrainTransaction* transaction) {
+    if (!store || !transaction) return;
+    freeSnapshot(transaction->draft);
+    freeTransaction(transaction);
+    pthread_mutex_unlock(&store->writerLock);
+}
+
+// Cell rectangle covered by a step's tiles, clipped to the map
+static void stepBounds(const TerrainSnapshot* snapshot, const UndoStep* step, int bounds[4]) {
+    int tx0 = snapshot->tilesX, tz0 = snapshot->tilesZ, tx1 = 0, tz1 = 0;
+    for (int i = 0; i < step->count; i++) {
+        int tx = step->indices[i] % snapshot->tilesX;
+        int tz = step->indices[i] / snapshot->tilesX;
+        if (tx < tx0) tx0 = tx;
+        if (tz < tz0) tz0 = tz;
+        if (tx + 1 > tx1) tx1 = tx + 1;
+        if (tz + 1 > tz1) tz1 = tz + 1;
+    }
+    bounds[0] = tx0 << SNAPSHOT_TILE_SHIFT;
+    bounds[1] = tz0 << SNAPSHOT_TILE_SHIFT;
+    bounds[2] = tx1 << SNAPSHOT_TILE_SHIFT < snapshot->width ? tx1 << SNAPSHOT_TILE_SHIFT : snapshot->width;
+    bounds[3] = tz1 << SNAPSHOT_TILE_SHIFT < snapshot->depth ? tz1 << SNAPSHOT_TILE_SHIFT : snapshot->depth;
+}
+
+// Publish the current snapshot with the tiles of one step swapped to 'useBefore'
+static int applyStep(TerrainStore* store, const UndoStep* step, int useBefore) {
+    TerrainSnapshot* current = atomic_load(&store->current);
+    TerrainSnapshot* next = allocateSnapshot(current->width, current->depth);
+    if (!next) {
+        fprintf(stderr, "Failed to allocate snapshot for undo/redo.\n");
+        return 0;
+    }
+
+    int tiles = current->tilesX * current->tilesZ;
+    memcpy(next->tiles, current->tiles, (size_t)tiles * sizeof(HeightTile*));
+    for (int i = 0; i < step->count; i++) {
+        next->tiles[step->indices[i]] = useBefore ? step->before[i] : step->after[i];
+    }
+    for (int i = 0; i < tiles; i++) {
+        next->tiles[i]->references++;
+    }
+
+    next->references = 1;
+    publishSnapshot(store, next);
+    return 1;
+}
+
+int storeUndo(TerrainStore* store, int bounds[4]) {
+    if (!store) return 0;
+    pthread_mutex_lock(&store->writerLock);
+
+    int done = 0;
+    if (store->undoCount > 0 && applyStep(store, &store->undo[store->undoCount - 1], 1)) {
+        if (bounds) stepBounds(atomic_load(&store->current), &store->undo[store->undoCount - 1], bounds);
+        UndoStep step = store->undo[--store->undoCount];
+        pushStep(store->redo, &store->redoCount, &step);
+        done = 1;
+    }
+
+    pthread_mutex_unlock(&store->writerLock);
+    return done;
+}
+
+int storeRedo(TerrainStore* store, int bounds[4]) {
+    if (!store) return 0;
+    pthread_mutex_lock(&store->writerLock);
+
+    int done = 0;
+    if (store->redoCount > 0 && applyStep(store, &store->redo[store->redoCount - 1], 0)) {
+        if (bounds) stepBounds(atomic_load(&store->current), &store->redo[store->redoCount - 1], bounds);
+        UndoStep step = store->redo[--store->redoCount];
+        pushStep(store->undo, &store->undoCount, &step);
+        done = 1;
+    }
+
+    pthread_mutex_unlock(&store->writerLock);
+    return done;
+}
@@ -0,0 +1,97 @@
+// snapshot.h
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "terrain.h"
+#include <stdatomic.h>
+#include <pthread.h>
+
+#define SNAPSHOT_TILE_SHIFT 6                       // 64x64 cells per tile
+#define SNAPSHOT_TILE_EDGE (1 << SNAPSHOT_TILE_SHIFT)
+#define SNAPSHOT_TILE_CELLS (SNAPSHOT_TILE_EDGE * SNAPSHOT_TILE_EDGE)
+#define SNAPSHOT_MAX_READERS 64                     // Reader slots for epoch tracking
+#define SNAPSHOT_MAX_UNDO 64                        // Undo steps kept before the oldest is dropped
+
+// Immutable block of heights, shared by every snapshot and undo step that refers to it
+typedef struct {
+    int references;     // Snapshots and undo steps holding the tile; writer side only
+    float heights[SNAPSHOT_TILE_CELLS];
+} HeightTile;
+
+// Immutable view of the whole heightmap. Readers may use it for as long as they
+// keep it pinned, while writers publish newer snapshots alongside it.
+typedef struct TerrainSnapshot {
+    int width;
+    int depth;
+    int tilesX;
+    int tilesZ;
+    unsigned long version;
+    int references;                     // Store + pending undo use; writer side only
+    unsigned long retireEpoch;
+    struct TerrainSnapshot* retiredNext;
+    HeightTile** tiles;                 // tilesX * tilesZ tile pointers
+} TerrainSnapshot;
+
+// Tiles replaced by one committed edit
+typedef struct {
+    int count;
+    int* indices;
+    HeightTile** before;
+    HeightTile** after;
+} UndoStep;
+
+// Writer-side edit in progress: a private copy of the tile table in which touched
+// tiles are cloned on first write
+typedef struct {
+    TerrainSnapshot* draft;
+    unsigned char* cloned;      // Per tile: already private to this transaction
+    int* changed;
+    int changedCount;
+    int mergeUndo;              // Fold into the newest undo step, e.g. for later frames of one brush stroke
+} TerrainTransaction;
+
+typedef struct {
+    _Atomic(TerrainSnapshot*) current;
+    atomic_ulong epoch;
+    atomic_ulong readerEpochs[SNAPSHOT_MAX_READERS];  // Epoch each reader pinned at, or idle
+    atomic_int readerCount;
+
+    pthread_mutex_t writerLock;     // Serializes commits, undo and redo
+    TerrainSnapshot* retired;       // Waiting for readers to move past their epoch; freed on publish
+    UndoStep undo[SNAPSHOT_MAX_UNDO];
+    int undoCount;
+    UndoStep redo[SNAPSHOT_MAX_UNDO];
+    int redoCount;
+} TerrainStore;
+
+TerrainStore* createTerrainStore(const Terrain* terrain);
+void destroyTerrainStore(TerrainStore* store);
+
+// Readers: register once per thread, then pin around every use of a snapshot.
+// Pinning is wait-free and never blocks writers.
+int storeRegisterReader(TerrainStore* store);
+const TerrainSnapshot* storePin(TerrainStore* store, int reader);
+void storeUnpin(TerrainStore* store, int reader);
+
+static inline float snapshotHeight(const TerrainSnapshot* snapshot, int x, int z) {
+    const HeightTile* tile = snapshot->tiles[(z >> SNAPSHOT_TILE_SHIFT) * snapshot->tilesX + (x >> SNAPSHOT_TILE_SHIFT)];
+    return tile->heights[(z & (SNAPSHOT_TILE_EDGE - 1)) * SNAPSHOT_TILE_EDGE + (x & (SNAPSHOT_TILE_EDGE - 1))];
+}
+
+// Copy [x0, x1) x [z0, z1) of a snapshot into terrain rows, e.g. on the render thread
+void snapshotCopyToTerrain(const TerrainSnapshot* snapshot, Terrain* terrain, int x0, int z0, int x1, int z1);
+
+// Writers: begin, write heights, then commit (publishes a new snapshot and records
+// an undo step holding only the changed tiles) or abort
+TerrainTransaction* storeBeginEdit(TerrainStore* store);
+void transactionSetHeight(TerrainTransaction* transaction, int x, int z, float value);
+float* transactionWriteTile(TerrainTransaction* transaction, int tileX, int tileZ);
+const TerrainSnapshot* storeCommit(TerrainStore* store, TerrainTransaction* transaction);
+void storeAbort(TerrainStore* store, TerrainTransaction* transaction);
+
+// Publish the previous/next state. Return 0 when there is nothing to undo/redo;
+// otherwise 'bounds' (optional) receives the changed cells as x0, z0, x1, z1.
+int storeUndo(TerrainStore* store, int bounds[4]);
+int storeRedo(TerrainStore* store, int bounds[4]);
+
+#endif // SNAPSHOT_H
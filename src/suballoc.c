@@ -0,0 +1,246 @@
+// suballoc.c
+#include "suballoc.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SUBALLOC_FIT_SCAN 16    // Blocks tried in the request's own class before taking a larger one
+
+// Size class: floor(log2(size)), so every block in a higher class fits the request
+static int sizeClassOf(size_t size) {
+    int sizeClass = 0;
+    while (size > 1 && sizeClass < SUBALLOC_SIZE_CLASSES - 1) {
+        size >>= 1;
+        sizeClass++;
+    }
+    return sizeClass;
+}
+
+// Take a slot for a new block, recycling released ones. Invalidates block pointers.
+static int newBlock(Suballocator* allocator) {
+    if (allocator->unused >= 0) {
+        int slot = allocator->unused;
+        allocator->unused = allocator->blocks[slot].freeNext;
+        return slot;
+    }
+    if (allocator->blockCount == allocator->blockCapacity) {
+        int capacity = allocator->blockCapacity ? allocator->blockCapacity * 2 : 256;
+        SuballocBlock* blocks = (SuballocBlock*)realloc(allocator->blocks, (size_t)capacity * sizeof(SuballocBlock));
+        if (!blocks) {
+            fprintf(stderr, "Failed to allocate suballocator blocks.\n");
+            return -1;
+        }
+        allocator->blocks = blocks;
+        allocator->blockCapacity = capacity;
+    }
+    return allocator->blockCount++;
+}
+
+static void releaseBlock(Suballocator* allocator, int slot) {
+    allocator->blocks[slot].sizeClass = -2;
+    allocator->blocks[slot].freeNext = allocator->unused;
+    allocator->unused = slot;
+}
+
+static void pushFree(Suballocator* allocator, int slot) {
+    SuballocBlock* block = &allocator->blocks[slot];
+    int sizeClass = sizeClassOf(block->size);
+    block->sizeClass = sizeClass;
+    block->freePrev = -1;
+    block->freeNext = allocator->freeLists[sizeClass];
+    if (block->freeNext >= 0) allocator->blocks[block->freeNext].freePrev = slot;
+    allocator->freeLists[sizeClass] = slot;
+    allocator->freeRanges++;
+}
+
+static void unlinkFree(Suballocator* allocator, int slot) {
+    SuballocBlock* block = &allocator->blocks[slot];
+    if (block->freePrev >= 0) allocator->blocks[block->freePrev].freeNext = block->freeNext;
+    else allocator->freeLists[block->sizeClass] = block->freeNext;
+    if (block->freeNext >= 0) allocator->blocks[block->freeNext].freePrev = block->freePrev;
+    block->sizeClass = -1;
+    allocator->freeRanges--;
+}
+
+Suballocator* createSuballocator(size_t capacity) {
+    Suballocator* allocator = (Suballocator*)calloc(1, sizeof(Suballocator));
+    if (!allocator) return NULL;
+    allocator->unused = -1;
+    allocator->first = -1;
+    allocator->last = -1;
+    for (int i = 0; i < SUBALLOC_SIZE_CLASSES; i++) allocator->freeLists[i] = -1;
+    if (!suballocGrow(allocator, capacity)) {
+        destroySuballocator(allocator);
+        return NULL;
+    }
+    allocator->grows = 0;
+    return allocator;
+}
+
+void destroySuballocator(Suballocator* allocator) {
+    if (!allocator) return;
+    free(allocator->blocks);
+    free(allocator);
+}
+
+int suballocAlloc(Suballocator* allocator, size_t size) {
+    if (size == 0) return -1;
+
+    // First fit within the request's class, then the head of any larger class
+    int sizeClass = sizeClassOf(size);
+    int slot = allocator->freeLists[sizeClass];
+    for (int tries = 0; slot >= 0 && allocator->blocks[slot].size < size; tries++) {
+        slot = tries < SUBALLOC_FIT_SCAN ? allocator->blocks[slot].freeNext : -1;
+    }
+    for (int c = sizeClass + 1; slot < 0 && c < SUBALLOC_SIZE_CLASSES; c++) slot = allocator->freeLists[c];
+    if (slot < 0) return -1;
+
+    // Return the tail to the free lists
+    if (allocator->blocks[slot].size > size) {
+        int rest = newBlock(allocator);
+        if (rest < 0) return -1;
+        SuballocBlock* block = &allocator->blocks[slot];
+        SuballocBlock* tail = &allocator->blocks[rest];
+        tail->offset = block->offset + size;
+        tail->size = block->size - size;
+        tail->prev = slot;
+        tail->next = block->next;
+        if (block->next >= 0) allocator->blocks[block->next].prev = rest;
+        else allocator->last = rest;
+        block->next = rest;
+        block->size = size;
+        unlinkFree(allocator, slot);
+        pushFree(allocator, rest);
+    } else {
+        unlinkFree(allocator, slot);
+    }
+
+    allocator->used += size;
+    allocator->allocations++;
+    return slot;
+}
+
+void suballocFree(Suballocator* allocator, int handle) {
+    if (handle < 0 || handle >= allocator->blockCount || allocator->blocks[handle].sizeClass != -1) return;
+    SuballocBlock* block = &allocator->blocks[handle];
+    allocator->used -= block->size;
+    allocator->allocations--;
+
+    // Absorb a free successor, then let a free predecessor absorb this block
+    int next = block->next;
+    if (next >= 0 && allocator->blocks[next].sizeClass >= 0) {
+        unlinkFree(allocator, next);
+        block->size += allocator->blocks[next].size;
+        block->next = allocator->blocks[next].next;
+        if (block->next >= 0) allocator->blocks[block->next].prev = handle;
+        else allocator->last = handle;
+        releaseBlock(allocator, next);
+    }
+    int prev = block->prev;
+    if (prev >= 0 && allocator->blocks[prev].sizeClass >= 0) {
+        SuballocBlock* before = &allocator->blocks[prev];
+        unlinkFree(allocator, prev);
+        before->size += block->size;
+        before->next = block->next;
+        if (before->next >= 0) allocator->blocks[before->next].prev = prev;
+        else allocator->last = prev;
+        releaseBlock(allocator, handle);
+        handle = prev;
+    }
+    pushFree(allocator, handle);
+}
+
+size_t suballocOffset(const Suballocator* allocator, int handle) {
+    return allocator->blocks[handle].offset;
+}
+
+int suballocGrow(Suballocator* allocator, size_t capacity) {
+    if (capacity <= allocator->capacity) return 1;
+    size_t extra = capacity - allocator->capacity;
+
+    int last = allocator->last;
+    if (last >= 0 && allocator->blocks[last].sizeClass >= 0) {
+        unlinkFree(allocator, last);
+        allocator->blocks[last].size += extra;
+        pushFree(allocator, last);
+    } else {
+        int slot = newBlock(allocator);
+        if (slot < 0) return 0;
+        SuballocBlock* block = &allocator->blocks[slot];
+        block->offset = allocator->capacity;
+        block->size = extra;
+        block->prev = last;
+        block->next = -1;
+        if (last >= 0) allocator->blocks[last].next = slot;
+        else allocator->first = slot;
+        allocator->last = slot;
+        pushFree(allocator, slot);
+    }
+
+    allocator->capacity = capacity;
+    allocator->grows++;
+    return 1;
+}
+
+void suballocCompact(Suballocator* allocator, SuballocMove move, void* context) {
+    size_t cursor = 0;
+    size_t runFrom = 0, runTo = 0, runSize = 0;   // Allocations adjacent before and after
+    int previous = -1;
+    for (int slot = allocator->first; slot >= 0;) {
+        SuballocBlock* block = &allocator->blocks[slot];
+        int next = block->next;
+        if (block->sizeClass >= 0) {
+            releaseBlock(allocator, slot);
+        } else {
+            if (runSize && block->offset != runFrom + runSize) {
+                move(context, runFrom, runTo, runSize);
+                runSize = 0;
+            }
+            if (!runSize) {
+                runFrom = block->offset;
+                runTo = cursor;
+            }
+            runSize += block->size;
+            block->offset = cursor;
+            cursor += block->size;
+            block->prev = previous;
+            if (previous >= 0) allocator->blocks[previous].next = slot;
+            else allocator->first = slot;
+            previous = slot;
+        }
+        slot = next;
+    }
+    if (runSize) move(context, runFrom, runTo, runSize);
+    if (previous >= 0) allocator->blocks[previous].next = -1;
+    else allocator->first = -1;
+    allocator->last = previous;
+    for (int i = 0; i < SUBALLOC_SIZE_CLASSES; i++) allocator->freeLists[i] = -1;
+    allocator->freeRanges = 0;
+
+    // All free space becomes one range at the end; the slot comes from those just released
+    if (cursor < allocator->capacity) {
+        size_t capacity = allocator->capacity;
+        allocator->capacity = cursor;
+        suballocGrow(allocator, capacity);
+        allocator->grows--;
+    }
+    allocator->compactions++;
+}
+
+void suballocGetStats(const Suballocator* allocator, SuballocStats* stats) {
+    stats->capacity = allocator->capacity;
+    stats->used = allocator->used;
+    stats->allocations = allocator->allocations;
+    stats->freeRanges = allocator->freeRanges;
+    stats->grows = allocator->grows;
+    stats->compactions = allocator->compactions;
+
+    // The largest range is in the highest non-empty class
+    stats->largestFree = 0;
+    for (int c = SUBALLOC_SIZE_CLASSES - 1; c >= 0 && stats->largestFree == 0; c--) {
+        for (int slot = allocator->freeLists[c]; slot >= 0; slot = allocator->blocks[slot].freeNext) {
+            if (allocator->blocks[slot].size > stats->largestFree) stats->largestFree = allocator->blocks[slot].size;
+        }
+    }
+    size_t freeSpace = allocator->capacity - allocator->used;
+    stats->fragmentation = freeSpace ? 1.0f - (float)stats->largestFree / (float)freeSpace : 0.0f;
+}
@@ -0,0 +1,75 @@
+// suballoc.h
+#ifndef SUBALLOC_H
+#define SUBALLOC_H
+
+#include <stddef.h>
+
+#define SUBALLOC_SIZE_CLASSES 48    // Free lists by power of two of the range size
+
+// Ranges of one large buffer, handed out by offset and size in caller units (the
+// renderer uses vertices). Free ranges sit in segregated lists by size class and
+// merge with free neighbours when released, so allocation and release cost a few
+// list operations. The allocator only does bookkeeping; copying the contents on
+// growth or compaction is up to the owner of the buffer.
+//
+// Allocations are named by handles that stay valid across compaction, while their
+// offsets change. Handles and blocks share one array; released slots are reused.
+typedef struct {
+    size_t offset;
+    size_t size;
+    int prev, next;             // Neighbouring blocks by offset, -1 at the ends
+    int freePrev, freeNext;     // Size-class list links while free; freeNext chains unused slots
+    int sizeClass;              // Free list the block is on, or -1 while allocated, -2 while unused
+} SuballocBlock;
+
+typedef struct {
+    size_t capacity;
+    size_t used;
+    int allocations;
+    int freeRanges;
+    size_t largestFree;
+    float fragmentation;        // 1 - largestFree / free space; 0 when free space is one range
+    int grows;
+    int compactions;
+} SuballocStats;
+
+typedef struct {
+    size_t capacity;
+    size_t used;
+    int allocations;
+    int freeRanges;
+    int grows;
+    int compactions;
+
+    SuballocBlock* blocks;
+    int blockCount;             // Slots in use or on the unused chain
+    int blockCapacity;
+    int unused;                 // First recycled slot, or -1
+    int first;                  // Block at offset 0, or -1 while capacity is 0
+    int last;                   // Block at the end of the range
+    int freeLists[SUBALLOC_SIZE_CLASSES];
+} Suballocator;
+
+Suballocator* createSuballocator(size_t capacity);
+void destroySuballocator(Suballocator* allocator);
+
+// Reserve 'size' units. Returns a handle, or -1 if no free range is large enough
+// (the caller may then compact or grow and retry).
+int suballocAlloc(Suballocator* allocator, size_t size);
+void suballocFree(Suballocator* allocator, int handle);
+size_t suballocOffset(const Suballocator* allocator, int handle);
+
+// Extend the managed range to 'capacity' units; existing offsets are unchanged.
+// Returns 0 on allocation failure.
+int suballocGrow(Suballocator* allocator, size_t capacity);
+
+// Move every allocation down to close the gaps between them, leaving one free
+// range at the end. 'move' is called in offset order for each run of adjacent
+// allocations with its old and new offsets, including runs that stay in place, so
+// the owner can copy everything into a fresh buffer.
+typedef void (*SuballocMove)(void* context, size_t from, size_t to, size_t size);
+void suballocCompact(Suballocator* allocator, SuballocMove move, void* context);
+
+void suballocGetStats(const Suballocator* allocator, SuballocStats* stats);
+
+#endif // SUBALLOC_H
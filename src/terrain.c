@@ -1,14 +1,28 @@
 // terrain.c
 #include "terrain.h"
 #include "noise.h"  // Include noise header for generating heights
-#include <stdlib.h>  // For malloc and free
+#include <stdlib.h>  // For malloc, aligned_alloc and free
 #include <stdio.h>
+#include <string.h>  // For memcpy and memset
 #include <float.h>   // For FLT_MAX and FLT_MIN
 
-#define MAX_HEIGHT 50.0f  // Define maximum possible height for scaling
+// Round a float count up to a whole number of aligned blocks
+static int roundUpToBlock(int count) {
+    return (count + TERRAIN_ROW_FLOATS - 1) & ~(TERRAIN_ROW_FLOATS - 1);
+}
 
 // Function to create and initialize a terrain structure with a 2D heightmap
 Terrain* createTerrain(int width, int depth) {
+    return createTerrainWithApron(width, depth, TERRAIN_DEFAULT_APRON);
+}
+
+// Create a terrain whose rows are 64-byte aligned, padded to whole blocks and
+// surrounded by 'apron' border cells on every side
+Terrain* createTerrainWithApron(int width, int depth, int apron) {
+    if (width <= 0 || depth <= 0 || apron < 0) {
+        return NULL;
+    }
+
     // Allocate memory for the Terrain structure
     Terrain* terrain = (Terrain*)malloc(sizeof(Terrain));
     if (!terrain) {
@@ -17,13 +31,28 @@ Terrain* createTerrain(int width, int depth) {
 
     terrain->width = width;
     terrain->depth = depth;
+    terrain->apron = apron;
+
+    // The left apron is widened to a full block so that x = 0 lands on an aligned
+    // address; the right side keeps at least 'apron' cells plus block padding
+    int leftPad = roundUpToBlock(apron);
+    terrain->stride = leftPad + roundUpToBlock(width + apron);
 
-    // Allocate memory for the height map (2D array stored as 1D)
-    terrain->heights = (float*)malloc(width * depth * sizeof(float));
-    if (!terrain->heights) {
+    // Allocate memory for the height map (2D array stored as 1D); the size is a
+    // multiple of TERRAIN_ALIGNMENT because the stride is a whole number of blocks
+    size_t rows = (size_t)depth + 2 * (size_t)apron;
+    size_t bytes = rows * (size_t)terrain->stride * sizeof(float);
+    terrain->storage = (float*)aligned_alloc(TERRAIN_ALIGNMENT, bytes);
+    if (!terrain->storage) {
         free(terrain);  // Free terrain memory if height allocation fails
         return NULL;
     }
+    memset(terrain->storage, 0, bytes);
+
+    terrain->heights = terrain->storage + (size_t)apron * terrain->stride + leftPad;
+    terrain->normals = NULL;
+    terrain->slopes = NULL;
+    terrain->materials = NULL;
 
     return terrain;
 }
@@ -31,11 +60,40 @@ Terrain* createTerrain(int width, int depth) {
 // Function to free the memory allocated for a terrain
 void destroyTerrain(Terrain* terrain) {
     if (terrain) {
-        free(terrain->heights);  // Free the height map array
+        free(terrain->storage);  // Free the height map array
+        free(terrain->normals);
+        free(terrain->slopes);
+        free(terrain->materials);
         free(terrain);  // Free the Terrain structure itself
     }
 }
 
+// Replicate the edge cells into the apron so neighbour stencils can read
+// x - apron .. x + apron without bounds checks
+void terrainFillApron(Terrain* terrain) {
+    if (!terrain || !terrain->heights || terrain->apron == 0) return;
+
+    int apron = terrain->apron;
+    int width = terrain->width;
+
+    // Extend every interior row to the left and right
+    for (int z = 0; z < terrain->depth; z++) {
+        float* row = TERRAIN_ROW(terrain, z);
+        for (int a = 1; a <= apron; a++) {
+            row[-a] = row[0];
+            row[width - 1 + a] = row[width - 1];
+        }
+    }
+
+    // Copy the first and last full rows (apron columns included) outwards
+    size_t rowBytes = (size_t)(width + 2 * apron) * sizeof(float);
+    for (int a = 1; a <= apron; a++) {
+        memcpy(TERRAIN_ROW(terrain, -a) - apron, TERRAIN_ROW(terrain, 0) - apron, rowBytes);
+        memcpy(TERRAIN_ROW(terrain, terrain->depth - 1 + a) - apron,
+               TERRAIN_ROW(terrain, terrain->depth - 1) - apron, rowBytes);
+    }
+}
+
 // Function to generate terrain height data using 2D Perlin noise
 void generateTerrain(Terrain* terrain) {
     if (!terrain || !terrain->heights) return;
@@ -56,14 +114,14 @@ void generateTerrain(Terrain* terrain) {
         return;
     }
 
-    // Copy generated noise values into the terrain heights array
+    // Copy generated noise values into the padded terrain rows
     for (int z = 0; z < terrain->depth; z++) {
-        for (int x = 0; x < terrain->width; x++) {
-            terrain->heights[z * terrain->width + x] = noiseMap[z * terrain->width + x];
-        }
+        memcpy(TERRAIN_ROW(terrain, z), noiseMap + (size_t)z * terrain->width, terrain->width * sizeof(float));
     }
 
     // Free the noise map after use
     free(noiseMap);
+
+    terrainFillApron(terrain);
 }
 
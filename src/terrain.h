@@ -2,17 +2,52 @@
 #ifndef TERRAIN_H
 #define TERRAIN_H
 
+#define TERRAIN_ALIGNMENT 64       // Byte alignment of every heightmap row (one cache line)
+#define TERRAIN_ROW_FLOATS 16      // Floats per aligned block (TERRAIN_ALIGNMENT / sizeof(float))
+#define TERRAIN_DEFAULT_APRON 1    // Border cells kept on each side by createTerrain
+
+#define MAX_HEIGHT 50.0f  // Define maximum possible height for scaling
+#define VOXEL_SIZE 1.0f   // World-space edge length of one voxel
+
 typedef struct {
     int width;
     int depth;    // Renamed from 'height' to 'depth' for clarity
     // int height; // Removed or set to 1 if necessary
-    float* heights; // 2D heightmap stored as 1D array
+    int stride;     // Floats between the starts of consecutive rows (multiple of TERRAIN_ROW_FLOATS)
+    int apron;      // Border cells on each side, valid for x in [-apron, width + apron) and likewise z
+    float* storage; // Aligned allocation backing the whole grid, apron and padding included
+    float* heights; // 2D heightmap, points at cell (0, 0) inside storage; rows are 'stride' floats apart
+    unsigned short* normals; // Octahedral-packed surface normals (see normals.h), NULL until computed
+    float* slopes;           // Gradient magnitude (rise over run) per cell, NULL until computed
+    unsigned char* materials; // Material per cell (see materials.h), NULL until computed
 } Terrain;
 
+// Define face types for clarity
+typedef enum {
+    FRONT,   // -Z
+    BACK,    // +Z
+    LEFT,    // -X
+    RIGHT,   // +X
+    TOP,     // +Y
+    BOTTOM   // -Y
+} FaceType;
+
+// Accessors for the padded layout. Each row starts on a TERRAIN_ALIGNMENT boundary
+// and is readable for 'stride' floats, so row kernels can run over whole blocks
+// of TERRAIN_ROW_FLOATS without scalar tails. Apron cells hold clamped edge values.
+#define TERRAIN_INDEX(t, x, z)  ((z) * (t)->stride + (x))
+#define TERRAIN_HEIGHT(t, x, z) ((t)->heights[TERRAIN_INDEX(t, x, z)])
+#define TERRAIN_ROW(t, z)       ((t)->heights + (z) * (t)->stride)
+// World-space position of the corner of cell (0, 0); the grid is centred on the origin
+#define TERRAIN_ORIGIN_X(t)     (-((t)->width / 2.0f) * VOXEL_SIZE)
+#define TERRAIN_ORIGIN_Z(t)     (-((t)->depth / 2.0f) * VOXEL_SIZE)
+#define TERRAIN_PADDED_WIDTH(t) (((t)->width + TERRAIN_ROW_FLOATS - 1) & ~(TERRAIN_ROW_FLOATS - 1))
+
 // Function declarations
 Terrain* createTerrain(int width, int depth);
+Terrain* createTerrainWithApron(int width, int depth, int apron);
 void destroyTerrain(Terrain* terrain);
 void generateTerrain(Terrain* terrain);
+void terrainFillApron(Terrain* terrain);
 
 #endif // TERRAIN_H
-
@@ -0,0 +1,155 @@
+// test_hydrology.c
+// Checks priority-flood depression filling against an iterative reference fill,
+// that every cell drains off the map along its flood parents, and that flow
+// accumulation conserves the map's area.
+// Build: cc -I. test_hydrology.c hydrology.c terrain.c jobs.c noise.c utils.c -lm -lpthread
+#include "hydrology.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TEST_WIDTH 61
+#define TEST_DEPTH 47
+#define TEST_LEVELS 4096
+
+static int failures = 0;
+
+static void check(int condition, const char* what) {
+    if (!condition) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+// Ripples full of pits, a closed crater and a ring valley
+static void fillTerrain(Terrain* terrain) {
+    for (int z = 0; z < terrain->depth; z++) {
+        for (int x = 0; x < terrain->width; x++) {
+            float dx = x - 30.0f, dz = z - 22.0f;
+            float r = sqrtf(dx * dx + dz * dz);
+            float h = 0.5f + 0.1f * sinf(x * 0.9f) * sinf(z * 0.7f);
+            if (r < 12.0f) h += r < 9.0f ? -0.2f : 0.3f;
+            if (r > 16.0f && r < 18.0f) h -= 0.15f;
+            TERRAIN_HEIGHT(terrain, x, z) = h;
+        }
+    }
+    terrainFillApron(terrain);
+}
+
+// Planchon-Darboux: lower a water surface from +infinity until each cell rests on
+// its own height or its lowest eight-connected neighbour
+static void referenceFill(const Terrain* terrain, float* water) {
+    int width = terrain->width, depth = terrain->depth;
+    for (int z = 0; z < depth; z++) {
+        for (int x = 0; x < width; x++) {
+            int edge = x == 0 || z == 0 || x == width - 1 || z == depth - 1;
+            water[z * width + x] = edge ? TERRAIN_HEIGHT(terrain, x, z) : INFINITY;
+        }
+    }
+    for (int changed = 1; changed;) {
+        changed = 0;
+        for (int z = 1; z < depth - 1; z++) {
+            for (int x = 1; x < width - 1; x++) {
+                float lowest = INFINITY;
+                for (int nz = z - 1; nz <= z + 1; nz++) {
+                    for (int nx = x - 1; nx <= x + 1; nx++) {
+                        if ((nx != x || nz != z) && water[nz * width + nx] < lowest) lowest = water[nz * width + nx];
+                    }
+                }
+                float height = TERRAIN_HEIGHT(terrain, x, z);
+                float level = height > lowest ? height : lowest;
+                if (level < water[z * width + x]) {
+                    water[z * width + x] = level;
+                    changed = 1;
+                }
+            }
+        }
+    }
+}
+
+// Largest difference from the reference, and whether every flood parent chain
+// reaches the edge without climbing
+static float checkFill(const Hydrology* hydrology, const Terrain* terrain, const float* reference, int* drains) {
+    int cells = hydrology->width * hydrology->depth;
+    float worst = 0.0f;
+    *drains = 1;
+    for (int cell = 0; cell < cells; cell++) {
+        float error = fabsf(hydrology->filled[cell] - reference[cell]);
+        if (error > worst) worst = error;
+        if (hydrology->filled[cell] < TERRAIN_HEIGHT(terrain, cell % hydrology->width, cell / hydrology->width)) {
+            *drains = 0;
+        }
+
+        int steps = 0;
+        for (int c = cell; hydrology->parent[c] >= 0 && steps <= cells; steps++) {
+            if (hydrology->filled[hydrology->parent[c]] > hydrology->filled[c]) *drains = 0;
+            c = hydrology->parent[c];
+        }
+        if (steps > cells) *drains = 0;
+    }
+    return worst;
+}
+
+// Area reaching outlets: every cell's unit of flow must leave the map exactly once
+static double outletArea(const Hydrology* hydrology) {
+    double total = 0.0;
+    for (int cell = 0; cell < hydrology->width * hydrology->depth; cell++) {
+        if (hydrology->receiver[cell] < 0) total += hydrology->accumulation[cell];
+    }
+    return total;
+}
+
+int main() {
+    Terrain* terrain = createTerrain(TEST_WIDTH, TEST_DEPTH);
+    Hydrology* hydrology = createHydrology(TEST_WIDTH, TEST_DEPTH);
+    float* reference = (float*)malloc((size_t)TEST_WIDTH * TEST_DEPTH * sizeof(float));
+    if (!terrain || !hydrology || !reference) {
+        printf("FAIL: allocation\n");
+        return 1;
+    }
+    fillTerrain(terrain);
+    referenceFill(terrain, reference);
+
+    int drains, raised = 0;
+    hydrologyFillDepressions(hydrology, terrain, 0);
+    for (int cell = 0; cell < TEST_WIDTH * TEST_DEPTH; cell++) {
+        raised += hydrology->filled[cell] > TERRAIN_HEIGHT(terrain, cell % TEST_WIDTH, cell / TEST_WIDTH);
+    }
+    float error = checkFill(hydrology, terrain, reference, &drains);
+    printf("heap flood: %d cells raised, largest difference from the reference %g\n", raised, error);
+    check(raised > 0, "the test map has depressions to fill");
+    check(error == 0.0f, "heap flood matches the reference fill exactly");
+    check(drains, "heap flood parents drain off the map without climbing");
+
+    // Buckets only reorder cells within one quantization level
+    hydrologyFillDepressions(hydrology, terrain, TEST_LEVELS);
+    error = checkFill(hydrology, terrain, reference, &drains);
+    printf("bucket flood: largest difference from the reference %g\n", error);
+    check(error <= 1.0f / TEST_LEVELS, "bucket flood is within one level of the reference");
+    check(drains, "bucket flood parents drain off the map without climbing");
+
+    double cells = (double)TEST_WIDTH * TEST_DEPTH;
+    hydrologyFillDepressions(hydrology, terrain, 0);
+    hydrologyComputeFlow(hydrology, FLOW_D8);
+    hydrologyAccumulate(hydrology);
+    double area = outletArea(hydrology);
+    printf("D8: %.3f of %.0f cells reach an outlet\n", area, cells);
+    check(fabs(area - cells) < 1e-6 * cells, "D8 accumulation conserves area");
+
+    hydrologyComputeFlow(hydrology, FLOW_DINF);
+    hydrologyAccumulate(hydrology);
+    area = outletArea(hydrology);
+    printf("D-infinity: %.3f of %.0f cells reach an outlet\n", area, cells);
+    check(fabs(area - cells) < 1e-3 * cells, "D-infinity accumulation conserves area");
+
+    free(reference);
+    destroyHydrology(hydrology);
+    destroyTerrain(terrain);
+
+    if (failures) {
+        printf("%d hydrology check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All hydrology checks passed\n");
+    return 0;
+}
@@ -0,0 +1,287 @@
+// test_mesh.c
+// Checks without a GL context that the meshers cover exactly the exposed voxel
+// faces: every quad face-up towards empty space, no face covered twice, none
+// missed, and each face carrying its column's material. Coarser levels of detail
+// must stay inside their chunk and cover its columns with tops exactly once.
+// Build: cc -I. test_mesh.c mesh.c terrain.c materials.c water.c jobs.c noise.c utils.c -lm -lpthread
+#include "mesh.h"
+#include "materials.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_WIDTH 70   // Not a multiple of MESH_CHUNK_SIZE, so edge chunks are partial
+#define TEST_DEPTH 45
+#define TEST_LAYERS 64
+
+static int failures = 0;
+
+static void check(int condition, const char* what) {
+    if (!condition) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+// Rolling hills with a cliff and a flat plateau of one material
+static void fillTerrain(Terrain* terrain) {
+    for (int z = 0; z < terrain->depth; z++) {
+        for (int x = 0; x < terrain->width; x++) {
+            float h = 0.3f + 0.25f * sinf(x * 0.21f) * cosf(z * 0.17f);
+            if (x > 40 && x < 55 && z > 10 && z < 30) h = 0.9f;
+            if (x == 20) h = 0.05f;
+            TERRAIN_HEIGHT(terrain, x, z) = h;
+        }
+    }
+    terrainFillApron(terrain);
+}
+
+static int columnTop(const Terrain* terrain, int x, int z) {
+    if (x < 0 || z < 0 || x >= terrain->width || z >= terrain->depth) return -1;
+    return (int)(TERRAIN_HEIGHT(terrain, x, z) * MAX_HEIGHT);
+}
+
+static int solid(const Terrain* terrain, int x, int y, int z) {
+    return y >= 0 && y <= columnTop(terrain, x, z);
+}
+
+static size_t faceIndex(int face, int x, int y, int z) {
+    return (((size_t)face * TEST_DEPTH + z) * TEST_WIDTH + x) * TEST_LAYERS + y;
+}
+
+static const int faceSteps[5][3] = { { 0, 0, -1 }, { 0, 0, 1 }, { -1, 0, 0 }, { 1, 0, 0 }, { 0, 1, 0 } };
+
+// Times each voxel face was emitted, and whether a wrong face was
+typedef struct {
+    unsigned char* covered;
+    int stray;          // Faces of empty voxels or towards solid neighbours
+    int wrongMaterial;
+    int wrongWinding;
+} Coverage;
+
+// Mark the unit faces of one quad given its corners in grid units
+static void coverQuad(Coverage* coverage, const Terrain* terrain, int face, int corners[4][3], int material) {
+    int lo[3], hi[3];
+    for (int a = 0; a < 3; a++) {
+        lo[a] = hi[a] = corners[0][a];
+        for (int i = 1; i < 4; i++) {
+            if (corners[i][a] < lo[a]) lo[a] = corners[i][a];
+            if (corners[i][a] > hi[a]) hi[a] = corners[i][a];
+        }
+    }
+
+    // The first triangle must face along the face normal
+    int e1[3], e2[3];
+    for (int a = 0; a < 3; a++) {
+        e1[a] = corners[1][a] - corners[0][a];
+        e2[a] = corners[2][a] - corners[0][a];
+    }
+    int n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+    if (n[0] * faceSteps[face][0] + n[1] * faceSteps[face][1] + n[2] * faceSteps[face][2] <= 0) coverage->wrongWinding++;
+
+    // Collapse the axis the face lies on to the voxel behind it
+    int axis = face == TOP ? 1 : (face == LEFT || face == RIGHT ? 0 : 2);
+    if (face == TOP || face == BACK || face == RIGHT) lo[axis]--;
+    hi[axis] = lo[axis] + 1;
+
+    for (int z = lo[2]; z < hi[2]; z++) {
+        for (int y = lo[1]; y < hi[1]; y++) {
+            for (int x = lo[0]; x < hi[0]; x++) {
+                const int* d = faceSteps[face];
+                if (!solid(terrain, x, y, z) || solid(terrain, x + d[0], y + d[1], z + d[2])) {
+                    coverage->stray++;
+                    continue;
+                }
+                Material expected = chooseMaterial(TERRAIN_HEIGHT(terrain, x, z), -1.0f, 0.0f);
+                if (material != (int)expected) coverage->wrongMaterial++;
+                coverage->covered[faceIndex(face, x, y, z)]++;
+            }
+        }
+    }
+}
+
+static int faceOfNormal(const float normal[3]) {
+    if (normal[1] > 0.5f) return TOP;
+    if (normal[0] < -0.5f) return LEFT;
+    if (normal[0] > 0.5f) return RIGHT;
+    return normal[2] < 0.0f ? FRONT : BACK;
+}
+
+static void coverMesh(Coverage* coverage, const Terrain* terrain, const TerrainMesh* mesh) {
+    for (size_t q = 0; q < mesh->vertexCount / 4; q++) {
+        const MeshVertex* vertex = mesh->vertices + q * 4;
+        int corners[4][3];
+        for (int i = 0; i < 4; i++) {
+            corners[i][0] = (int)lroundf((vertex[i].position[0] - TERRAIN_ORIGIN_X(terrain)) / VOXEL_SIZE);
+            corners[i][1] = (int)lroundf(vertex[i].position[1] / VOXEL_SIZE);
+            corners[i][2] = (int)lroundf((vertex[i].position[2] - TERRAIN_ORIGIN_Z(terrain)) / VOXEL_SIZE);
+        }
+        coverQuad(coverage, terrain, faceOfNormal(vertex[0].normal), corners, (int)vertex[0].material);
+    }
+}
+
+static void coverPackedMesh(Coverage* coverage, const Terrain* terrain, const PackedMesh* mesh) {
+    for (size_t q = 0; q < mesh->vertexCount / 4; q++) {
+        const PackedVertex* vertex = mesh->vertices + q * 4;
+        int corners[4][3];
+        for (int i = 0; i < 4; i++) {
+            corners[i][0] = mesh->originX + (int)(vertex[i] & 0xFF);
+            corners[i][1] = (int)(vertex[i] >> PACKED_Y_SHIFT & 0x3F);
+            corners[i][2] = mesh->originZ + (int)(vertex[i] >> 8 & 0xFF);
+        }
+        int face = (int)(vertex[0] >> PACKED_FACE_SHIFT & 0x7);
+        coverQuad(coverage, terrain, face, corners, (int)(vertex[0] >> PACKED_MATERIAL_SHIFT & 0xF));
+    }
+}
+
+// Check one coarse chunk: every corner inside the chunk box, quads facing out,
+// and tops counted per column in 'tops'. Returns the number of bad quads.
+static int checkLodChunk(const PackedMesh* mesh, int x0, int z0, int x1, int z1, unsigned char* tops) {
+    int bad = 0;
+    for (size_t q = 0; q < mesh->vertexCount / 4; q++) {
+        const PackedVertex* vertex = mesh->vertices + q * 4;
+        int face = (int)(vertex[0] >> PACKED_FACE_SHIFT & 0x7);
+        int corners[4][3], lo[3], hi[3], outside = 0;
+        for (int i = 0; i < 4; i++) {
+            corners[i][0] = mesh->originX + (int)(vertex[i] & 0xFF);
+            corners[i][1] = (int)(vertex[i] >> PACKED_Y_SHIFT & 0x3F);
+            corners[i][2] = mesh->originZ + (int)(vertex[i] >> 8 & 0xFF);
+            if (corners[i][0] < x0 || corners[i][0] > x1 || corners[i][2] < z0 || corners[i][2] > z1) outside = 1;
+        }
+        for (int a = 0; a < 3; a++) {
+            lo[a] = hi[a] = corners[0][a];
+            for (int i = 1; i < 4; i++) {
+                if (corners[i][a] < lo[a]) lo[a] = corners[i][a];
+                if (corners[i][a] > hi[a]) hi[a] = corners[i][a];
+            }
+        }
+
+        int e1[3], e2[3];
+        for (int a = 0; a < 3; a++) {
+            e1[a] = corners[1][a] - corners[0][a];
+            e2[a] = corners[2][a] - corners[0][a];
+        }
+        int n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+        int inward = n[0] * faceSteps[face][0] + n[1] * faceSteps[face][1] + n[2] * faceSteps[face][2] <= 0;
+
+        if (outside || inward) {
+            bad++;
+            continue;
+        }
+        if (face != TOP) continue;
+        for (int z = lo[2]; z < hi[2]; z++) {
+            for (int x = lo[0]; x < hi[0]; x++) tops[z * TEST_WIDTH + x]++;
+        }
+    }
+    return bad;
+}
+
+// Every exposed face covered once and nothing else covered
+static void checkCoverage(const Coverage* coverage, const Terrain* terrain, const char* name) {
+    int missing = 0, doubled = 0, exposed = 0;
+    for (int face = 0; face < 5; face++) {
+        for (int z = 0; z < terrain->depth; z++) {
+            for (int x = 0; x < terrain->width; x++) {
+                for (int y = 0; y < TEST_LAYERS; y++) {
+                    const int* d = faceSteps[face];
+                    int visible = solid(terrain, x, y, z) && !solid(terrain, x + d[0], y + d[1], z + d[2]);
+                    int count = coverage->covered[faceIndex(face, x, y, z)];
+                    exposed += visible;
+                    if (visible && count == 0) missing++;
+                    if (count > 1) doubled++;
+                }
+            }
+        }
+    }
+
+    printf("%s: %d exposed faces, %d missing, %d doubled, %d stray, %d wrong material, %d wrong winding\n",
+           name, exposed, missing, doubled, coverage->stray, coverage->wrongMaterial, coverage->wrongWinding);
+    check(missing == 0, "every exposed face is covered");
+    check(doubled == 0, "no face is covered twice");
+    check(coverage->stray == 0, "no hidden or empty face is covered");
+    check(coverage->wrongMaterial == 0, "faces carry their column's material");
+    check(coverage->wrongWinding == 0, "quads face out of the solid");
+}
+
+static void resetCoverage(Coverage* coverage) {
+    memset(coverage->covered, 0, (size_t)5 * TEST_DEPTH * TEST_WIDTH * TEST_LAYERS);
+    coverage->stray = coverage->wrongMaterial = coverage->wrongWinding = 0;
+}
+
+int main() {
+    Terrain* terrain = createTerrain(TEST_WIDTH, TEST_DEPTH);
+    Coverage coverage;
+    coverage.covered = (unsigned char*)malloc((size_t)5 * TEST_DEPTH * TEST_WIDTH * TEST_LAYERS);
+    if (!terrain || !coverage.covered) {
+        printf("FAIL: allocation\n");
+        return 1;
+    }
+    fillTerrain(terrain);
+
+    // Column spans
+    TerrainMesh mesh;
+    initTerrainMesh(&mesh);
+    resetCoverage(&coverage);
+    check(buildTerrainMesh(terrain, &mesh), "column-span mesh builds");
+    coverMesh(&coverage, terrain, &mesh);
+    checkCoverage(&coverage, terrain, "column spans");
+    size_t spanQuads = mesh.vertexCount / 4;
+
+    // Greedy, whole map
+    MeshStats stats;
+    resetCoverage(&coverage);
+    check(buildTerrainMeshGreedy(terrain, &mesh, &stats), "greedy mesh builds");
+    coverMesh(&coverage, terrain, &mesh);
+    checkCoverage(&coverage, terrain, "greedy");
+    check(stats.columnQuads == spanQuads, "greedy stats count the column-span quads");
+    check(stats.greedyQuads == mesh.vertexCount / 4 && stats.greedyQuads < spanQuads, "greedy merging saves quads");
+
+    // Packed level 0, chunk by chunk as the renderer builds it
+    MeshScratch* scratch = createMeshScratch();
+    PackedMesh packed;
+    initPackedMesh(&packed);
+    resetCoverage(&coverage);
+    for (int z0 = 0; z0 < TEST_DEPTH; z0 += MESH_CHUNK_SIZE) {
+        for (int x0 = 0; x0 < TEST_WIDTH; x0 += MESH_CHUNK_SIZE) {
+            check(buildPackedMeshLodRect(scratch, terrain, x0, z0, x0 + MESH_CHUNK_SIZE, z0 + MESH_CHUNK_SIZE, 0, &packed, NULL),
+                  "packed chunk builds");
+            coverPackedMesh(&coverage, terrain, &packed);
+        }
+    }
+    checkCoverage(&coverage, terrain, "packed chunks");
+
+    // Coarser levels, chunk by chunk, with partial chunks along the far edges
+    unsigned char* tops = (unsigned char*)malloc((size_t)TEST_WIDTH * TEST_DEPTH);
+    for (int lod = 1; tops && lod <= MESH_MAX_LOD; lod++) {
+        int bad = 0, wrongTops = 0;
+        memset(tops, 0, (size_t)TEST_WIDTH * TEST_DEPTH);
+        for (int z0 = 0; z0 < TEST_DEPTH; z0 += MESH_CHUNK_SIZE) {
+            for (int x0 = 0; x0 < TEST_WIDTH; x0 += MESH_CHUNK_SIZE) {
+                int x1 = x0 + MESH_CHUNK_SIZE < TEST_WIDTH ? x0 + MESH_CHUNK_SIZE : TEST_WIDTH;
+                int z1 = z0 + MESH_CHUNK_SIZE < TEST_DEPTH ? z0 + MESH_CHUNK_SIZE : TEST_DEPTH;
+                check(buildPackedMeshLodRect(scratch, terrain, x0, z0, x1, z1, lod, &packed, NULL),
+                      "coarse packed chunk builds");
+                bad += checkLodChunk(&packed, x0, z0, x1, z1, tops);
+            }
+        }
+        for (int i = 0; i < TEST_WIDTH * TEST_DEPTH; i++) wrongTops += tops[i] != 1;
+        printf("level %d: %d quads outside their chunk or facing in, %d columns not topped once\n", lod, bad, wrongTops);
+        check(bad == 0, "coarse quads stay inside their chunk and face out");
+        check(wrongTops == 0, "coarse tops cover every column once");
+    }
+    free(tops);
+
+    freePackedMesh(&packed);
+    destroyMeshScratch(scratch);
+    freeTerrainMesh(&mesh);
+    free(coverage.covered);
+    destroyTerrain(terrain);
+
+    if (failures) {
+        printf("%d mesh check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All mesh checks passed\n");
+    return 0;
+}
@@ -0,0 +1,97 @@
+// test_normals.c
+// Checks that normals computed through the Morton-tiled heightmap match the
+// row-major pass bit for bit, with partial tiles along the far edges, and
+// prints both timings.
+// Build: cc -I. test_normals.c normals.c tiles.c terrain.c jobs.c noise.c utils.c -lm -lpthread
+#include "normals.h"
+#include "utils.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_WIDTH 1000     // Not a multiple of either tile edge
+#define TEST_DEPTH 700
+
+static int failures = 0;
+
+static void check(int condition, const char* what) {
+    if (!condition) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+// Broad hills with fine ripples so neighbouring cells differ
+static void fillTerrain(Terrain* terrain) {
+    for (int z = 0; z < terrain->depth; z++) {
+        for (int x = 0; x < terrain->width; x++) {
+            float h = 0.5f + 0.3f * sinf(x * 0.013f) * cosf(z * 0.021f) + 0.05f * sinf(x * 0.7f + z * 0.3f);
+            TERRAIN_HEIGHT(terrain, x, z) = h;
+        }
+    }
+    terrainFillApron(terrain);
+}
+
+int main() {
+    Terrain* terrain = createTerrain(TEST_WIDTH, TEST_DEPTH);
+    size_t cells = (size_t)TEST_DEPTH * TEST_WIDTH;
+    unsigned short* normals = (unsigned short*)malloc(cells * sizeof(unsigned short));
+    float* slopes = (float*)malloc(cells * sizeof(float));
+    if (!terrain || !normals || !slopes) {
+        printf("FAIL: allocation\n");
+        return 1;
+    }
+    fillTerrain(terrain);
+
+    double start = getTimeSeconds();
+    terrainComputeNormals(terrain);
+    double rowMajor = getTimeSeconds() - start;
+    check(terrain->normals && terrain->slopes, "row-major normals compute");
+    if (!terrain->normals || !terrain->slopes) return 1;
+    for (int z = 0; z < TEST_DEPTH; z++) {
+        memcpy(normals + (size_t)z * TEST_WIDTH, terrain->normals + (size_t)z * terrain->stride, TEST_WIDTH * sizeof(unsigned short));
+        memcpy(slopes + (size_t)z * TEST_WIDTH, terrain->slopes + (size_t)z * terrain->stride, TEST_WIDTH * sizeof(float));
+    }
+    printf("row-major: %.1f ms\n", rowMajor * 1000.0);
+
+    int shifts[2] = { TILE_SHIFT_32, TILE_SHIFT_64 };
+    for (int i = 0; i < 2; i++) {
+        TiledHeightmap* map = createTiledHeightmap(TEST_WIDTH, TEST_DEPTH, shifts[i]);
+        check(map != NULL, "tiled heightmap allocates");
+        if (!map) continue;
+
+        // Clear the planes so stale row-major results cannot pass for tiled ones
+        memset(terrain->normals, 0, (size_t)TEST_DEPTH * terrain->stride * sizeof(unsigned short));
+        memset(terrain->slopes, 0, (size_t)TEST_DEPTH * terrain->stride * sizeof(float));
+
+        start = getTimeSeconds();
+        tiledImportTerrain(map, terrain);
+        double imported = getTimeSeconds();
+        terrainComputeNormalsTiled(terrain, map);
+        double computed = getTimeSeconds();
+
+        int differing = 0;
+        for (int z = 0; z < TEST_DEPTH; z++) {
+            for (int x = 0; x < TEST_WIDTH; x++) {
+                size_t cell = (size_t)z * TEST_WIDTH + x;
+                differing += TERRAIN_NORMAL(terrain, x, z) != normals[cell] || TERRAIN_SLOPE(terrain, x, z) != slopes[cell];
+            }
+        }
+        printf("%dx%d tiles: import %.1f ms, normals %.1f ms, %d cells differ\n", map->tileEdge, map->tileEdge,
+               (imported - start) * 1000.0, (computed - imported) * 1000.0, differing);
+        check(differing == 0, "tiled normals and slopes match the row-major pass");
+        destroyTiledHeightmap(map);
+    }
+
+    free(normals);
+    free(slopes);
+    destroyTerrain(terrain);
+
+    if (failures) {
+        printf("%d normal check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All normal checks passed\n");
+    return 0;
+}
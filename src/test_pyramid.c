@@ -0,0 +1,167 @@
+// test_pyramid.c
+// Checks the hierarchical ray cast against a brute-force test of every voxel
+// column: same hit or miss, same distance, a hit cell whose column contains the
+// hit point, and the face the ray entered through.
+// Build: cc -I. test_pyramid.c pyramid.c terrain.c noise.c utils.c -lm
+#include "pyramid.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TEST_WIDTH 77
+#define TEST_DEPTH 53
+#define TEST_RAYS 4000
+#define TEST_EPSILON 1e-3f
+
+static int failures = 0;
+
+static void check(int condition, const char* what) {
+    if (!condition) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+static void fillTerrain(Terrain* terrain) {
+    for (int z = 0; z < terrain->depth; z++) {
+        for (int x = 0; x < terrain->width; x++) {
+            float h = 0.4f + 0.3f * sinf(x * 0.13f + 1.0f) * cosf(z * 0.29f);
+            if ((x / 9 + z / 7) % 5 == 0) h += 0.2f;   // Sharp-edged blocks
+            TERRAIN_HEIGHT(terrain, x, z) = h;
+        }
+    }
+    terrainFillApron(terrain);
+}
+
+static float randomRange(float lo, float hi) {
+    return lo + (hi - lo) * (float)rand() / (float)RAND_MAX;
+}
+
+// Nearest entry into any column box [x, x+1] x [0, top] x [z, z+1] in grid units.
+// Returns the distance or INFINITY, with the entry face.
+static float bruteForceHit(const Terrain* terrain, const float o[3], const float d[3], float maxT, FaceType* face) {
+    float best = INFINITY;
+    for (int z = 0; z < terrain->depth; z++) {
+        for (int x = 0; x < terrain->width; x++) {
+            float lo[3] = { (float)x, 0.0f, (float)z };
+            float hi[3] = { x + 1.0f, (float)((int)(TERRAIN_HEIGHT(terrain, x, z) * MAX_HEIGHT) + 1), z + 1.0f };
+            float tNear = 0.0f, tFar = maxT;
+            int axis = -1;
+            for (int a = 0; a < 3 && tNear <= tFar; a++) {
+                if (d[a] == 0.0f) {
+                    if (o[a] < lo[a] || o[a] > hi[a]) tNear = INFINITY;
+                    continue;
+                }
+                float t0 = (lo[a] - o[a]) / d[a];
+                float t1 = (hi[a] - o[a]) / d[a];
+                if (t0 > t1) { float swap = t0; t0 = t1; t1 = swap; }
+                if (t0 > tNear) { tNear = t0; axis = a; }
+                if (t1 < tFar) tFar = t1;
+            }
+            if (tNear > tFar || tNear >= best) continue;
+            best = tNear;
+            if (axis == 0) *face = d[0] > 0.0f ? LEFT : RIGHT;
+            else if (axis == 2) *face = d[2] > 0.0f ? FRONT : BACK;
+            else *face = d[1] > 0.0f ? BOTTOM : TOP;
+        }
+    }
+    return best;
+}
+
+int main() {
+    Terrain* terrain = createTerrain(TEST_WIDTH, TEST_DEPTH);
+    if (!terrain) {
+        printf("FAIL: allocation\n");
+        return 1;
+    }
+    fillTerrain(terrain);
+    HeightPyramid* pyramid = createHeightPyramid(terrain);
+    check(pyramid != NULL, "pyramid builds");
+    if (!pyramid) return 1;
+
+    static float origins[TEST_RAYS * 3], directions[TEST_RAYS * 3], maxDistances[TEST_RAYS];
+    static TerrainHit single[TEST_RAYS], batch[TEST_RAYS];
+    srand(12345);
+    for (int i = 0; i < TEST_RAYS; i++) {
+        float* o = origins + i * 3;
+        float* d = directions + i * 3;
+        if (i % 4 == 3) {
+            // Grazing rays from beside the map, through the walls
+            o[0] = TERRAIN_ORIGIN_X(terrain) - 5.0f;
+            o[1] = randomRange(5.0f, 45.0f);
+            o[2] = randomRange(TERRAIN_ORIGIN_Z(terrain), -TERRAIN_ORIGIN_Z(terrain));
+            d[0] = 1.0f;
+            d[1] = randomRange(-0.3f, 0.1f);
+            d[2] = randomRange(-0.5f, 0.5f);
+        } else {
+            // Camera-like rays from above, looking down at any angle
+            o[0] = randomRange(TERRAIN_ORIGIN_X(terrain) - 20.0f, -TERRAIN_ORIGIN_X(terrain) + 20.0f);
+            o[1] = randomRange(55.0f, 80.0f);
+            o[2] = randomRange(TERRAIN_ORIGIN_Z(terrain) - 20.0f, -TERRAIN_ORIGIN_Z(terrain) + 20.0f);
+            d[0] = randomRange(-1.0f, 1.0f);
+            d[1] = randomRange(-1.0f, -0.05f);
+            d[2] = randomRange(-1.0f, 1.0f);
+        }
+        maxDistances[i] = i % 5 == 0 ? 40.0f : 500.0f;
+    }
+
+    int hits = 0, wrongHit = 0, wrongDistance = 0, wrongCell = 0, wrongFace = 0;
+    for (int i = 0; i < TEST_RAYS; i++) {
+        const float* origin = origins + i * 3;
+        const float* direction = directions + i * 3;
+        pyramidRaycast(pyramid, terrain, origin, direction, maxDistances[i], &single[i]);
+
+        float length = sqrtf(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+        float o[3] = { (origin[0] - TERRAIN_ORIGIN_X(terrain)) / VOXEL_SIZE, origin[1] / VOXEL_SIZE,
+                       (origin[2] - TERRAIN_ORIGIN_Z(terrain)) / VOXEL_SIZE };
+        float d[3] = { direction[0] / length, direction[1] / length, direction[2] / length };
+        FaceType face = TOP;
+        float t = bruteForceHit(terrain, o, d, maxDistances[i] / VOXEL_SIZE, &face);
+
+        const TerrainHit* hit = &single[i];
+        if (hit->hit != (t != INFINITY)) {
+            wrongHit++;
+            continue;
+        }
+        if (!hit->hit) continue;
+        hits++;
+        if (fabsf(hit->distance - t * VOXEL_SIZE) > TEST_EPSILON) wrongDistance++;
+        if (hit->face != face) wrongFace++;
+
+        // The reported voxel's box must contain the hit point
+        float gx = (hit->position[0] - TERRAIN_ORIGIN_X(terrain)) / VOXEL_SIZE;
+        float gy = hit->position[1] / VOXEL_SIZE;
+        float gz = (hit->position[2] - TERRAIN_ORIGIN_Z(terrain)) / VOXEL_SIZE;
+        if (gx < hit->x - TEST_EPSILON || gx > hit->x + 1 + TEST_EPSILON || gz < hit->z - TEST_EPSILON ||
+            gz > hit->z + 1 + TEST_EPSILON || gy < hit->y - TEST_EPSILON || gy > hit->y + 1 + TEST_EPSILON) {
+            wrongCell++;
+        }
+    }
+    printf("ray cast: %d rays, %d hits, %d wrong hit/miss, %d wrong distance, %d wrong cell, %d wrong face\n",
+           TEST_RAYS, hits, wrongHit, wrongDistance, wrongCell, wrongFace);
+    check(wrongHit == 0, "hits and misses match the brute-force cast");
+    check(wrongDistance == 0, "hit distances match the brute-force cast");
+    check(wrongCell == 0, "hit cells contain the hit point");
+    check(wrongFace == 0, "hit faces match the entry face");
+
+    // The batch must agree with single casts
+    pyramidRaycastBatch(pyramid, terrain, origins, directions, maxDistances, TEST_RAYS, batch);
+    int mismatched = 0;
+    for (int i = 0; i < TEST_RAYS; i++) {
+        if (batch[i].hit != single[i].hit || (single[i].hit && (batch[i].x != single[i].x || batch[i].z != single[i].z ||
+                                                                 batch[i].distance != single[i].distance))) {
+            mismatched++;
+        }
+    }
+    check(mismatched == 0, "batched casts match single casts");
+
+    destroyHeightPyramid(pyramid);
+    destroyTerrain(terrain);
+
+    if (failures) {
+        printf("%d ray cast check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All ray cast checks passed\n");
+    return 0;
+}
@@ -0,0 +1,145 @@
+// test_suballoc.c
+// Randomized allocate/free against the suballocator with growth and compaction,
+// checking after every step that the blocks tile the range in offset order with
+// free neighbours merged, that the totals agree, and that allocation contents
+// survive compaction when copied through the move callback.
+// Build: cc -I. test_suballoc.c suballoc.c
+#include "suballoc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_STEPS 200000
+#define TEST_LIVE 4000              // Allocations alive at once
+#define TEST_MEMORY (1 << 20)       // Largest pool the test grows to, in units (bytes here)
+#define TEST_COMPACT_FRAGMENTATION 0.5f
+
+static int failures = 0;
+
+static void check(int condition, const char* what) {
+    if (!condition) {
+        printf("FAIL: %s\n", what);
+        failures++;
+    }
+}
+
+// Stand-ins for the old and new GPU buffers
+static unsigned char* memory;
+static unsigned char* compacted;
+
+static void copyRun(void* context, size_t from, size_t to, size_t size) {
+    (void)context;
+    memcpy(compacted + to, memory + from, size);
+}
+
+static void compact(Suballocator* allocator) {
+    memset(compacted, 0, TEST_MEMORY);
+    suballocCompact(allocator, copyRun, NULL);
+    unsigned char* swap = memory;
+    memory = compacted;
+    compacted = swap;
+}
+
+// Walk the blocks by offset and compare with the allocator's own bookkeeping
+static int consistent(const Suballocator* allocator) {
+    size_t offset = 0, used = 0;
+    int freeRanges = 0, allocations = 0, previous = -1, previousFree = 0;
+    for (int slot = allocator->first; slot >= 0; slot = allocator->blocks[slot].next) {
+        const SuballocBlock* block = &allocator->blocks[slot];
+        if (block->offset != offset || block->prev != previous || block->size == 0) return 0;
+        int isFree = block->sizeClass >= 0;
+        if (isFree && previousFree) return 0;   // Unmerged neighbours
+        if (isFree) freeRanges++;
+        else {
+            allocations++;
+            used += block->size;
+        }
+        previousFree = isFree;
+        offset += block->size;
+        previous = slot;
+    }
+    return offset == allocator->capacity && used == allocator->used && freeRanges == allocator->freeRanges &&
+           allocations == allocator->allocations && previous == allocator->last;
+}
+
+int main() {
+    static int handles[TEST_LIVE];
+    static size_t sizes[TEST_LIVE];
+    static unsigned char tags[TEST_LIVE];
+    memory = (unsigned char*)calloc(TEST_MEMORY, 1);
+    compacted = (unsigned char*)calloc(TEST_MEMORY, 1);
+    Suballocator* allocator = createSuballocator(1000);
+    if (!memory || !compacted || !allocator) {
+        printf("FAIL: allocation\n");
+        return 1;
+    }
+
+    int live = 0, broken = 0, corrupted = 0;
+    srand(1);
+    for (int step = 0; step < TEST_STEPS; step++) {
+        if (live < TEST_LIVE && (live == 0 || rand() % 3)) {
+            // Mostly small ranges with some large ones, like chunk levels
+            size_t size = 1 + (size_t)(rand() % (rand() % 2 ? 8 : 200));
+            int handle = suballocAlloc(allocator, size);
+            if (handle < 0) {
+                SuballocStats stats;
+                suballocGetStats(allocator, &stats);
+                if (stats.fragmentation > TEST_COMPACT_FRAGMENTATION && stats.capacity - stats.used >= size) {
+                    compact(allocator);
+                    suballocGetStats(allocator, &stats);
+                    if (stats.freeRanges > 1 || stats.fragmentation != 0.0f) broken++;
+                    if (stats.capacity - stats.used < size) broken++;   // The free space must now fit it
+                } else if (stats.capacity * 2 <= TEST_MEMORY) {
+                    suballocGrow(allocator, stats.capacity * 2);
+                } else {
+                    continue;
+                }
+                if (!consistent(allocator)) broken++;
+                handle = suballocAlloc(allocator, size);
+                if (handle < 0) continue;
+            }
+            handles[live] = handle;
+            sizes[live] = size;
+            tags[live] = (unsigned char)rand();
+            memset(memory + suballocOffset(allocator, handle), tags[live], size);
+            live++;
+        } else {
+            int i = rand() % live;
+            const unsigned char* data = memory + suballocOffset(allocator, handles[i]);
+            for (size_t j = 0; j < sizes[i]; j++) corrupted += data[j] != tags[i];
+            suballocFree(allocator, handles[i]);
+            live--;
+            handles[i] = handles[live];
+            sizes[i] = sizes[live];
+            tags[i] = tags[live];
+        }
+        if (step % 97 == 0 && !consistent(allocator)) broken++;
+    }
+
+    SuballocStats stats;
+    suballocGetStats(allocator, &stats);
+    printf("suballoc: %zu of %zu units in %d allocations, %d free ranges, largest %zu, %.0f%% fragmented, "
+           "%d grows, %d compactions\n", stats.used, stats.capacity, stats.allocations, stats.freeRanges,
+           stats.largestFree, stats.fragmentation * 100.0f, stats.grows, stats.compactions);
+    check(broken == 0, "blocks tile the range with free neighbours merged");
+    check(corrupted == 0, "allocation contents survive growth and compaction");
+    check(stats.grows > 0 && stats.compactions > 0, "the run exercises growth and compaction");
+    check(stats.allocations == live, "live allocations are counted");
+
+    // Freeing everything leaves one range covering the pool
+    while (live > 0) suballocFree(allocator, handles[--live]);
+    suballocGetStats(allocator, &stats);
+    check(stats.used == 0 && stats.freeRanges == 1 && stats.largestFree == stats.capacity && consistent(allocator),
+          "freeing everything merges back into one range");
+
+    destroySuballocator(allocator);
+    free(memory);
+    free(compacted);
+
+    if (failures) {
+        printf("%d suballocator check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All suballocator checks passed\n");
+    return 0;
+}
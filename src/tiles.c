@@ -0,0 +1,152 @@
+// tiles.c
+#include "tiles.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+// Spread the low bits of v so that bit i moves to bit 2i
+static unsigned int spreadBits(unsigned int v) {
+    unsigned int result = 0;
+    for (int bit = 0; bit < 16; bit++) {
+        result |= ((v >> bit) & 1u) << (2 * bit);
+    }
+    return result;
+}
+
+// Create an empty tiled heightmap; tileShift selects 32x32 or 64x64 tiles
+TiledHeightmap* createTiledHeightmap(int width, int depth, int tileShift) {
+    if (width <= 0 || depth <= 0) return NULL;
+    if (tileShift != TILE_SHIFT_32 && tileShift != TILE_SHIFT_64) {
+        fprintf(stderr, "Unsupported tile shift: %d\n", tileShift);
+        return NULL;
+    }
+
+    TiledHeightmap* map = (TiledHeightmap*)malloc(sizeof(TiledHeightmap));
+    if (!map) return NULL;
+
+    map->width = width;
+    map->depth = depth;
+    map->tileShift = tileShift;
+    map->tileEdge = 1 << tileShift;
+    map->tileArea = map->tileEdge * map->tileEdge;
+    map->tilesX = (width + map->tileEdge - 1) >> tileShift;
+    map->tilesZ = (depth + map->tileEdge - 1) >> tileShift;
+
+    // x takes the even Morton bits and z the odd ones
+    for (int i = 0; i < map->tileEdge; i++) {
+        map->spreadX[i] = spreadBits((unsigned int)i);
+        map->spreadZ[i] = spreadBits((unsigned int)i) << 1;
+    }
+    map->xMask = map->spreadX[map->tileEdge - 1];
+    map->zMask = map->spreadZ[map->tileEdge - 1];
+
+    // Every tile is a whole number of cache lines, so tiles stay line-aligned
+    size_t bytes = (size_t)map->tilesX * map->tilesZ * map->tileArea * sizeof(float);
+    map->data = (float*)aligned_alloc(TERRAIN_ALIGNMENT, bytes);
+    if (!map->data) {
+        free(map);
+        return NULL;
+    }
+
+    return map;
+}
+
+void destroyTiledHeightmap(TiledHeightmap* map) {
+    if (map) {
+        free(map->data);
+        free(map);
+    }
+}
+
+// Copy a row-major terrain into the tiled layout, one tile at a time so that the
+// destination tile stays in cache while its source rows stream through.
+// Cells of partial edge tiles beyond the map are filled with clamped edge values.
+void tiledImportTerrain(TiledHeightmap* map, const Terrain* terrain) {
+    if (!map || !terrain || !terrain->heights) return;
+    if (map->width != terrain->width || map->depth != terrain->depth) return;
+
+    int edge = map->tileEdge;
+    for (int tz = 0; tz < map->tilesZ; tz++) {
+        for (int tx = 0; tx < map->tilesX; tx++) {
+            float* tile = map->data + ((size_t)tz * map->tilesX + tx) * map->tileArea;
+            for (int lz = 0; lz < edge; lz++) {
+                int z = (tz << map->tileShift) + lz;
+                if (z >= map->depth) z = map->depth - 1;
+                const float* row = TERRAIN_ROW(terrain, z);
+                unsigned int zBits = map->spreadZ[lz];
+                for (int lx = 0; lx < edge; lx++) {
+                    int x = (tx << map->tileShift) + lx;
+                    if (x >= map->width) x = map->width - 1;
+                    tile[map->spreadX[lx] | zBits] = row[x];
+                }
+            }
+        }
+    }
+}
+
+// Copy the tiled layout back into row-major terrain rows and refresh the apron
+void tiledExportTerrain(const TiledHeightmap* map, Terrain* terrain) {
+    if (!map || !terrain || !terrain->heights) return;
+    if (map->width != terrain->width || map->depth != terrain->depth) return;
+
+    int edge = map->tileEdge;
+    for (int tz = 0; tz < map->tilesZ; tz++) {
+        int zEnd = map->depth - (tz << map->tileShift);
+        if (zEnd > edge) zEnd = edge;
+        for (int tx = 0; tx < map->tilesX; tx++) {
+            int xEnd = map->width - (tx << map->tileShift);
+            if (xEnd > edge) xEnd = edge;
+            const float* tile = map->data + ((size_t)tz * map->tilesX + tx) * map->tileArea;
+            for (int lz = 0; lz < zEnd; lz++) {
+                float* row = TERRAIN_ROW(terrain, (tz << map->tileShift) + lz) + (tx << map->tileShift);
+                unsigned int zBits = map->spreadZ[lz];
+                for (int lx = 0; lx < xEnd; lx++) {
+                    row[lx] = tile[map->spreadX[lx] | zBits];
+                }
+            }
+        }
+    }
+
+    terrainFillApron(terrain);
+}
+
+// Fetch the left, right, front (z - 1) and back (z + 1) neighbours of (x, z),
+// clamping at the map edges. Neighbours inside the same tile are reached with
+// Morton increments instead of recomputing the full index.
+void tiledNeighbors4(const TiledHeightmap* map, int x, int z, float out[4]) {
+    int mask = map->tileEdge - 1;
+    int lx = x & mask;
+    int lz = z & mask;
+    size_t index = tiledIndex(map, x, z);
+    size_t tileBase = index & ~(size_t)(map->tileArea - 1);
+    unsigned int code = (unsigned int)(index - tileBase);
+    unsigned int xBits = code & map->xMask;
+    unsigned int zBits = code & map->zMask;
+
+    // Left
+    if (lx > 0) {
+        out[0] = map->data[tileBase + (((xBits - 1) & map->xMask) | zBits)];
+    } else {
+        out[0] = tiledGet(map, x > 0 ? x - 1 : 0, z);
+    }
+
+    // Right
+    if (lx < mask && x + 1 < map->width) {
+        out[1] = map->data[tileBase + ((((xBits | ~map->xMask) + 1) & map->xMask) | zBits)];
+    } else {
+        out[1] = tiledGet(map, x + 1 < map->width ? x + 1 : map->width - 1, z);
+    }
+
+    // Front
+    if (lz > 0) {
+        out[2] = map->data[tileBase + (((zBits - 1) & map->zMask) | xBits)];
+    } else {
+        out[2] = tiledGet(map, x, z > 0 ? z - 1 : 0);
+    }
+
+    // Back
+    if (lz < mask && z + 1 < map->depth) {
+        out[3] = map->data[tileBase + ((((zBits | ~map->zMask) + 1) & map->zMask) | xBits)];
+    } else {
+        out[3] = tiledGet(map, x, z + 1 < map->depth ? z + 1 : map->depth - 1);
+    }
+}
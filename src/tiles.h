@@ -0,0 +1,52 @@
+// tiles.h
+#ifndef TILES_H
+#define TILES_H
+
+#include "terrain.h"
+#include <stddef.h>
+
+#define TILE_SHIFT_32 5    // 32x32 tiles, 4 KB of floats per tile
+#define TILE_SHIFT_64 6    // 64x64 tiles, 16 KB of floats per tile
+#define TILE_MAX_EDGE 64
+
+// Alternative height storage for neighbourhood-heavy passes. The map is split into
+// square tiles stored one after another; inside a tile cells follow a Z-curve
+// (Morton order), so the z - 1 / z + 1 neighbours of a cell are usually a few
+// cache lines away instead of a full row.
+typedef struct {
+    int width;
+    int depth;
+    int tileShift;          // log2 of the tile edge length
+    int tileEdge;           // Cells per tile edge
+    int tileArea;           // Cells per tile
+    int tilesX;             // Tiles across the width
+    int tilesZ;             // Tiles across the depth
+    unsigned int xMask;     // Morton bits belonging to x
+    unsigned int zMask;     // Morton bits belonging to z
+    unsigned int spreadX[TILE_MAX_EDGE];  // Local x -> interleaved Morton bits
+    unsigned int spreadZ[TILE_MAX_EDGE];  // Local z -> interleaved Morton bits
+    float* data;
+} TiledHeightmap;
+
+TiledHeightmap* createTiledHeightmap(int width, int depth, int tileShift);
+void destroyTiledHeightmap(TiledHeightmap* map);
+void tiledImportTerrain(TiledHeightmap* map, const Terrain* terrain);
+void tiledExportTerrain(const TiledHeightmap* map, Terrain* terrain);
+void tiledNeighbors4(const TiledHeightmap* map, int x, int z, float out[4]);
+
+// Offset of cell (x, z) inside map->data
+static inline size_t tiledIndex(const TiledHeightmap* map, int x, int z) {
+    int mask = map->tileEdge - 1;
+    size_t tile = (size_t)(z >> map->tileShift) * map->tilesX + (size_t)(x >> map->tileShift);
+    return tile * map->tileArea + (map->spreadX[x & mask] | map->spreadZ[z & mask]);
+}
+
+static inline float tiledGet(const TiledHeightmap* map, int x, int z) {
+    return map->data[tiledIndex(map, x, z)];
+}
+
+static inline void tiledSet(TiledHeightmap* map, int x, int z, float value) {
+    map->data[tiledIndex(map, x, z)] = value;
+}
+
+#endif // TILES_H
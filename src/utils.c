@@ -1,5 +1,6 @@
 // utils.c
 #include "utils.h"
+#include <time.h>
 
 double fade(double t) {
     return t * t * t * (t * (t * 6 - 15) + 10);
@@ -16,4 +17,19 @@ double grad(int hash, double x, double y) {
     return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
 }
 
+unsigned int hashCounter(unsigned int seed, unsigned int counter) {
+    // Murmur3-style finalizer over the combined key
+    unsigned int h = seed * 0x9E3779B9u ^ counter;
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
 
+double getTimeSeconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
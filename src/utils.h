@@ -8,4 +8,10 @@ double fade(double t);
 
 double grad(int hash, double x, double y);
 
+// Stateless counter-based hash: the same (seed, counter) always yields the same bits
+unsigned int hashCounter(unsigned int seed, unsigned int counter);
+
+// Monotonic wall-clock time in seconds, for throughput reporting
+double getTimeSeconds(void);
+
 #endif
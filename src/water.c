@@ -0,0 +1,259 @@
+// water.c
+#include "water.h"
+#include "jobs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+
+#define WATER_PLANES 8          // water, four fluxes, two velocities, ground
+#define WATER_BAND_ROWS 32      // Rows per parallel job
+#define WATER_LEFT_PAD TERRAIN_ROW_FLOATS
+#define WATER_WALL_HEIGHT 1e9f  // Ground height of the apron; water never flows up it
+
+typedef struct {
+    WaterSim* sim;
+    int bands;
+    int (*changed)[4];      // Per band: bounds of the cells that crossed wetDepth, or NULL
+} WaterPass;
+
+WaterSim* createWaterSim(const Terrain* terrain) {
+    if (!terrain || !terrain->heights) return NULL;
+
+    WaterSim* sim = (WaterSim*)malloc(sizeof(WaterSim));
+    if (!sim) return NULL;
+
+    sim->width = terrain->width;
+    sim->depth = terrain->depth;
+
+    // Same scheme as createTerrainWithApron with a one-cell apron
+    int blockMask = TERRAIN_ROW_FLOATS - 1;
+    sim->stride = WATER_LEFT_PAD + ((sim->width + 1 + blockMask) & ~blockMask);
+    size_t planeFloats = (size_t)(sim->depth + 2) * sim->stride;
+    size_t bytes = planeFloats * WATER_PLANES * sizeof(float);
+
+    sim->storage = (float*)aligned_alloc(TERRAIN_ALIGNMENT, bytes);
+    if (!sim->storage) {
+        free(sim);
+        return NULL;
+    }
+    memset(sim->storage, 0, bytes);
+
+    float** planes[WATER_PLANES] = {
+        &sim->water, &sim->fluxLeft, &sim->fluxRight, &sim->fluxFront,
+        &sim->fluxBack, &sim->velocityX, &sim->velocityZ, &sim->ground
+    };
+    for (int i = 0; i < WATER_PLANES; i++) {
+        *planes[i] = sim->storage + i * planeFloats + sim->stride + WATER_LEFT_PAD;
+    }
+
+    // A wall around the map gives a closed boundary without edge checks in the kernels
+    for (int z = -1; z <= sim->depth; z++) {
+        float* ground = sim->ground + (ptrdiff_t)z * sim->stride;
+        if (z < 0 || z == sim->depth) {
+            for (int x = -1; x <= sim->width; x++) ground[x] = WATER_WALL_HEIGHT;
+        } else {
+            ground[-1] = WATER_WALL_HEIGHT;
+            ground[sim->width] = WATER_WALL_HEIGHT;
+        }
+    }
+
+    sim->timeStep = 0.05f;
+    sim->gravity = 9.81f;
+    sim->pipeArea = 1.0f;
+    sim->rainfall = 0.0f;
+    sim->evaporation = 0.0f;
+    sim->wetDepth = 0.0f;
+
+    waterSyncTerrain(sim, terrain);
+    return sim;
+}
+
+void destroyWaterSim(WaterSim* sim) {
+    if (sim) {
+        free(sim->storage);
+        free(sim);
+    }
+}
+
+void waterSyncTerrain(WaterSim* sim, const Terrain* terrain) {
+    if (!sim) return;
+    waterSyncTerrainRect(sim, terrain, 0, 0, sim->width, sim->depth);
+}
+
+void waterSyncTerrainRect(WaterSim* sim, const Terrain* terrain, int x0, int z0, int x1, int z1) {
+    if (!sim || !terrain || terrain->width != sim->width || terrain->depth != sim->depth) return;
+
+    if (x0 < 0) x0 = 0;
+    if (z0 < 0) z0 = 0;
+    if (x1 > sim->width) x1 = sim->width;
+    if (z1 > sim->depth) z1 = sim->depth;
+
+    float scale = MAX_HEIGHT * VOXEL_SIZE;
+    for (int z = z0; z < z1; z++) {
+        const float* row = TERRAIN_ROW(terrain, z);
+        float* ground = sim->ground + (size_t)z * sim->stride;
+        for (int x = x0; x < x1; x++) {
+            ground[x] = row[x] * scale;
+        }
+    }
+}
+
+void waterFillToLevel(WaterSim* sim, float level) {
+    if (!sim) return;
+    for (int z = 0; z < sim->depth; z++) {
+        float* water = sim->water + (size_t)z * sim->stride;
+        const float* ground = sim->ground + (size_t)z * sim->stride;
+        for (int x = 0; x < sim->width; x++) {
+            float fill = level - ground[x];
+            if (fill > water[x]) water[x] = fill;
+        }
+    }
+}
+
+static inline float positive(float v) {
+    return v > 0.0f ? v : 0.0f;
+}
+
+// Pass 1: update the outflow flux of every cell in a band of rows from the
+// surface height difference to each neighbour, then scale it so a cell never
+// sends out more water than it holds
+static void fluxBandJob(void* context, int band, int worker) {
+    (void)worker;
+    WaterSim* sim = ((WaterPass*)context)->sim;
+    int z0 = band * WATER_BAND_ROWS;
+    int z1 = z0 + WATER_BAND_ROWS < sim->depth ? z0 + WATER_BAND_ROWS : sim->depth;
+    int stride = sim->stride;
+    int width = sim->width;
+    float dt = sim->timeStep;
+    float pipe = dt * sim->pipeArea * sim->gravity / VOXEL_SIZE;
+    float cellArea = VOXEL_SIZE * VOXEL_SIZE;
+
+    for (int z = z0; z < z1; z++) {
+        size_t row = (size_t)z * stride;
+        const float* restrict d = sim->water + row;
+        const float* restrict b = sim->ground + row;
+        float* restrict fl = sim->fluxLeft + row;
+        float* restrict fr = sim->fluxRight + row;
+        float* restrict ff = sim->fluxFront + row;
+        float* restrict fb = sim->fluxBack + row;
+
+        for (int x = 0; x < width; x++) {
+            float surface = b[x] + d[x];
+            float left = positive(fl[x] + pipe * (surface - b[x - 1] - d[x - 1]));
+            float right = positive(fr[x] + pipe * (surface - b[x + 1] - d[x + 1]));
+            float front = positive(ff[x] + pipe * (surface - b[x - stride] - d[x - stride]));
+            float back = positive(fb[x] + pipe * (surface - b[x + stride] - d[x + stride]));
+
+            float total = (left + right + front + back) * dt;
+            float available = d[x] * cellArea;
+            float k = total > available ? available / total : 1.0f;
+
+            fl[x] = left * k;
+            fr[x] = right * k;
+            ff[x] = front * k;
+            fb[x] = back * k;
+        }
+    }
+}
+
+// Pass 2: move water by the net flux and derive the velocity field
+static void waterBandJob(void* context, int band, int worker) {
+    (void)worker;
+    WaterPass* pass = (WaterPass*)context;
+    WaterSim* sim = pass->sim;
+    int z0 = band * WATER_BAND_ROWS;
+    int z1 = z0 + WATER_BAND_ROWS < sim->depth ? z0 + WATER_BAND_ROWS : sim->depth;
+    int stride = sim->stride;
+    int width = sim->width;
+    float dt = sim->timeStep;
+    float wet = sim->wetDepth;
+    float invArea = 1.0f / (VOXEL_SIZE * VOXEL_SIZE);
+    float gain = sim->rainfall * dt;
+    float keep = 1.0f - sim->evaporation * dt;
+
+    for (int z = z0; z < z1; z++) {
+        size_t row = (size_t)z * stride;
+        float* restrict d = sim->water + row;
+        const float* restrict fl = sim->fluxLeft + row;
+        const float* restrict fr = sim->fluxRight + row;
+        const float* restrict ff = sim->fluxFront + row;
+        const float* restrict fb = sim->fluxBack + row;
+        float* restrict vx = sim->velocityX + row;
+        float* restrict vz = sim->velocityZ + row;
+
+        // The zero apron means the neighbour terms need no edge checks
+        int crossX0 = width, crossX1 = 0;
+        for (int x = 0; x < width; x++) {
+            float inflow = fr[x - 1] + fl[x + 1] + fb[x - stride] + ff[x + stride];
+            float outflow = fl[x] + fr[x] + ff[x] + fb[x];
+            float before = d[x];
+            float after = positive(before + dt * (inflow - outflow) * invArea);
+
+            float meanDepth = 0.5f * (before + after);
+            float flowX = 0.5f * (fr[x - 1] - fl[x] + fr[x] - fl[x + 1]);
+            float flowZ = 0.5f * (fb[x - stride] - ff[x] + fb[x] - ff[x + stride]);
+            float scale = meanDepth > 1e-4f ? 1.0f / (meanDepth * VOXEL_SIZE) : 0.0f;
+            vx[x] = flowX * scale;
+            vz[x] = flowZ * scale;
+
+            d[x] = (after + gain) * keep;
+            if ((before > wet) != (d[x] > wet)) {
+                if (x < crossX0) crossX0 = x;
+                crossX1 = x + 1;
+            }
+        }
+
+        if (pass->changed && crossX0 < crossX1) {
+            int* bounds = pass->changed[band];
+            if (crossX0 < bounds[0]) bounds[0] = crossX0;
+            if (z < bounds[1]) bounds[1] = z;
+            if (crossX1 > bounds[2]) bounds[2] = crossX1;
+            if (z >= bounds[3]) bounds[3] = z + 1;
+        }
+    }
+}
+
+void waterSimulate(WaterSim* sim, int steps, int changed[4]) {
+    if (changed) changed[0] = changed[1] = changed[2] = changed[3] = 0;
+    if (!sim) return;
+
+    WaterPass pass;
+    pass.sim = sim;
+    pass.bands = (sim->depth + WATER_BAND_ROWS - 1) / WATER_BAND_ROWS;
+    pass.changed = NULL;
+    if (changed && steps > 0) {
+        pass.changed = (int(*)[4])malloc((size_t)pass.bands * sizeof(*pass.changed));
+        if (!pass.changed) {
+            // Report everything rather than nothing
+            changed[2] = sim->width;
+            changed[3] = sim->depth;
+        }
+        for (int band = 0; pass.changed && band < pass.bands; band++) {
+            pass.changed[band][0] = sim->width;
+            pass.changed[band][1] = sim->depth;
+            pass.changed[band][2] = pass.changed[band][3] = 0;
+        }
+    }
+
+    // Each pass only writes its own rows, and reads of neighbouring bands happen
+    // in the other pass, so bands run without synchronization inside a pass
+    for (int step = 0; step < steps; step++) {
+        jobsParallelFor(pass.bands, fluxBandJob, &pass);
+        jobsParallelFor(pass.bands, waterBandJob, &pass);
+    }
+
+    if (pass.changed) {
+        int bounds[4] = { sim->width, sim->depth, 0, 0 };
+        for (int band = 0; band < pass.bands; band++) {
+            const int* b = pass.changed[band];
+            if (b[0] >= b[2]) continue;
+            if (b[0] < bounds[0]) bounds[0] = b[0];
+            if (b[1] < bounds[1]) bounds[1] = b[1];
+            if (b[2] > bounds[2]) bounds[2] = b[2];
+            if (b[3] > bounds[3]) bounds[3] = b[3];
+        }
+        if (bounds[0] < bounds[2]) memcpy(changed, bounds, sizeof(bounds));
+        free(pass.changed);
+    }
+}
@@ -0,0 +1,55 @@
+// water.h
+#ifndef WATER_H
+#define WATER_H
+
+#include "terrain.h"
+
+// Virtual-pipe shallow-water simulation on top of a terrain.
+// Every field is a separate plane (structure of arrays) with the same padded,
+// aligned row layout as Terrain.heights: rows are 'stride' floats apart, start on
+// a TERRAIN_ALIGNMENT boundary, and a one-cell apron surrounds the map. The apron
+// is zero in the depth, flux and velocity planes; in the ground plane it is a wall
+// too high for water to flow onto, which closes the map's boundary.
+// Depths and heights are in world units; fluxes are volumes per second.
+typedef struct {
+    int width;
+    int depth;
+    int stride;
+    float* storage;         // Single allocation backing every plane
+
+    float* water;           // Water depth above the terrain
+    float* fluxLeft;        // Outflow towards x - 1
+    float* fluxRight;       // Outflow towards x + 1
+    float* fluxFront;       // Outflow towards z - 1
+    float* fluxBack;        // Outflow towards z + 1
+    float* velocityX;
+    float* velocityZ;
+    float* ground;          // Terrain height in world units, refreshed by waterSyncTerrain
+
+    float timeStep;         // Fixed step in seconds
+    float gravity;
+    float pipeArea;         // Cross-section of the virtual pipes
+    float rainfall;         // Depth added per second to every cell
+    float evaporation;      // Fraction of depth lost per second
+    float wetDepth;         // Depth whose crossings waterSimulate reports, in world units
+} WaterSim;
+
+#define WATER_INDEX(sim, x, z) ((z) * (sim)->stride + (x))
+#define WATER_DEPTH(sim, x, z) ((sim)->water[WATER_INDEX(sim, x, z)])
+
+WaterSim* createWaterSim(const Terrain* terrain);
+void destroyWaterSim(WaterSim* sim);
+
+// Copy the terrain heights into the ground plane; call after the terrain changes
+void waterSyncTerrain(WaterSim* sim, const Terrain* terrain);
+void waterSyncTerrainRect(WaterSim* sim, const Terrain* terrain, int x0, int z0, int x1, int z1);
+
+// Fill every cell whose ground lies below 'level' (world units) up to that level
+void waterFillToLevel(WaterSim* sim, float level);
+
+// Advance the simulation by 'steps' fixed time steps. When 'changed' is non-NULL it
+// receives the bounds x0, z0, x1, z1 (exclusive) of the cells whose depth crossed
+// wetDepth during the steps, with x0 >= x1 when none did.
+void waterSimulate(WaterSim* sim, int steps, int changed[4]);
+
+#endif // WATER_H